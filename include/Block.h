@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief Identifies the type of a block in the voxel world.
+ */
+using BlockId = uint16_t;
+
+// Every layer of the block texture array, in layer order: name, image file, and the tint
+// (red, green, blue) multiplied into the image.
+#define GRAPHICS_BLOCK_TEXTURE_LIST(X) \
+	X(COBBLESTONE, "models/Minecraft/cobblestone.png", 1.0f, 1.0f, 1.0f) \
+	X(GOLDEN_COBBLESTONE, "models/Minecraft/cobblestone.png", 1.0f, 0.85f, 0.45f) \
+	X(WATER, "models/Minecraft/cobblestone.png", 0.25f, 0.45f, 0.95f)
+
+// Every block type, in id order: name, how many consecutive ids it takes (one per variant),
+// whether it is opaque, the block light it emits (0-15), its textures on the top, bottom and
+// sides. Blocks without faces, like air, name any texture.
+#define GRAPHICS_BLOCK_LIST(X) \
+	X(AIR, 1, false, 0, COBBLESTONE, COBBLESTONE, COBBLESTONE) \
+	X(COBBLESTONE, 1, true, 0, COBBLESTONE, COBBLESTONE, COBBLESTONE) \
+	X(GLOWSTONE, 1, true, 15, GOLDEN_COBBLESTONE, GOLDEN_COBBLESTONE, GOLDEN_COBBLESTONE) \
+	X(WATER, Blocks::WATER_LEVELS, false, 0, WATER, WATER, WATER)
+
+/**
+ * @brief A layer of the block texture array.
+ */
+enum class BlockTexture : uint16_t {
+#define GRAPHICS_TEXTURE_NAME(name, file, red, green, blue) name,
+	GRAPHICS_BLOCK_TEXTURE_LIST(GRAPHICS_TEXTURE_NAME)
+#undef GRAPHICS_TEXTURE_NAME
+	COUNT
+};
+
+/**
+ * @brief Where the pixels of a texture layer come from.
+ */
+struct BlockTextureSource {
+	const char* file;
+	float tint[3];
+};
+
+/**
+ * @brief The source of every texture layer, indexed by BlockTexture. The texture array is
+ * built from this table, so the layers the blocks name always exist.
+ */
+constexpr BlockTextureSource BLOCK_TEXTURE_SOURCES[] = {
+#define GRAPHICS_TEXTURE_SOURCE(name, file, red, green, blue) { file, { red, green, blue } },
+	GRAPHICS_BLOCK_TEXTURE_LIST(GRAPHICS_TEXTURE_SOURCE)
+#undef GRAPHICS_TEXTURE_SOURCE
+};
+
+namespace Blocks {
+	// A water source comes first. The rest of its ids are flowing water, one level
+	// shallower for every block it has spread from its source.
+	constexpr int WATER_LEVELS = 8;
+
+	// The first id of every block type. Each type's ids run up to the next type's first id.
+	enum : BlockId {
+#define GRAPHICS_BLOCK_ID(name, variants, opaque, emission, top, bottom, side) \
+	name, name##_END = name + (variants) - 1,
+		GRAPHICS_BLOCK_LIST(GRAPHICS_BLOCK_ID)
+#undef GRAPHICS_BLOCK_ID
+		COUNT
+	};
+}
+
+/**
+ * @brief What the engine needs to know about a block id.
+ */
+struct BlockProperties {
+	// Hides the faces of its neighbors and stops light.
+	bool opaque;
+	// Block light level, 0-15.
+	uint8_t lightEmission;
+	// Per face, in ChunkMesher's order: +x, -x, +y, -y, +z, -z.
+	std::array<uint16_t, 6> textureLayers;
+};
+
+/**
+ * @brief The properties of every block id, built at compile time from GRAPHICS_BLOCK_LIST,
+ * so hot loops look them up with a single load.
+ */
+constexpr std::array<BlockProperties, Blocks::COUNT> BLOCK_PROPERTIES = [] {
+	std::array<BlockProperties, Blocks::COUNT> table{};
+	int id = 0;
+#define GRAPHICS_BLOCK_PROPERTIES(name, variants, opaque, emission, top, bottom, side) \
+	for (int variant = 0; variant < (variants); variant++) { \
+		auto layer = [](BlockTexture texture) { return static_cast<uint16_t>(texture); }; \
+		table[id++] = BlockProperties{ opaque, emission, { \
+			layer(BlockTexture::side), layer(BlockTexture::side), layer(BlockTexture::top), \
+			layer(BlockTexture::bottom), layer(BlockTexture::side), layer(BlockTexture::side) } }; \
+	}
+	GRAPHICS_BLOCK_LIST(GRAPHICS_BLOCK_PROPERTIES)
+#undef GRAPHICS_BLOCK_PROPERTIES
+	return table;
+}();
+
+/**
+ * @brief Whether a block hides the faces of its neighbors and stops light.
+ */
+inline bool isOpaque(BlockId block) {
+	return BLOCK_PROPERTIES[block].opaque;
+}
+
+/**
+ * @brief The block light level (0-15) a block emits.
+ */
+inline uint8_t lightEmission(BlockId block) {
+	return BLOCK_PROPERTIES[block].lightEmission;
+}
+
+/**
+ * @brief The layer of the block texture array that one face of a block shows.
+ * @param face in ChunkMesher's order: +x, -x, +y, -y, +z, -z.
+ */
+inline uint16_t textureLayer(BlockId block, int face) {
+	return BLOCK_PROPERTIES[block].textureLayers[face];
+}
+
+inline bool isWater(BlockId block) {
+	return block >= Blocks::WATER && block <= Blocks::WATER_END;
+}
+
+/**
+ * @brief 0 for a water source, 1 to WATER_LEVELS - 1 for flowing water.
+ */
+inline int waterLevel(BlockId block) {
+	return block - Blocks::WATER;
+}
+
+inline BlockId flowingWater(int level) {
+	return static_cast<BlockId>(Blocks::WATER + level);
+}
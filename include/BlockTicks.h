@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/ext.hpp>
+#include "Chunk.h"
+
+// Block updates run at a fixed rate, and flowing water spreads one block every FLOW_DELAY ticks.
+constexpr int TICKS_PER_SECOND = 20;
+constexpr int FLOW_DELAY = 5;
+
+struct BlockHash {
+	size_t operator()(const glm::ivec3& block) const {
+		return (static_cast<size_t>(static_cast<uint32_t>(block.x)) * 73856093u)
+			^ (static_cast<size_t>(static_cast<uint32_t>(block.y)) * 19349663u)
+			^ (static_cast<size_t>(static_cast<uint32_t>(block.z)) * 83492791u);
+	}
+};
+
+/**
+ * @brief The blocks waiting for an update, each due at a given tick.
+ *
+ * Only blocks that may change are ever scheduled, so the cost of a tick follows the activity
+ * in the world rather than its size. A block is scheduled at most once at a time. Updates
+ * for chunks that are not loaded are parked with their chunk and handed back when it is.
+ */
+class BlockTickQueue {
+public:
+	/**
+	 * @brief Schedules a block for the given tick. A block that is already scheduled keeps
+	 * its time.
+	 */
+	void schedule(const glm::ivec3& block, uint64_t due);
+
+	/**
+	 * @brief Removes and returns every block due at or before the given tick, in order.
+	 */
+	std::vector<glm::ivec3> takeDue(uint64_t tick);
+
+	/**
+	 * @brief Holds a block whose chunk is not loaded until release() is called for it.
+	 */
+	void park(const glm::ivec3& block);
+
+	/**
+	 * @brief Schedules the parked blocks of a chunk that was just loaded.
+	 */
+	void release(ChunkPos chunk, uint64_t due);
+
+	/**
+	 * @brief Forgets the parked blocks of a chunk that is no longer wanted.
+	 */
+	void drop(ChunkPos chunk);
+
+	size_t scheduledCount() const { return m_scheduled.size(); }
+	size_t parkedCount() const;
+
+private:
+	struct Tick {
+		uint64_t due;
+		uint64_t sequence;
+		glm::ivec3 block;
+
+		// std::push_heap builds a max-heap, so "less" means "runs later".
+		bool operator<(const Tick& other) const {
+			return due != other.due ? due > other.due : sequence > other.sequence;
+		}
+	};
+
+	// A binary heap ordered by Tick::operator<.
+	std::vector<Tick> m_heap;
+	std::unordered_set<glm::ivec3, BlockHash> m_scheduled;
+	uint64_t m_nextSequence = 0;
+	std::unordered_map<ChunkPos, std::vector<glm::ivec3>> m_parked;
+};
+
+/**
+ * @brief The next state of a block under the water rules, computed only from the blocks
+ * around it, so many blocks can be updated in parallel against the same world.
+ *
+ * Sources never change. Air and flowing water become falling water (level 1) under any
+ * water, and otherwise one level shallower than the deepest water beside them that cannot
+ * fall any further (it rests on an opaque block or on water). Flowing water that nothing
+ * feeds dries up, so cut-off water drains away a level at a time.
+ * @param blockAt returns the block at given block coordinates.
+ */
+BlockId flowWater(const glm::ivec3& block, const std::function<BlockId(const glm::ivec3&)>& blockAt);
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <glm/ext.hpp>
+
+// Nodes hold the boxes of up to BVH_WIDTH children, and leaves of a mesh hold up to BVH_WIDTH
+// triangles, so one SIMD test covers a whole node or leaf.
+constexpr int BVH_WIDTH = 4;
+
+/**
+ * @brief A node of a bounding volume hierarchy: the boxes of its children, one lane each.
+ */
+struct BvhNode {
+	// bounds[0] holds the minimum corners and bounds[1] the maximum ones, per axis and child.
+	// Empty child slots have inverted boxes, which no ray hits.
+	alignas(16) float bounds[2][3][BVH_WIDTH];
+	// Per child: the index of a node, or ~i for leaf i.
+	int32_t child[BVH_WIDTH];
+};
+
+/**
+ * @brief Where a ray hits a mesh.
+ */
+struct MeshHit {
+	// Along the ray, in multiples of its direction vector.
+	float distance;
+	// The index of the triangle, i.e. its first index in the mesh's faces divided by 3.
+	uint32_t triangle;
+	// Barycentric coordinates of the hit toward the triangle's second and third vertices.
+	float u;
+	float v;
+};
+
+/**
+ * @brief A bounding volume hierarchy over the triangles of one mesh, for ray queries on the
+ * CPU.
+ *
+ * Built once with the surface area heuristic (binned, top-down), then collapsed into nodes
+ * of BVH_WIDTH children. The triangles are copied into leaves of up to BVH_WIDTH triangles,
+ * laid out for SIMD: with GRAPHICS_ENABLE_AVX2 a node's boxes, or a leaf's triangles, are
+ * tested in one go; otherwise a scalar path makes the same tests one lane at a time.
+ */
+class MeshBvh {
+public:
+	/**
+	 * @param faces three indices into positions per triangle.
+	 */
+	MeshBvh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& faces);
+
+	/**
+	 * @brief The nearest triangle (seen from either side) hit by a ray within maxDistance.
+	 * @param direction need not be of unit length; distances are in multiples of it.
+	 */
+	std::optional<MeshHit> intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	const glm::vec3& boundsMin() const { return m_min; }
+	const glm::vec3& boundsMax() const { return m_max; }
+	size_t triangleCount() const { return m_triangleCount; }
+
+private:
+	// Up to BVH_WIDTH triangles, as a corner and two edges each, one lane per triangle.
+	// Unused lanes have zero edges, which no ray hits.
+	struct Leaf {
+		alignas(16) float corner[3][BVH_WIDTH];
+		float edge1[3][BVH_WIDTH];
+		float edge2[3][BVH_WIDTH];
+		uint32_t triangle[BVH_WIDTH];
+	};
+
+	std::vector<BvhNode> m_nodes;
+	std::vector<Leaf> m_leaves;
+	glm::vec3 m_min;
+	glm::vec3 m_max;
+	size_t m_triangleCount;
+};
+
+/**
+ * @brief One placement of a mesh in the world.
+ */
+struct BvhInstance {
+	const MeshBvh* mesh;
+	// Local to world.
+	glm::mat4 model;
+	// Returned with hits, to tell the instances apart.
+	uint32_t id;
+};
+
+struct InstanceHit {
+	uint32_t id;
+	MeshHit hit;
+};
+
+/**
+ * @brief A bounding volume hierarchy over mesh instances, built the same way as MeshBvh but
+ * over the instances' world-space boxes. Rays that reach an instance continue in its
+ * mesh's own hierarchy, transformed into its local space.
+ *
+ * Cheap to build for a scene's worth of objects, so it can be rebuilt whenever they move.
+ * The meshes must outlive it.
+ */
+class SceneBvh {
+public:
+	explicit SceneBvh(const std::vector<BvhInstance>& instances);
+
+	/**
+	 * @brief The nearest instance hit by a ray within maxDistance. Distances are in world
+	 * space, in multiples of the direction vector.
+	 */
+	std::optional<InstanceHit> intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	/**
+	 * @brief Casts random rays through the scene's bounds and prints the throughput in rays
+	 * per second.
+	 */
+	void benchmark(int rayCount) const;
+
+private:
+	struct Placed {
+		const MeshBvh* mesh;
+		// World to local.
+		glm::mat4 toLocal;
+		uint32_t id;
+	};
+
+	std::vector<BvhNode> m_nodes;
+	// The instances, in leaf order; leaf i covers m_leaves[i].x instances from m_leaves[i].y.
+	std::vector<Placed> m_instances;
+	std::vector<glm::ivec2> m_leaves;
+	glm::vec3 m_min;
+	glm::vec3 m_max;
+};
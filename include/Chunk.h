@@ -0,0 +1,201 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Block.h"
+
+// Chunks are columns of CHUNK_SIZE x CHUNK_HEIGHT x CHUNK_SIZE blocks, split vertically into
+// cubic sections of CHUNK_SIZE^3 blocks, which are the unit of meshing.
+constexpr int CHUNK_SIZE = 16;
+constexpr int SECTION_COUNT = 8;
+constexpr int CHUNK_HEIGHT = CHUNK_SIZE * SECTION_COUNT;
+constexpr int SECTION_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Light levels run from 0 to MAX_LIGHT. Each block stores its sky light in the high nibble
+// of a byte and its block light in the low nibble.
+constexpr uint8_t MAX_LIGHT = 15;
+constexpr uint8_t FULL_SKY_LIGHT = MAX_LIGHT << 4;
+
+inline uint8_t skyLight(uint8_t light) { return light >> 4; }
+inline uint8_t blockLight(uint8_t light) { return light & 0x0F; }
+inline uint8_t packLight(uint8_t sky, uint8_t block) { return static_cast<uint8_t>((sky << 4) | block); }
+
+/**
+ * @brief The light of every block of a section, in ChunkSection::index() order.
+ */
+using LightSection = std::array<uint8_t, SECTION_VOLUME>;
+
+/**
+ * @brief The position of a chunk column, in chunks.
+ */
+struct ChunkPos {
+	int32_t x;
+	int32_t z;
+
+	bool operator==(const ChunkPos& other) const { return x == other.x && z == other.z; }
+	bool operator!=(const ChunkPos& other) const { return !(*this == other); }
+};
+
+template <>
+struct std::hash<ChunkPos> {
+	size_t operator()(const ChunkPos& pos) const {
+		return std::hash<uint64_t>()((static_cast<uint64_t>(static_cast<uint32_t>(pos.x)) << 32)
+			| static_cast<uint32_t>(pos.z));
+	}
+};
+
+/**
+ * @brief A CHUNK_SIZE^3 cube of blocks, palette-compressed.
+ *
+ * The section keeps a palette of the block types it contains, and each block stores only
+ * its index into the palette, packed into 64-bit words with as few bits as the palette
+ * needs (0, 1, 2, 4, 8 or 16; powers of two, so no index straddles two words). A section of
+ * one block type stores no indices at all. When a new block type no longer fits, the
+ * indices are widened in place.
+ */
+class ChunkSection {
+private:
+	std::vector<BlockId> m_palette;
+	std::vector<uint64_t> m_words;
+	uint32_t m_bits;
+	// How many blocks are not air, so empty sections can be skipped quickly.
+	uint32_t m_solidCount;
+
+	uint32_t paletteIndex(int i) const {
+		if (m_bits == 0) {
+			return 0;
+		}
+		uint32_t bit = i * m_bits;
+		return static_cast<uint32_t>(m_words[bit >> 6] >> (bit & 63)) & ((1u << m_bits) - 1);
+	}
+	void setPaletteIndex(int i, uint32_t entry);
+	void widen();
+
+public:
+	/**
+	 * @brief A section filled with one block type.
+	 */
+	explicit ChunkSection(BlockId fill = Blocks::AIR);
+	/**
+	 * @brief Packs SECTION_VOLUME blocks given in index() order, with the smallest palette
+	 * and index width that fit them. Much faster than calling set() for each block.
+	 */
+	explicit ChunkSection(const BlockId* blocks);
+
+	static int index(int x, int y, int z) { return (y * CHUNK_SIZE + z) * CHUNK_SIZE + x; }
+
+	BlockId get(int x, int y, int z) const { return m_palette[paletteIndex(index(x, y, z))]; }
+	void set(int x, int y, int z, BlockId block);
+
+	/**
+	 * @brief Decodes every block, in index() order, into SECTION_VOLUME entries of `out`.
+	 * Much faster than calling get() for each block.
+	 */
+	void unpack(BlockId* out) const;
+
+	bool isEmpty() const { return m_solidCount == 0; }
+
+	/**
+	 * @brief Whether any block type in the palette passes the test, without looking at the
+	 * blocks. The palette may still list a type whose blocks were all overwritten since.
+	 */
+	bool mayContain(bool (*test)(BlockId)) const {
+		return std::any_of(m_palette.begin(), m_palette.end(), test);
+	}
+
+	/**
+	 * @brief Bytes used by this section, including its palette and indices.
+	 */
+	size_t memoryUsage() const;
+
+	/**
+	 * @brief Appends the packed form: palette size, palette, index width and index words.
+	 */
+	void serialize(std::vector<uint8_t>& out) const;
+	/**
+	 * @brief Reads a section written by serialize() and advances the cursor past it.
+	 * @throws std::runtime_error if the data is truncated or invalid.
+	 */
+	static std::shared_ptr<ChunkSection> deserialize(const uint8_t*& cursor, const uint8_t* end);
+};
+
+/**
+ * @brief The sections of a chunk at one point in time. Holding a snapshot is cheap and
+ * makes later edits to the chunk copy the affected sections, so the snapshot never changes
+ * and can be saved on another thread.
+ */
+struct ChunkSnapshot {
+	ChunkPos pos;
+	std::array<std::shared_ptr<const ChunkSection>, SECTION_COUNT> sections;
+
+	/**
+	 * @brief Appends the uncompressed saved form of the chunk.
+	 */
+	void serialize(std::vector<uint8_t>& out) const;
+};
+
+/**
+ * @brief A column of sections. Sections that are entirely air are not allocated.
+ *
+ * Sections are shared, copy-on-write: worker threads get read-only references through
+ * section(), and setBlock() copies a section first if anyone else still holds it. Only the
+ * thread that owns the chunk may call setBlock() or hand out new references.
+ */
+class Chunk {
+private:
+	ChunkPos m_pos;
+	std::array<std::shared_ptr<ChunkSection>, SECTION_COUNT> m_sections;
+	// Light is shared copy-on-write like the blocks. A null section is open sky: full sky
+	// light and no block light everywhere, which is what most sections above ground are.
+	std::array<std::shared_ptr<LightSection>, SECTION_COUNT> m_light;
+
+public:
+	explicit Chunk(ChunkPos pos);
+
+	ChunkPos getPos() const { return m_pos; }
+
+	/**
+	 * @brief The block at chunk-local coordinates; air outside the chunk's height.
+	 */
+	BlockId getBlock(int x, int y, int z) const;
+	void setBlock(int x, int y, int z, BlockId block);
+
+	/**
+	 * @brief A read-only reference to one section, or null if it is all air.
+	 */
+	std::shared_ptr<const ChunkSection> section(int sectionY) const { return m_sections[sectionY]; }
+
+	/**
+	 * @brief The packed light at chunk-local coordinates; full sky light above the chunk
+	 * and none below it.
+	 */
+	uint8_t getLight(int x, int y, int z) const;
+	void setLight(int x, int y, int z, uint8_t light);
+
+	/**
+	 * @brief A read-only reference to the light of one section, or null if it is open sky.
+	 */
+	std::shared_ptr<const LightSection> lightSection(int sectionY) const { return m_light[sectionY]; }
+
+	/**
+	 * @brief Replaces a whole section, e.g. one built with ChunkSection(const BlockId*).
+	 * Null, or an empty section, clears it to air.
+	 */
+	void setSection(int sectionY, std::shared_ptr<ChunkSection> section);
+
+	ChunkSnapshot snapshot() const;
+
+	/**
+	 * @brief Rebuilds a chunk from the output of ChunkSnapshot::serialize().
+	 * @throws std::runtime_error if the data is truncated or invalid.
+	 */
+	static std::unique_ptr<Chunk> deserialize(ChunkPos pos, const uint8_t* data, size_t size);
+
+	/**
+	 * @brief Bytes used by the allocated sections.
+	 */
+	size_t memoryUsage() const;
+};
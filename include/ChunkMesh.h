@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include "ChunkMesher.h"
+
+/**
+ * @brief The GPU buffers of one meshed chunk section. Unlike Mesh3D, a ChunkMesh owns its
+ * buffers and frees them when destroyed, since chunks come and go as the player moves.
+ *
+ * Buffers are double-buffered: an upload writes the set that is not being drawn and then
+ * swaps, so replacing a mesh that the GPU may still be reading never has to wait for it.
+ */
+class ChunkMesh {
+private:
+	struct Buffers {
+		uint32_t vao = 0;
+		uint32_t vbo = 0;
+		uint32_t ebo = 0;
+		uint32_t indexCount = 0;
+		size_t bytes = 0;
+	};
+
+	Buffers m_buffers[2];
+	// The index of the set that is drawn.
+	int m_front;
+
+	static void release(Buffers& buffers);
+
+public:
+	ChunkMesh();
+	~ChunkMesh();
+
+	ChunkMesh(const ChunkMesh&) = delete;
+	ChunkMesh& operator=(const ChunkMesh&) = delete;
+	ChunkMesh(ChunkMesh&& other) noexcept;
+	ChunkMesh& operator=(ChunkMesh&& other) noexcept;
+
+	/**
+	 * @brief Replaces the mesh's geometry. An empty mesh frees its buffers.
+	 */
+	void upload(const ChunkMeshData& data);
+
+	/**
+	 * @brief Draws the mesh with whatever program and textures are bound.
+	 */
+	void render() const;
+
+	bool empty() const { return m_buffers[m_front].indexCount == 0; }
+	/**
+	 * @brief The size of the mesh's vertex and index buffers, both sets together.
+	 */
+	size_t bytes() const { return m_buffers[0].bytes + m_buffers[1].bytes; }
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+#include "Chunk.h"
+#include <glm/ext.hpp>
+
+/**
+ * @brief The section being meshed and its 26 neighbors, which the mesher needs to decide
+ * which faces along the section's borders are visible and how they are lit. Null sections
+ * are all air; null light sections are open sky.
+ */
+struct SectionNeighborhood {
+	std::array<std::shared_ptr<const ChunkSection>, 27> sections;
+	std::array<std::shared_ptr<const LightSection>, 27> lights;
+	// Whether the center is the lowest section of the world, whose bottom is never seen.
+	bool worldBottom = false;
+
+	/**
+	 * @brief The section at the given offset from the center, each in -1..1.
+	 */
+	const ChunkSection* at(int dx, int dy, int dz) const {
+		return sections[((dy + 1) * 3 + (dz + 1)) * 3 + (dx + 1)].get();
+	}
+	std::shared_ptr<const ChunkSection>& slot(int dx, int dy, int dz) {
+		return sections[((dy + 1) * 3 + (dz + 1)) * 3 + (dx + 1)];
+	}
+	const LightSection* lightAt(int dx, int dy, int dz) const {
+		return lights[((dy + 1) * 3 + (dz + 1)) * 3 + (dx + 1)].get();
+	}
+	std::shared_ptr<const LightSection>& lightSlot(int dx, int dy, int dz) {
+		return lights[((dy + 1) * 3 + (dz + 1)) * 3 + (dx + 1)];
+	}
+};
+
+/**
+ * @brief A vertex of a chunk mesh, packed into two words for shaders/chunk.vert to unpack.
+ * Chunk quads are axis-aligned and unit-sized, so their vertices need a few bits per
+ * attribute instead of Vertex3D's floats.
+ *
+ * geometry holds, from the lowest bit: the section-local position (5 bits per axis, each
+ * 0-16), the face (3 bits, which gives the normal), the corner of the quad (2 bits, which
+ * gives the texture coordinates), the ambient occlusion (2 bits, 0 fully occluded to 3 open)
+ * and the texture layer (10 bits). lighting holds sky light and block light, 8 bits each,
+ * scaled to 0-255 so that smoothed light keeps its fractions.
+ */
+struct ChunkVertex {
+	uint32_t geometry;
+	uint32_t lighting;
+
+	static constexpr uint16_t MAX_TEXTURE_LAYER = 1023;
+	static_assert(static_cast<int>(BlockTexture::COUNT) - 1 <= MAX_TEXTURE_LAYER, "Too many block textures to pack");
+
+	/**
+	 * @param sky,glow sky light and block light, each 0-1.
+	 */
+	static ChunkVertex pack(const glm::ivec3& position, int face, int corner, int occlusion, uint16_t layer,
+		float sky, float glow) {
+		uint32_t geometry = static_cast<uint32_t>(position.x) | static_cast<uint32_t>(position.y) << 5
+			| static_cast<uint32_t>(position.z) << 10 | static_cast<uint32_t>(face) << 15
+			| static_cast<uint32_t>(corner) << 18 | static_cast<uint32_t>(occlusion) << 20
+			| static_cast<uint32_t>(layer) << 22;
+		uint32_t lighting = static_cast<uint32_t>(sky * 255.0f + 0.5f) | static_cast<uint32_t>(glow * 255.0f + 0.5f) << 8;
+		return ChunkVertex{ geometry, lighting };
+	}
+};
+
+/**
+ * @brief CPU-side geometry of one meshed section, in section-local coordinates. Each pair of
+ * adjacent cells shows at most one face (opaque or water, never both), so a section has at most
+ * 3 * 15 * 256 inner faces plus 6 * 256 on its border: 13056 (a checkerboard of stone and
+ * water), whose 52224 vertices 16-bit indices always reach.
+ */
+struct ChunkMeshData {
+	static constexpr int MAX_FACES = 3 * (CHUNK_SIZE - 1) * CHUNK_SIZE * CHUNK_SIZE + 6 * CHUNK_SIZE * CHUNK_SIZE;
+	static constexpr int MAX_VERTICES = 4 * MAX_FACES;
+	static_assert(MAX_VERTICES - 1 <= UINT16_MAX, "Sections can have more vertices than 16-bit indices reach");
+
+	std::vector<ChunkVertex> vertices;
+	std::vector<uint16_t> indices;
+};
+
+/**
+ * @brief Builds the visible faces of the center section of a neighborhood: one quad for every
+ * face of a solid block whose neighbor is not opaque, and for every face of water whose
+ * neighbor is neither opaque nor water, with ambient occlusion and smoothed light baked into
+ * its corners.
+ * Safe to call from worker threads.
+ */
+ChunkMeshData meshSection(const SectionNeighborhood& neighborhood);
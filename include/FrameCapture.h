@@ -0,0 +1,134 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+
+/**
+ * @brief Where captured frames go.
+ */
+enum class CaptureFormat {
+	// One PNG per frame, frame_000000.png onward, in the destination directory.
+	Png,
+	// Every frame appended to capture.rgb in the destination directory, as raw 8-bit RGB rows
+	// top row first, for e.g. ffmpeg -f rawvideo -pix_fmt rgb24.
+	Raw,
+	// A ring of frames in the shared memory object named by the destination, which a local
+	// video encoder reads as they arrive; see SharedCaptureHeader.
+	SharedMemory
+};
+
+// Frames the shared memory ring holds. A reader that falls further behind loses frames.
+constexpr uint32_t SHARED_CAPTURE_SLOTS = 8;
+
+/**
+ * @brief The start of a shared memory capture ring, followed by SHARED_CAPTURE_SLOTS slots
+ * of slotBytes each. A slot holds a uint64_t frame number and then the frame as 8-bit RGB
+ * rows, top row first.
+ *
+ * The i-th frame published goes to slot i % SHARED_CAPTURE_SLOTS, and written is bumped
+ * (with release ordering) only once it is complete. Frame numbers count captured frames,
+ * so a gap means frames were dropped. While a slot is being overwritten its frame number
+ * is UINT64_MAX; a reader that finds the number changed after copying a slot lost it.
+ */
+struct SharedCaptureHeader {
+	// "GCAP" and version 1.
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t slotCount;
+	uint32_t slotBytes;
+	// Frames published so far.
+	uint64_t written;
+};
+
+/**
+ * @brief Captures the frames of the default framebuffer without stalling the pipeline.
+ *
+ * capture() only queues an asynchronous read into the next of a ring of pixel pack buffers;
+ * the read of two frames earlier has finished by then, so its buffer maps without waiting
+ * for the GPU, and the pixels are handed to a background thread that flips and writes them.
+ * If that thread falls behind, frames are dropped rather than slowing the frame loop.
+ */
+class FrameCapture {
+public:
+	/**
+	 * @param destination a directory, created if needed, or the shared memory object's name.
+	 * @throws std::runtime_error if the destination cannot be opened.
+	 */
+	FrameCapture(int width, int height, CaptureFormat format, const std::string& destination);
+	/**
+	 * @brief Writes the frames still in flight, then prints how much capturing cost.
+	 */
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	/**
+	 * @brief Captures the frame just drawn into the default framebuffer. Call it before the
+	 * buffers are swapped.
+	 */
+	void capture();
+
+private:
+	// Reads in flight; capture() maps each one this many frames after it was queued.
+	static constexpr int RING_SIZE = 3;
+	// Frames waiting for the writer beyond this are dropped.
+	static constexpr size_t MAX_QUEUED_FRAMES = 8;
+
+	struct Frame {
+		uint64_t number;
+		// Bottom row first, as OpenGL reads them.
+		std::vector<uint8_t> pixels;
+	};
+
+	int m_width;
+	int m_height;
+	CaptureFormat m_format;
+	std::filesystem::path m_directory;
+
+	std::array<GLuint, RING_SIZE> m_buffers;
+	// Frames read so far; frame n is in m_buffers[n % RING_SIZE].
+	uint64_t m_queuedReads;
+	uint64_t m_capturedFrames;
+	uint64_t m_droppedFrames;
+	// Time spent in capture(), and between its first and last call.
+	double m_captureSeconds;
+	std::chrono::steady_clock::time_point m_firstCapture;
+	std::chrono::steady_clock::time_point m_lastCapture;
+
+	std::mutex m_queueMutex;
+	std::condition_variable m_queueChanged;
+	std::deque<Frame> m_queue;
+	bool m_stopping;
+	double m_writeSeconds;
+	std::thread m_writer;
+
+	// The raw stream, or the shared memory ring.
+	std::unique_ptr<std::ofstream> m_raw;
+#ifdef _WIN32
+	void* m_mapping;
+#else
+	std::string m_sharedName;
+#endif
+	uint8_t* m_shared;
+	size_t m_sharedSize;
+
+	// Maps the read of the given frame and queues its pixels for the writer.
+	void collect(uint64_t frame);
+	void writeLoop();
+	void write(const Frame& frame);
+	void openShared(const std::string& name);
+	void closeShared();
+};
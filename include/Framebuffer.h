@@ -0,0 +1,46 @@
+#pragma once
+#include <glad/glad.h>
+#include "StbImage.h"
+
+/**
+ * @brief An offscreen render target: a color buffer and a depth/stencil buffer of a fixed
+ * size. Rendering into it needs no visible window, and its pixels can be read back.
+ */
+class Framebuffer {
+private:
+	uint32_t m_fbo;
+	uint32_t m_color;
+	uint32_t m_depth;
+	int m_width;
+	int m_height;
+
+public:
+	/**
+	 * @brief The color buffer is always RGBA8, so what is read back does not depend on the
+	 * formats the window was granted.
+	 * @throws std::runtime_error if the driver cannot render to the buffers.
+	 */
+	Framebuffer(int width, int height);
+	~Framebuffer();
+
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+
+	/**
+	 * @brief Directs rendering into this framebuffer, over its whole area.
+	 */
+	void bind() const;
+
+	/**
+	 * @brief Directs rendering back to the window, over the given area.
+	 */
+	static void bindDefault(int width, int height);
+
+	/**
+	 * @brief Reads the color buffer back as 8-bit RGB, top row first.
+	 */
+	StbImage readPixels() const;
+
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <glm/ext.hpp>
+
+/**
+ * @brief The six planes of a view frustum, for testing bounding volumes against the camera.
+ */
+class Frustum {
+private:
+	// Each plane as (normal, distance), with the normal pointing into the frustum.
+	glm::vec4 m_planes[6];
+
+public:
+	/**
+	 * @brief Extracts the planes of a projection * view matrix; with a model matrix on the
+	 * right as well, the planes are in that model's local space instead of world space.
+	 */
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	/**
+	 * @brief Whether an axis-aligned box may be visible. Conservative: boxes near the corners
+	 * of the frustum can pass while being just outside it.
+	 */
+	bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+
+	/**
+	 * @brief Whether a sphere may be visible.
+	 */
+	bool intersects(const glm::vec3& center, float radius) const;
+
+	/**
+	 * @brief One of the planes, for testing many volumes at once.
+	 */
+	const glm::vec4& plane(int index) const { return m_planes[index]; }
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include "StbImage.h"
+
+// Color differences below this CIE76 delta E are just barely noticeable side by side.
+constexpr float NOTICEABLE_DELTA_E = 2.3f;
+
+/**
+ * @brief How far an image is from an expected one, as a viewer would judge it.
+ */
+struct ImageDifference {
+	// The average color difference between pixels at the same place, in CIE76 delta E.
+	float meanDeltaE;
+	// The largest color difference of a pixel from the expected pixels within one pixel of it.
+	float worstDeltaE;
+	// The share of pixels that differ noticeably from every expected pixel within one pixel
+	// of them. Allowing a pixel of slack keeps edges that rasterize a pixel over from counting.
+	float differingShare;
+};
+
+/**
+ * @brief Compares two sRGB images of the same size in CIELAB, where distances follow the
+ * differences people see.
+ * @throws std::runtime_error if their sizes or channel counts differ.
+ */
+ImageDifference compareImages(const StbImage& expected, const StbImage& actual);
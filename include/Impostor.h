@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/ext.hpp>
+#include "Frustum.h"
+#include "Object3D.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief Pre-rendered views of objects, drawn in their place once they are so far away that
+ * their meshes would cover no more pixels than a view does.
+ *
+ * Each object is rendered from viewsPerSide x viewsPerSide directions, spread over the whole
+ * sphere by an octahedral mapping, into one layer of two texture arrays: its color, and its
+ * normal and depth. A distant object becomes a camera-facing quad that blends the four views
+ * nearest to the direction it is seen from, and writes the depth the views recorded so it
+ * still intersects the terrain properly. Every distant object of every kind is drawn by one
+ * instanced call.
+ *
+ * The views are unlit, like the meshes of the texturing program; the normals are kept for
+ * programs that light them.
+ */
+class ImpostorAtlas {
+public:
+	/**
+	 * @param captureProgram renders the views, writing color and normal/depth.
+	 * @param program draws the impostors.
+	 * @param cellSize the size of one view, in texels.
+	 */
+	ImpostorAtlas(ShaderProgram captureProgram, ShaderProgram program, int viewsPerSide = 8, int cellSize = 64);
+	~ImpostorAtlas();
+
+	ImpostorAtlas(const ImpostorAtlas&) = delete;
+	ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+
+	/**
+	 * @brief Renders the views of the objects, in their current pose, and gives each of them
+	 * its impostor. Replaces any impostors baked before. An object nested in another one of
+	 * the list is left out of the other's views and keeps rendering on its own, so objects
+	 * that animate relative to their parents should be listed themselves.
+	 * @throws std::runtime_error if the driver cannot render into the atlas.
+	 */
+	void bake(const std::vector<Object3D*>& objects);
+
+	/**
+	 * @brief Starts collecting the impostors of a frame seen through the given camera, into the
+	 * current viewport.
+	 */
+	void beginFrame(const glm::mat4& view, const glm::mat4& projection);
+
+	/**
+	 * @brief Queues an impostor if its object is too far away to need its meshes, or skips it
+	 * if it is outside the view.
+	 * @param model the object's local->world matrix, including its parents'.
+	 * @return whether the impostor took care of the object; if not, render its meshes.
+	 */
+	bool queue(int32_t impostor, const glm::mat4& model);
+
+	/**
+	 * @brief Draws the impostors queued this frame.
+	 */
+	void draw();
+
+	/**
+	 * @brief The number of impostors drawn last frame.
+	 */
+	size_t drawnCount() const { return m_drawn; }
+
+private:
+	struct Bounds {
+		glm::vec3 center;
+		float radius;
+	};
+
+	// Matches the per-instance attributes of impostor.vert.
+	struct Instance {
+		glm::vec4 centerRadius;
+		// The object's local->world rotation, without its scale.
+		glm::vec3 axisX;
+		glm::vec3 axisY;
+		glm::vec3 axisZ;
+		float layer;
+	};
+
+	ShaderProgram m_captureProgram;
+	ShaderProgram m_program;
+	int m_viewsPerSide;
+	int m_cellSize;
+
+	uint32_t m_colors;
+	uint32_t m_normalDepths;
+	// Each impostor's bounding sphere, in its object's local space.
+	std::vector<Bounds> m_bounds;
+
+	uint32_t m_vao;
+	uint32_t m_corners;
+	uint32_t m_instanceBuffer;
+	std::vector<Instance> m_instances;
+	size_t m_drawn;
+
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+	glm::vec3 m_cameraPosition;
+	Frustum m_frustum;
+	// Converts a sphere's radius over its distance into its radius in pixels.
+	float m_pixelsPerUnitAngle;
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * The operations that the vectorized loops (terrain noise, voxel ray casting, BVH traversal
+ * and meshlet culling) are written in. Each loop is a template over a lane type, and picks
+ * the widest lane type its batches fit; with GRAPHICS_ENABLE_AVX2 off, only ScalarLanes
+ * exists. Every lane type runs the exact same sequence of IEEE operations (there is no FMA
+ * contraction), so all of them produce bit-identical results.
+ *
+ * Masks come from comparisons, and hold all lanes set where the comparison holds.
+ */
+
+/**
+ * @brief Operations on one lane at a time.
+ */
+struct ScalarLanes {
+	using Float = float;
+	using Int = int32_t;
+	// Wraps around instead of overflowing, for hashing.
+	using UInt = uint32_t;
+	using Mask = bool;
+	static constexpr int WIDTH = 1;
+
+	static Float load(const float* p) { return *p; }
+	static Int load(const int32_t* p) { return *p; }
+	static Float loadUnaligned(const float* p) { return *p; }
+	static void store(float* p, Float v) { *p = v; }
+	static void store(int32_t* p, Int v) { *p = v; }
+	static void storeUnaligned(float* p, Float v) { *p = v; }
+	static Float splat(float v) { return v; }
+	static Int splatInt(int32_t v) { return v; }
+	static UInt splatUInt(uint32_t v) { return v; }
+
+	static Float add(Float a, Float b) { return a + b; }
+	static Float sub(Float a, Float b) { return a - b; }
+	static Float mul(Float a, Float b) { return a * b; }
+	static Float div(Float a, Float b) { return a / b; }
+	static Float sqrt(Float a) { return std::sqrt(a); }
+	static Float floor(Float a) { return std::floor(a); }
+	// These return b when either is NaN, like the SIMD instructions.
+	static Float min(Float a, Float b) { return a < b ? a : b; }
+	static Float max(Float a, Float b) { return a > b ? a : b; }
+
+	// Truncates toward zero, keeping the two's complement bits.
+	static UInt toUInt(Float a) { return static_cast<uint32_t>(static_cast<int32_t>(a)); }
+	static UInt addUInt(UInt a, UInt b) { return a + b; }
+	static UInt mulUInt(UInt a, UInt b) { return a * b; }
+	static UInt xorUInt(UInt a, UInt b) { return a ^ b; }
+	static UInt shiftRight(UInt a, int bits) { return a >> bits; }
+	// Negates v if the given bit of h is set.
+	static Float flipSign(Float v, UInt h, int bit) { return (h >> bit) & 1 ? -v : v; }
+
+	static Mask less(Float a, Float b) { return a < b; }
+	static Mask lessEqual(Float a, Float b) { return a <= b; }
+	static Mask notEqual(Float a, Float b) { return a != b; }
+	static Mask both(Mask a, Mask b) { return a && b; }
+	static Mask either(Mask a, Mask b) { return a || b; }
+	// b, unless a.
+	static Mask butNot(Mask a, Mask b) { return !a && b; }
+	static Mask neither(Mask a, Mask b) { return !a && !b; }
+	static Mask none() { return false; }
+	// One bit per lane.
+	static int bits(Mask m) { return m ? 1 : 0; }
+
+	static Float select(Mask m, Float a, Float b) { return m ? a : b; }
+	static Int select(Mask m, Int a, Int b) { return m ? a : b; }
+	static Float addIf(Mask m, Float a, Float b) { return m ? a + b : a; }
+	static Int addIf(Mask m, Int a, Int b) { return m ? a + b : a; }
+};
+
+#if defined(__AVX2__)
+/**
+ * @brief Operations on 4 lanes at a time, in SSE registers (with the AVX encodings). Floats
+ * and masks only.
+ */
+struct Avx2Lanes4 {
+	using Float = __m128;
+	using Mask = __m128;
+	static constexpr int WIDTH = 4;
+
+	static Float load(const float* p) { return _mm_load_ps(p); }
+	static void store(float* p, Float v) { _mm_store_ps(p, v); }
+	static Float splat(float v) { return _mm_set1_ps(v); }
+
+	static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+	static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+	static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+	static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+	static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+	static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+	static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+
+	static Mask less(Float a, Float b) { return _mm_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask lessEqual(Float a, Float b) { return _mm_cmp_ps(a, b, _CMP_LE_OQ); }
+	static Mask notEqual(Float a, Float b) { return _mm_cmp_ps(a, b, _CMP_NEQ_OQ); }
+	static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+	static Mask either(Mask a, Mask b) { return _mm_or_ps(a, b); }
+	static Mask none() { return _mm_setzero_ps(); }
+	static int bits(Mask m) { return _mm_movemask_ps(m); }
+};
+
+/**
+ * @brief Operations on 8 lanes at a time, in AVX2 registers.
+ */
+struct Avx2Lanes {
+	using Float = __m256;
+	using Int = __m256i;
+	using UInt = __m256i;
+	using Mask = __m256;
+	static constexpr int WIDTH = 8;
+
+	static Float load(const float* p) { return _mm256_load_ps(p); }
+	static Int load(const int32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+	static Float loadUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, Float v) { _mm256_store_ps(p, v); }
+	static void store(int32_t* p, Int v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+	static void storeUnaligned(float* p, Float v) { _mm256_storeu_ps(p, v); }
+	static Float splat(float v) { return _mm256_set1_ps(v); }
+	static Int splatInt(int32_t v) { return _mm256_set1_epi32(v); }
+	static UInt splatUInt(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+
+	static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+	static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+	static Float floor(Float a) { return _mm256_floor_ps(a); }
+	static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+	static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+
+	static UInt toUInt(Float a) { return _mm256_cvttps_epi32(a); }
+	static UInt addUInt(UInt a, UInt b) { return _mm256_add_epi32(a, b); }
+	static UInt mulUInt(UInt a, UInt b) { return _mm256_mullo_epi32(a, b); }
+	static UInt xorUInt(UInt a, UInt b) { return _mm256_xor_si256(a, b); }
+	static UInt shiftRight(UInt a, int bits) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(bits)); }
+	// Moves the given bit of h into the sign bit and flips v's sign with it.
+	static Float flipSign(Float v, UInt h, int bit) {
+		UInt sign = _mm256_sll_epi32(h, _mm_cvtsi32_si128(31 - bit));
+		sign = _mm256_and_si256(sign, _mm256_set1_epi32(static_cast<int>(0x80000000u)));
+		return _mm256_xor_ps(v, _mm256_castsi256_ps(sign));
+	}
+
+	static Mask less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static Mask notEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
+	static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	static Mask either(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+	static Mask butNot(Mask a, Mask b) { return _mm256_andnot_ps(a, b); }
+	static Mask neither(Mask a, Mask b) {
+		return _mm256_andnot_ps(_mm256_or_ps(a, b), _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+	}
+	static Mask none() { return _mm256_setzero_ps(); }
+	static int bits(Mask m) { return _mm256_movemask_ps(m); }
+
+	static Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+	static Int select(Mask m, Int a, Int b) {
+		return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m));
+	}
+	// Adding zero where the mask is clear leaves a unchanged, even for infinite b.
+	static Float addIf(Mask m, Float a, Float b) { return _mm256_add_ps(a, _mm256_and_ps(m, b)); }
+	static Int addIf(Mask m, Int a, Int b) {
+		return _mm256_add_epi32(a, _mm256_and_si256(_mm256_castps_si256(m), b));
+	}
+};
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <glm/ext.hpp>
+#include "Chunk.h"
+
+/**
+ * @brief Access to blocks and light by block coordinates, across chunk borders.
+ */
+class LightAccess {
+public:
+	virtual ~LightAccess() = default;
+
+	/**
+	 * @brief Whether the block is stored; light does not spread into blocks that are not.
+	 * Coordinates above or below the world are never loaded.
+	 */
+	virtual bool loaded(const glm::ivec3& block) const = 0;
+	virtual BlockId getBlock(const glm::ivec3& block) const = 0;
+	virtual uint8_t getLight(const glm::ivec3& block) const = 0;
+	virtual void setLight(const glm::ivec3& block, uint8_t light) = 0;
+};
+
+/**
+ * @brief Spreads sky light and block light by breadth-first flood fill.
+ *
+ * Light drops by one level per block, except that full sky light travels straight down
+ * without loss. Opaque blocks hold no light. Changes are incremental: blockChanged() queues
+ * the light that has to be removed and re-added around one block, and propagate() only
+ * visits the blocks whose light actually changes (plus their neighbors).
+ */
+class LightPropagator {
+public:
+	explicit LightPropagator(LightAccess& access);
+
+	/**
+	 * @brief Queues a block whose current light should spread to its neighbors.
+	 */
+	void addSource(const glm::ivec3& block);
+
+	/**
+	 * @brief Queues the relighting around a block that was just changed; call it after
+	 * storing the new block.
+	 */
+	void blockChanged(const glm::ivec3& block);
+
+	/**
+	 * @brief Runs the queued removals, then the queued additions.
+	 */
+	void propagate();
+
+	/**
+	 * @brief Every block whose light was changed, since construction or the last clearChanged().
+	 */
+	const std::vector<glm::ivec3>& changed() const { return m_changed; }
+	void clearChanged() { m_changed.clear(); }
+
+	/**
+	 * @brief Lights a freshly generated chunk on its own: sky light down every column and
+	 * into overhangs and caves, and the light of glowing blocks. Light from and into
+	 * neighboring chunks is spread later, when they are side by side.
+	 */
+	static void lightChunk(Chunk& chunk);
+
+private:
+	enum Channel { SKY, BLOCK };
+
+	struct Removal {
+		glm::ivec3 block;
+		Channel channel;
+		uint8_t level;
+	};
+
+	struct Addition {
+		glm::ivec3 block;
+		Channel channel;
+	};
+
+	LightAccess& m_access;
+	std::deque<Removal> m_removals;
+	std::deque<Addition> m_additions;
+	std::vector<glm::ivec3> m_changed;
+
+	uint8_t level(const glm::ivec3& block, Channel channel) const;
+	void setLevel(const glm::ivec3& block, Channel channel, uint8_t level);
+};
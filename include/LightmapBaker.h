@@ -0,0 +1,46 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include <glm/ext.hpp>
+#include "Object3D.h"
+
+// Lightmaps store light up to this level, so surfaces can end up brighter than their texture.
+// The shaders that sample a lightmap scale it back up by the same factor.
+constexpr float LIGHTMAP_RANGE = 2.0f;
+
+/**
+ * @brief How lightmaps are baked.
+ */
+struct LightmapSettings {
+	// Lightmap texels per unit of surface, in world space.
+	float texelsPerUnit = 8.0f;
+	// No lightmap grows past this many texels on a side; a mesh that would is baked coarser.
+	int maxSize = 1024;
+	// Paths traced per texel, and how many surfaces each may bounce off before it ends.
+	int samples = 64;
+	int bounces = 2;
+	// The share of light every surface reflects. Textures only live on the GPU, so this stands
+	// in for their average color.
+	float albedo = 0.6f;
+	// The direction sunlight travels, and the irradiance it gives a surface facing it.
+	glm::vec3 sunDirection = glm::vec3(-0.4f, -1.0f, -0.3f);
+	glm::vec3 sunColor = glm::vec3(2.2f, 2.0f, 1.8f);
+	// The radiance of the sky, seen by every path that escapes the scene.
+	glm::vec3 skyColor = glm::vec3(0.35f, 0.45f, 0.6f);
+};
+
+/**
+ * @brief Bakes the light reaching the meshes of static objects (the sun, the sky, and light
+ * bounced between the objects) and gives every mesh a "lightmap" texture, sampled at its
+ * vertices' lightmap coordinates.
+ *
+ * Each triangle gets its own chart, laid flat at the same texel density as the others and
+ * packed into the mesh's lightmap in shelves, with a gutter that filtering never crosses.
+ * Texels are path traced on every core against a SceneBvh of the objects, which are the
+ * only occluders. The lightmaps are cached in cacheDirectory under a hash of the geometry,
+ * placement and settings, so only the first run of a scene pays for the bake; later runs,
+ * and rendering, cost nothing beyond the texture fetch.
+ * @param objects must not move afterward, or their light will no longer match.
+ */
+void bakeLightmaps(const std::vector<Object3D*>& objects, const LightmapSettings& settings,
+	const std::filesystem::path& cacheDirectory);
@@ -0,0 +1,47 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "ChunkMesher.h"
+#include "TerrainGenerator.h"
+
+// The coarsest level of detail: tiles of 2^MAX_LOD_LEVEL chunks on a side, downsampled as many times.
+constexpr int MAX_LOD_LEVEL = 3;
+
+/**
+ * @brief Identifies a tile of distant terrain. A tile of level L covers 2^L x 2^L chunks,
+ * starting at chunk (x * 2^L, z * 2^L), in cells of 2^L blocks on every side; so every tile
+ * is CHUNK_SIZE cells across, whatever its level.
+ */
+struct LodKey {
+	int level;
+	int x;
+	int z;
+
+	int scale() const { return 1 << level; }
+	// The chunk at the tile's lowest x and z.
+	ChunkPos firstChunk() const { return ChunkPos{ x * scale(), z * scale() }; }
+	// One of the four tiles of the next finer level that this one splits into, each 0 or 1.
+	LodKey child(int dx, int dz) const { return LodKey{ level - 1, x * 2 + dx, z * 2 + dz }; }
+
+	bool operator==(const LodKey& other) const {
+		return level == other.level && x == other.x && z == other.z;
+	}
+};
+
+template <>
+struct std::hash<LodKey> {
+	size_t operator()(const LodKey& key) const {
+		return (std::hash<ChunkPos>()(ChunkPos{ key.x, key.z }) * 31) ^ key.level;
+	}
+};
+
+/**
+ * @brief Generates and meshes a tile of distant terrain. The tile's cells are stacked into
+ * sections of CHUNK_SIZE cells, meshed with meshSection() like the sections of a chunk and
+ * drawn scaled up by the tile's scale; the result holds one mesh per section, bottom first.
+ *
+ * Where tiles of different levels (or full-resolution chunks) meet, their surfaces do not
+ * quite line up. Each tile hangs a skirt of wall down its borders to cover the cracks.
+ * Safe to call from worker threads.
+ */
+std::vector<ChunkMeshData> buildLodTile(const TerrainGenerator& terrain, LodKey key);
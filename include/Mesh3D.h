@@ -1,10 +1,13 @@
 #pragma once
 #include <glm/ext.hpp>
 #include <glad/glad.h>
+#include <memory>
 #include <vector>
 
 #include "Texture.h"
 #include "ShaderProgram.h"
+#include "Bvh.h"
+#include "Meshlet.h"
 struct Vertex3D {
 	float x;
 	float y;
@@ -22,12 +25,36 @@ struct Vertex3D {
 		x(px), y(py), z(pz), nx(normX), ny(normY), nz(normZ), u(texU), v(texV) {}
 };
 
+/**
+ * @brief A mesh's vertices and faces, kept on the CPU after they are uploaded, for ray
+ * queries, light baking and culling.
+ */
+struct MeshGeometry {
+	std::vector<Vertex3D> vertices;
+	// In meshlet order, for dense meshes.
+	std::vector<uint32_t> faces;
+	// The triangles in clusters, for culling.
+	MeshletSet meshlets;
+	// The triangles, organized for ray queries.
+	MeshBvh bvh;
+
+	MeshGeometry(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces);
+
+private:
+	MeshGeometry(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, const std::vector<glm::vec3>& positions);
+};
+
 class Mesh3D {
 private:
 	uint32_t m_vao;
 	std::vector<Texture> m_textures;
 	uint32_t m_vertexCount;
 	uint32_t m_faceCount;
+	// Shared by the copies of the mesh.
+	std::shared_ptr<const MeshGeometry> m_geometry;
+	// The lightmap coordinates, one per vertex, for attribute 3; 0 for meshes without a
+	// lightmap, which read a constant coordinate into a neutral 1x1 lightmap instead.
+	uint32_t m_lightmapCoords;
 
 public:
 	Mesh3D() = delete;
@@ -46,6 +73,23 @@ public:
 
 	void addTexture(Texture texture);
 
+	/**
+	 * @brief The mesh's triangles in local space, organized for ray queries.
+	*/
+	const MeshBvh& bvh() const { return m_geometry->bvh; }
+
+	const MeshGeometry& geometry() const { return *m_geometry; }
+
+	const std::vector<Texture>& textures() const { return m_textures; }
+
+	/**
+	 * @brief A copy of the mesh that also samples the given lightmap. Every triangle gets its
+	 * own three vertices, so each corner can have its own place in the lightmap. The
+	 * coordinates live in a buffer of their own, so other meshes' vertices stay small.
+	 * @param lightmapCoords one per entry of the faces, in the lightmap's texture space.
+	*/
+	Mesh3D withLightmap(const std::vector<glm::vec2>& lightmapCoords, Texture lightmap) const;
+
 	/**
 	 * @brief Constructs a 1x1 square centered at the origin in world space.
 	*/
@@ -58,5 +102,31 @@ public:
 	 * @param proj the view->clip projection matrix.
 	*/
 	void render(ShaderProgram& program) const;
+
+	/**
+	 * @brief Renders the mesh, leaving out the meshlets culled for the camera given to
+	 * cullFor(), if any.
+	 * @param model the local->world model transformation matrix the program was given.
+	*/
+	void render(ShaderProgram& program, const glm::mat4& model) const;
+
+	/**
+	 * @brief Culls the meshlets of the meshes rendered from now on against a camera, and starts
+	 * counting the triangles culled.
+	*/
+	static void cullFor(const glm::mat4& view, const glm::mat4& projection);
+
+	/**
+	 * @brief Renders whole meshes again, e.g. from cameras that cullFor() does not describe.
+	*/
+	static void stopCulling();
+
+	/**
+	 * @brief The meshlet triangles rendered since the last cullFor(), and how many were culled.
+	*/
+	static const MeshletStats& cullingStats();
+
+private:
+	void bindTextures(ShaderProgram& program) const;
 	
 };
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/ext.hpp>
+
+// A meshlet holds up to this many distinct vertices and triangles.
+constexpr int MESHLET_MAX_VERTICES = 64;
+constexpr int MESHLET_MAX_TRIANGLES = 124;
+// Meshes with fewer triangles draw whole; culling their clusters would cost more than it saves.
+constexpr size_t MESHLET_MIN_TRIANGLES = 4096;
+// Meshlets are culled this many at a time, one SIMD lane each.
+constexpr int MESHLET_BATCH = 8;
+
+/**
+ * @brief How many triangles the meshlets of some meshes held, and how many of them were culled.
+ */
+struct MeshletStats {
+	size_t triangles = 0;
+	// Outside the view frustum.
+	size_t outsideTriangles = 0;
+	// Facing away from the camera.
+	size_t backfacingTriangles = 0;
+
+	MeshletStats& operator+=(const MeshletStats& other) {
+		triangles += other.triangles;
+		outsideTriangles += other.outsideTriangles;
+		backfacingTriangles += other.backfacingTriangles;
+		return *this;
+	}
+};
+
+/**
+ * @brief A dense mesh split into meshlets: clusters of up to MESHLET_MAX_VERTICES vertices and
+ * MESHLET_MAX_TRIANGLES triangles, grown greedily from neighboring triangles so each stays
+ * compact. Each meshlet has a bounding sphere and a cone bounding its triangles' normals.
+ *
+ * Every frame, the meshlets outside the view, and those whose triangles all face away from the
+ * camera, are culled on the CPU, MESHLET_BATCH at a time with GRAPHICS_ENABLE_AVX2 (or one at
+ * a time without). The survivors are compacted into as few index ranges as possible and drawn
+ * with one glMultiDrawElements call, from the index buffer uploaded at import.
+ *
+ * Back faces are only culled for closed, outward-facing meshes, whose back faces are always
+ * hidden behind front faces; the renderer does not cull back faces itself, so the back of an
+ * open mesh may show.
+ */
+class MeshletSet {
+public:
+	/**
+	 * @brief Splits the triangles of a mesh into meshlets, reordering faces so each meshlet's
+	 * triangles are contiguous. Meshes under MESHLET_MIN_TRIANGLES are left as they are, with
+	 * no meshlets.
+	 * @param faces three indices into positions per triangle.
+	 */
+	MeshletSet(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& faces);
+
+	size_t count() const { return m_first.size(); }
+	bool empty() const { return m_first.empty(); }
+
+	/**
+	 * @brief Culls the meshlets against a camera, in the mesh's local space, and collects the
+	 * index ranges of those that remain, for glMultiDrawElements.
+	 * @param viewProjectionModel the mesh's local->clip matrix.
+	 * @param camera the camera's position in the mesh's local space.
+	 * @param counts receives the number of indices of each range.
+	 * @param offsets receives the byte offset of each range in the index buffer.
+	 */
+	MeshletStats cull(const glm::mat4& viewProjectionModel, const glm::vec3& camera,
+		std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const;
+
+private:
+	/**
+	 * @brief The bounds of MESHLET_BATCH meshlets, one lane each.
+	 */
+	struct Batch {
+		alignas(32) float center[3][MESHLET_BATCH];
+		alignas(32) float radius[MESHLET_BATCH];
+		alignas(32) float axis[3][MESHLET_BATCH];
+		// A meshlet faces away from the camera if the direction from the camera to its center
+		// lies within the cone of this sine around its axis (widened by its radius). 1 never
+		// culls; unused lanes have it too.
+		alignas(32) float cutoff[MESHLET_BATCH];
+	};
+
+	std::vector<Batch> m_batches;
+	// Per meshlet: its first triangle, and how many it has.
+	std::vector<uint32_t> m_first;
+	std::vector<uint32_t> m_triangles;
+	// Whether the mesh's back faces are always hidden, and its bounding box.
+	bool m_closed;
+	glm::vec3 m_min;
+	glm::vec3 m_max;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Batched gradient (Perlin) noise.
+ *
+ * Every function evaluates `count` samples from parallel coordinate arrays; `count` must be
+ * a multiple of NOISE_BATCH. When built with GRAPHICS_ENABLE_AVX2, a whole batch is
+ * evaluated per instruction; otherwise a scalar path computes the exact same values, so a
+ * seed produces the same terrain either way. Results lie in roughly [-1, 1].
+ */
+constexpr int NOISE_BATCH = 8;
+
+void gradientNoise2D(const float* x, const float* z, float* out, int count, uint32_t seed);
+void gradientNoise3D(const float* x, const float* y, const float* z, float* out, int count, uint32_t seed);
+
+/**
+ * @brief Fractal sums of gradient noise: `octaves` layers, each at twice the frequency and
+ * half the amplitude of the previous one, normalized back to roughly [-1, 1].
+ * @param frequency scales the coordinates of the first octave.
+ */
+void fractalNoise2D(const float* x, const float* z, float* out, int count, uint32_t seed,
+	int octaves, float frequency);
+void fractalNoise3D(const float* x, const float* y, const float* z, float* out, int count, uint32_t seed,
+	int octaves, float frequency);
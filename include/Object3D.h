@@ -1,7 +1,11 @@
 #pragma once
+#include <functional>
 #include <memory>
 #include "ShaderProgram.h"
 #include "Mesh3D.h"
+
+class ImpostorAtlas;
+
 class Object3D {
 private:
 	// The object's list of meshes and children.
@@ -23,9 +27,15 @@ private:
 	// Some objects from Assimp imports have a "name" field, useful for debugging.
 	std::string m_name;
 
+	// The object's impostor in an ImpostorAtlas, or -1 if it always renders its meshes.
+	int32_t m_impostor;
+
 	// Recomputes the local->world transformation matrix.
 	glm::mat4 buildModelMatrix() const;
 
+	// Renders the descendants that have impostors of their own, which this object's impostor leaves out.
+	void renderDetached(ShaderProgram& shaderProgram, const glm::mat4& model, ImpostorAtlas* impostors) const;
+
 
 public:
 	// No default constructor; you must have a mesh to initialize an object.
@@ -41,6 +51,8 @@ public:
 	const glm::vec3& getCenter() const;
 	const std::string& getName() const;
 	const glm::vec4& getMaterial() const;
+	int32_t getImpostor() const;
+	glm::mat4 getModelMatrix() const;
 
 	// Child management.
 	size_t numberOfChildren() const;
@@ -55,6 +67,7 @@ public:
 	void setCenter(const glm::vec3& center);
 	void setName(const std::string& name);
 	void setMaterial(const glm::vec4& material);
+	void setImpostor(int32_t impostor);
 
 	// Transformations.
 	void move(const glm::vec3& offset);
@@ -64,9 +77,18 @@ public:
 
 
 
-	// Rendering.
-	void render(ShaderProgram& shaderProgram) const;
-	void renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const;
+	// Rendering. With impostors, objects that are far enough away queue their impostor instead.
+	void render(ShaderProgram& shaderProgram, ImpostorAtlas* impostors = nullptr) const;
+	void renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix, ImpostorAtlas* impostors = nullptr) const;
 	void addTextureToAllMeshes(const Texture& texture);
 
+	// Ray queries.
+	void collectBvhInstances(std::vector<BvhInstance>& instances, uint32_t id, const glm::mat4& parentMatrix) const;
+
+	// Visits the meshes of the object and its children with their local->world matrices.
+	void forEachMesh(const std::function<void(Mesh3D&, const glm::mat4&)>& visit, const glm::mat4& parentMatrix);
+	// Visits the meshes the object's impostor stands in for: like forEachMesh, but skipping the
+	// children that have impostors of their own, e.g. because they are animated.
+	void forEachImpostorMesh(const std::function<void(Mesh3D&, const glm::mat4&)>& visit, const glm::mat4& parentMatrix);
+
 };
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <glm/ext.hpp>
+#include "Bvh.h"
+#include "Object3D.h"
+#include "StbImage.h"
+
+/**
+ * @brief How a reference image is rendered.
+ */
+struct RenderSettings {
+	int width = 960;
+	int height = 540;
+	// In degrees, as given to glm::perspective.
+	float verticalFov = 45.0f;
+	// Surfaces a path may bounce off before it ends.
+	int bounces = 4;
+	// Every pixel gets at least minSamples paths and at most maxSamples, added samplesPerPass
+	// at a time until its tile has converged.
+	int minSamples = 16;
+	int maxSamples = 1024;
+	int samplesPerPass = 4;
+	// A tile has converged when the standard error of its pixels' brightness falls below this
+	// share of its mean brightness.
+	float noiseThreshold = 0.02f;
+	// Images are a function of the scene, the camera and this seed, whatever the thread count.
+	uint32_t seed = 1;
+	// The direction sunlight travels, the irradiance it gives a surface facing it, and the
+	// radiance of the sky.
+	glm::vec3 sunDirection = glm::vec3(-0.4f, -1.0f, -0.3f);
+	glm::vec3 sunColor = glm::vec3(2.2f, 2.0f, 1.8f);
+	glm::vec3 skyColor = glm::vec3(0.35f, 0.45f, 0.6f);
+};
+
+/**
+ * @brief A progressive path tracer on the CPU, for reference stills of the same objects and
+ * base textures the rasterizer draws.
+ *
+ * Surfaces are diffuse, colored by their base texture, and lit by the sun and the sky. The
+ * image is split into tiles that the thread pool renders a pass at a time; tiles stop once
+ * their noise falls below the threshold. Rays travel through a SceneBvh, so its SIMD tests
+ * apply. Every path draws its random numbers from its pixel, its index and the seed alone,
+ * so a render is deterministic.
+ */
+class ReferenceRenderer {
+public:
+	/**
+	 * @brief Snapshots the objects where they are now, and reads their base textures back
+	 * from VRAM, so it needs the OpenGL context they were loaded in. Their meshes must
+	 * outlive the renderer.
+	 */
+	ReferenceRenderer(const std::vector<Object3D*>& objects, const RenderSettings& settings);
+
+	/**
+	 * @brief Renders the scene from a camera, printing the throughput and convergence.
+	 * @return the image as 8-bit sRGB.
+	 */
+	StbImage render(const glm::vec3& position, const glm::vec3& forward, const glm::vec3& up) const;
+
+private:
+	struct Surface {
+		const MeshGeometry* geometry;
+		glm::mat4 model;
+		glm::mat3 normalMatrix;
+		// Into m_textures, or -1 for plain white.
+		int texture;
+	};
+
+	RenderSettings m_settings;
+	std::vector<Surface> m_surfaces;
+	std::vector<StbImage> m_textures;
+	SceneBvh m_scene;
+	// How far rays start off the surfaces, so they do not hit the surface they leave.
+	float m_offset;
+
+	glm::vec3 trace(glm::vec3 origin, glm::vec3 direction, uint32_t random) const;
+	glm::vec3 albedo(const Surface& surface, uint32_t triangle, float u, float v) const;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+// A region file holds REGION_SIZE x REGION_SIZE chunk columns.
+constexpr int REGION_SIZE = 32;
+
+/**
+ * @brief One region file: an offset table followed by LZ4-compressed chunks.
+ *
+ * The file is divided into 4 KiB sectors. The first sectors hold a table with the first
+ * sector and the byte length of every chunk; each chunk occupies a run of whole sectors.
+ * A rewritten chunk is copied to the first free run (or the end of the file), never over
+ * its old sectors. The table entry is updated once the data is written, and only then are
+ * the old sectors freed, so a crash mid-write leaves the previous version intact. Reads go through a read-only memory mapping of the file,
+ * so loading a chunk copies straight out of the page cache.
+ *
+ * All methods are thread-safe.
+ */
+class RegionFile {
+public:
+	/**
+	 * @brief Opens the region file, creating it if it does not exist.
+	 * @throws std::runtime_error if the file cannot be opened.
+	 */
+	explicit RegionFile(const std::filesystem::path& path);
+	~RegionFile();
+
+	RegionFile(const RegionFile&) = delete;
+	RegionFile& operator=(const RegionFile&) = delete;
+
+	/**
+	 * @brief The decompressed data of a chunk, or empty if it was never written.
+	 * @param localX,localZ the chunk's position within the region, in [0, REGION_SIZE).
+	 * @throws std::runtime_error if the stored data is corrupt.
+	 */
+	std::vector<uint8_t> read(int localX, int localZ);
+
+	/**
+	 * @brief Compresses and stores the data of a chunk, replacing what was there.
+	 * @return the number of bytes stored, after compression.
+	 * @throws std::runtime_error if writing fails.
+	 */
+	size_t write(int localX, int localZ, const std::vector<uint8_t>& data);
+
+private:
+	struct Entry {
+		uint32_t sector;
+		uint32_t length;
+	};
+
+	std::filesystem::path m_path;
+	std::mutex m_mutex;
+	std::array<Entry, REGION_SIZE * REGION_SIZE> m_table;
+	// One flag per sector of the file, including the table's.
+	std::vector<bool> m_usedSectors;
+
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+	const uint8_t* m_view;
+	size_t m_viewSize;
+
+	uint64_t fileSize() const;
+	void writeAt(uint64_t offset, const void* data, size_t size);
+	void unmap();
+	// Maps the whole file, if it grew since it was last mapped.
+	void remap();
+	// Takes the first run of free sectors that fits, growing the file if there is none.
+	uint32_t allocate(uint32_t sectors);
+	// Frees the sectors of an entry the table no longer points to.
+	void release(Entry entry);
+};
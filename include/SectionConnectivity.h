@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include "Chunk.h"
+
+/**
+ * @brief Which pairs of a section's six faces are joined by a path through non-opaque blocks.
+ *
+ * Seen through a section entered by one face, only the faces connected to it can show what
+ * lies beyond, which is how enclosed caves and the solid underground get culled. Faces are
+ * numbered like the mesher's: +x, -x, +y, -y, +z, -z.
+ */
+struct SectionConnectivity {
+	// One bit per unordered pair of faces that no path connects. Zero, the default, connects
+	// everything: right for air, and safe for sections that were not analyzed yet.
+	uint16_t separated = 0;
+
+	static int opposite(int face) { return face ^ 1; }
+
+	bool connects(int a, int b) const {
+		return a == b || (separated & pairBit(a, b)) == 0;
+	}
+
+	/**
+	 * @brief Flood-fills the open blocks of a section; every fill connects the faces it reaches.
+	 * Null or empty sections connect everything. Safe to call from worker threads.
+	 */
+	static SectionConnectivity compute(const ChunkSection* section);
+
+private:
+	static uint16_t pairBit(int a, int b) {
+		if (a > b) {
+			std::swap(a, b);
+		}
+		// Pairs (0, 1)..(0, 5) take bits 0-4, (1, 2)..(1, 5) bits 5-8, and so on up to (4, 5).
+		return static_cast<uint16_t>(1u << (a * (11 - a) / 2 + b - a - 1));
+	}
+};
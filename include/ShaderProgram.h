@@ -1,8 +1,24 @@
 #pragma once
 #include <glm/ext.hpp>
 #include <string>
+#include <vector>
+#include "Symbol.h"
 class ShaderProgram {
+	/**
+	 * @brief An active uniform of the linked program, reflected once after linking.
+	 */
+	struct UniformSlot {
+		SymbolId name;
+		int32_t location;
+		// The texture unit assigned to a sampler uniform at link time, or -1.
+		int32_t unit;
+	};
+
 	uint32_t m_programId;
+	std::vector<UniformSlot> m_uniforms;
+
+	void reflectUniforms();
+	int32_t location(Symbol uniformName) const;
 
 public:
 	ShaderProgram();
@@ -10,13 +26,20 @@ public:
 
 	void activate();
 
-	void setUniform(const std::string& uniformName, bool value);
-	void setUniform(const std::string& uniformName, int32_t value);
-	void setUniform(const std::string& uniformName, float value);
-	void setUniform(const std::string& uniformName, const glm::vec2& value);
-	void setUniform(const std::string& uniformName, const glm::vec3& value);
-	void setUniform(const std::string& uniformName, const glm::vec4& value);
-	void setUniform(const std::string& uniformName, const glm::mat2& value);
-	void setUniform(const std::string& uniformName, const glm::mat3& value);
-	void setUniform(const std::string& uniformName, const glm::mat4& value);
+	/**
+	 * @brief The texture unit assigned to the given sampler when the program was linked, or -1
+	 * if the program does not sample it. Samplers the compiler optimized away are not active.
+	 */
+	int32_t samplerUnit(SymbolId samplerName) const;
+
+	// Uniforms are looked up by ID in a table built at link time, never by string in GL.
+	void setUniform(Symbol uniformName, bool value);
+	void setUniform(Symbol uniformName, int32_t value);
+	void setUniform(Symbol uniformName, float value);
+	void setUniform(Symbol uniformName, const glm::vec2& value);
+	void setUniform(Symbol uniformName, const glm::vec3& value);
+	void setUniform(Symbol uniformName, const glm::vec4& value);
+	void setUniform(Symbol uniformName, const glm::mat2& value);
+	void setUniform(Symbol uniformName, const glm::mat3& value);
+	void setUniform(Symbol uniformName, const glm::mat4& value);
 };
\ No newline at end of file
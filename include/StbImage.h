@@ -9,15 +9,53 @@ class StbImage
     int m_width, m_height, m_bpp;
     std::unique_ptr<unsigned char[]> m_data = nullptr;
 
+    void decode(const unsigned char* encoded, size_t size, int mipSkip, const std::string& name);
+    void decodeJpeg(const unsigned char* encoded, size_t size, int mipSkip, const std::string& name);
+    void halve(int levels);
+
 public:
+    /**
+     * @brief Images are never downscaled below this many texels on their shorter side, so
+     * small pixel-art textures keep every level regardless of the quality tier.
+     */
+    static constexpr int MIN_DOWNSCALED_SIZE = 256;
+
     StbImage();
 
-    void loadFromFile(const std::string& filepath);
+    /**
+     * @brief Decodes an image file, keeping the channel count stored in the file
+     * (1 = grey, 2 = grey + alpha, 3 = RGB, 4 = RGBA) instead of expanding to RGBA.
+     * @param mipSkip how many top mip levels to drop while decoding; each level halves
+     * both dimensions. JPEGs are scaled in the DCT, other formats with a 2x2 box filter.
+     */
+    void loadFromFile(const std::string& filepath, int mipSkip = 0);
+
+    /**
+     * @brief Decodes an encoded image (PNG, JPEG, TGA, ...) that is already in memory,
+     * reading straight from the caller's buffer without copying it.
+     * @param name used in error messages only.
+     */
+    void loadFromMemory(const unsigned char* encoded, size_t size, int mipSkip = 0,
+        const std::string& name = "<memory>");
+
+    /**
+     * @brief Takes ownership of already-decoded 8-bit pixels with the given channel count.
+     */
+    void setPixels(int width, int height, int bpp, std::unique_ptr<unsigned char[]> data);
+
+    /**
+     * @brief Writes the image as a PNG, uncompressed (stored deflate blocks), so no encoder
+     * library is needed. Grey, grey + alpha, RGB and RGBA map to the matching PNG types.
+     */
+    void saveToPng(const std::string& filepath) const;
 
     int getWidth() const;
     int getHeight() const;
+    /**
+     * @brief The number of 8-bit channels per pixel in getData().
+     */
     int getBpp() const;
     unsigned char* getData() const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief The 32-bit identifier of an interned name (a uniform, a sampler, ...).
+ */
+using SymbolId = uint32_t;
+
+/**
+ * @brief FNV-1a hash of a name; usable at compile time, so literals cost nothing at runtime.
+ */
+constexpr SymbolId hashSymbol(std::string_view name) {
+	SymbolId hash = 2166136261u;
+	for (char c : name) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * @brief Registers a name in the global symbol table and returns its ID. Throws if a
+ * different name already registered the same ID.
+ */
+SymbolId intern(std::string_view name);
+
+/**
+ * @brief The name an ID was interned from, or "<unknown>" for IDs never interned (like
+ * literals that only ever existed at compile time).
+ */
+const std::string& symbolName(SymbolId id);
+
+/**
+ * @brief A name passed by its ID. String literals are hashed at compile time; runtime strings
+ * are interned, which also checks them for collisions.
+ */
+struct Symbol {
+	SymbolId id;
+
+	template <size_t N>
+	consteval Symbol(const char (&name)[N]) : id(hashSymbol(std::string_view(name, N - 1))) {}
+
+	Symbol(const std::string& name) : id(intern(name)) {}
+
+	static constexpr Symbol fromId(SymbolId id) {
+		return Symbol(id, 0);
+	}
+
+private:
+	constexpr Symbol(SymbolId symbolId, int) : id(symbolId) {}
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include "Chunk.h"
+
+/**
+ * @brief Procedural terrain: rolling plains blended into hills, with caves carved out below.
+ *
+ * The result depends only on the seed and the chunk position, never on the order or the
+ * thread chunks are generated on, so generate() may run on any number of chunks in parallel.
+ * Around the world origin the terrain flattens into a clearing at World::GROUND_LEVEL, where
+ * the scene's characters walk.
+ */
+class TerrainGenerator {
+private:
+	uint32_t m_seed;
+
+	/**
+	 * @brief The unrounded surface height of columns at the given block coordinates, and how
+	 * wild they are: 0 inside the clearing around the origin, 1 outside it.
+	 * @param count a multiple of NOISE_BATCH.
+	 */
+	void surfaceHeights(const float* xs, const float* zs, int count, float* heights, float* wildness) const;
+
+public:
+	explicit TerrainGenerator(uint32_t seed);
+
+	/**
+	 * @brief Fills a freshly constructed chunk with the terrain at its position.
+	 */
+	void generate(Chunk& chunk) const;
+
+	/**
+	 * @brief The terrain of a square of chunks downsampled for distant rendering: the height,
+	 * in cells of scale x scale x scale blocks, of each column of cells, with the surface
+	 * sampled at the column's center. Caves are left out; nowhere downsampled terrain is
+	 * drawn would they show.
+	 * @param first the chunk at the square's lowest x and z.
+	 * @param heights (CHUNK_SIZE + 2)^2 columns: the CHUNK_SIZE x CHUNK_SIZE columns of the
+	 * square, which is CHUNK_SIZE * scale blocks on a side, and a one-column border around
+	 * it, indexed (z + 1) * (CHUNK_SIZE + 2) + (x + 1).
+	 */
+	void downsampledHeights(ChunkPos first, int scale, int* heights) const;
+
+	/**
+	 * @brief Generates chunks on one thread and then on the shared ThreadPool, and prints
+	 * the throughput in chunks per second, in total and per core.
+	 */
+	void benchmark(int chunkCount) const;
+};
@@ -2,7 +2,40 @@
 #include <glad/glad.h>
 #include <string>
 #include <filesystem>
+#include <functional>
 #include "StbImage.h"
+#include "Symbol.h"
+
+/**
+ * @brief How a texture's texels are interpreted by the shaders that sample it.
+ */
+enum class TextureUsage {
+	// Colors authored in sRGB, like base/diffuse maps.
+	Color,
+	// Linear data, like normal, roughness, AO, and height maps.
+	Data
+};
+
+/**
+ * @brief Texture quality tiers. The value is how many top mip levels are dropped while
+ * decoding, so every step down quarters both the decode work and the VRAM of large maps.
+ */
+enum class TextureQuality {
+	High = 0,
+	Medium = 1,
+	Low = 2,
+	VeryLow = 3
+};
+
+/**
+ * @brief Running totals of the (nominal) video memory used by loaded textures.
+ */
+struct TextureMemoryStats {
+	// Bytes allocated with the channel-aware formats, including mipmaps.
+	size_t bytes;
+	// Bytes the same textures would have needed as RGBA8, including mipmaps.
+	size_t rgba8Bytes;
+};
 
 /**
  * @brief Represents a texture that has been loaded into VRAM, and is expected to be bound
@@ -11,25 +44,83 @@
 struct Texture {
 	// The ID of the texture, to be bound with glBindTexture when drawing a mesh.
 	uint32_t textureId;
-	// The name of the sampler2D uniform in the fragment shader that this texture will bind to.
-	std::string samplerName;
-
-	/**
-	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
-	 */
-	static Texture loadImage(const StbImage& texture, const std::string& samplerName) {
-		uint32_t texId;
-		glGenTextures(1, &texId);
-		glBindTexture(GL_TEXTURE_2D, texId);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.getWidth(), texture.getHeight(), 0, GL_RGBA,
-			GL_UNSIGNED_BYTE, texture.getData());
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		return Texture{ texId, samplerName };
-	}
-};
\ No newline at end of file
+	// The interned name of the sampler2D uniform in the fragment shader that this texture
+	// will bind to.
+	SymbolId sampler;
+
+	/**
+	 * @brief Loads an image into VRAM and returns a Texture object identifying it.
+	 * The internal format follows the image's channel count (R8, RG8, RGB8, RGBA8, or the
+	 * sRGB variants for color maps), and the sampler swizzle expands it back to the RGBA
+	 * that the shaders expect, so grey maps still read as (g, g, g, 1).
+	 */
+	static Texture loadImage(const StbImage& texture, const std::string& samplerName,
+		TextureUsage usage = TextureUsage::Color);
+
+	/**
+	 * @brief Reserves a texture name without decoding anything. The image is produced by
+	 * the given function and uploaded the first time ensureLoaded() is called, which
+	 * Mesh3D::render only does once a program that samples this texture draws it.
+	 * @param name used when reporting the deferred load.
+	 */
+	static Texture loadDeferred(std::function<StbImage()> decode, const std::string& name,
+		const std::string& samplerName, TextureUsage usage);
+
+	/**
+	 * @brief Uploads this texture's image if its load was deferred and has not happened yet.
+	 * If the decode fails, the error is logged and a 1x1 white image is uploaded instead.
+	 */
+	void ensureLoaded() const;
+
+	/**
+	 * @brief Reads the top mip level back from VRAM as RGBA, with the sampler swizzle applied,
+	 * i.e. what the shaders see (color maps stay sRGB-encoded). For renderers on the CPU.
+	 */
+	StbImage download() const;
+
+	/**
+	 * @brief The usage implied by a sampler name: base textures are color, everything else is data.
+	 */
+	static TextureUsage usageForSampler(const std::string& samplerName);
+
+	/**
+	 * @brief Enables sRGB storage for color maps. Off by default: the shaders light and shade
+	 * colors as they are stored and the window writes their output as-is, so this is only
+	 * correct for a pipeline that encodes to sRGB on write (GL_FRAMEBUFFER_SRGB) and whose
+	 * shading constants were tuned for linear space; otherwise color maps render too dark.
+	 */
+	static void setSrgbColorStorage(bool enabled);
+	/**
+	 * @brief Whether color maps are stored as sRGB; see setSrgbColorStorage().
+	 */
+	static bool srgbColorStorageEnabled();
+
+	/**
+	 * @brief The total memory used by every texture loaded so far.
+	 */
+	static TextureMemoryStats memoryStats();
+
+	/**
+	 * @brief Sets the quality tier used by every image decoded after this call.
+	 */
+	static void setQuality(TextureQuality quality);
+	static TextureQuality quality();
+
+	/**
+	 * @brief The number of mip levels to skip when decoding, for StbImage::loadFromFile.
+	 */
+	static int mipSkip();
+
+	/**
+	 * @brief The highest tier whose textures fit comfortably in the given video memory budget.
+	 * A budget of 0 means "unknown" and selects High.
+	 */
+	static TextureQuality qualityForBudget(size_t budgetBytes);
+
+	/**
+	 * @brief The video memory budget in bytes: the GRAPHICS_TEXTURE_BUDGET_MB environment
+	 * variable if set, otherwise what the NVX/ATI memory info extensions report, otherwise 0.
+	 * Requires a current OpenGL context.
+	 */
+	static size_t videoMemoryBudget();
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <glm/ext.hpp>
+#include "StbImage.h"
+#include "Symbol.h"
+
+/**
+ * @brief Equally sized images stacked as the layers of one GL_TEXTURE_2D_ARRAY, expected to be
+ * bound to a sampler2DArray with a given sampler name. Meshes pick a layer per vertex, so
+ * geometry with many different textures still draws with one texture binding.
+ */
+struct TextureArray {
+	/**
+	 * @brief The source of one layer: an image, multiplied by a tint as it is uploaded. Several
+	 * layers may share an image with different tints.
+	 */
+	struct Layer {
+		const StbImage* image;
+		glm::vec3 tint = glm::vec3(1.0f);
+	};
+
+	// The ID of the texture, to be bound to GL_TEXTURE_2D_ARRAY when drawing.
+	uint32_t textureId;
+	// The interned name of the sampler2DArray uniform that this texture binds to.
+	SymbolId sampler;
+	int layerCount;
+
+	/**
+	 * @brief Uploads the layers, in order, as color textures with mipmaps.
+	 * @throws std::runtime_error if there are no layers or their sizes differ.
+	 */
+	static TextureArray build(const std::vector<Layer>& layers, const std::string& samplerName);
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads that run submitted jobs by priority (lowest value
+ * first), and in FIFO order among jobs of equal priority.
+ */
+class ThreadPool {
+private:
+	struct Job {
+		float priority;
+		uint64_t sequence;
+		std::function<void()> run;
+
+		// std::push_heap builds a max-heap, so "less" means "runs later".
+		bool operator<(const Job& other) const {
+			return priority != other.priority ? priority > other.priority : sequence > other.sequence;
+		}
+	};
+
+	std::vector<std::thread> m_workers;
+	// A binary heap ordered by Job::operator<.
+	std::vector<Job> m_jobs;
+	uint64_t m_nextSequence;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping;
+
+	void workerLoop();
+
+public:
+	/**
+	 * @brief Starts the given number of workers; 0 means one per hardware thread.
+	 */
+	explicit ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * @brief Queues a job, returning a future for its result. Exceptions thrown by the
+	 * job are rethrown by future::get().
+	 * @param priority jobs with lower values start first; 0 is the default.
+	 */
+	template <typename F>
+	auto submit(float priority, F&& job) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+		using Result = std::invoke_result_t<std::decay_t<F>>;
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+		std::future<Result> result = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(Job{ priority, m_nextSequence++, [task]() { (*task)(); } });
+			std::push_heap(m_jobs.begin(), m_jobs.end());
+		}
+		m_wake.notify_one();
+		return result;
+	}
+
+	template <typename F>
+	auto submit(F&& job) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+		return submit(0.0f, std::forward<F>(job));
+	}
+
+	/**
+	 * @brief The number of jobs waiting for a worker.
+	 */
+	size_t queuedCount();
+
+	/**
+	 * @brief The number of worker threads.
+	 */
+	size_t threadCount() const;
+
+	/**
+	 * @brief A process-wide pool sized to the hardware, shared by loaders and the world.
+	 */
+	static ThreadPool& shared();
+};
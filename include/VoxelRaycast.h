@@ -0,0 +1,77 @@
+#pragma once
+#include <functional>
+#include <optional>
+#include <glm/ext.hpp>
+#include "Chunk.h"
+
+// How many rays lineOfSight() traces side by side.
+constexpr int RAY_BATCH = 8;
+
+/**
+ * @brief The first opaque block along a ray.
+ */
+struct RayHit {
+	glm::ivec3 block;
+	// Points out of the face the ray entered through, toward the block in front of it; zero
+	// if the ray started inside the block.
+	glm::ivec3 normal;
+	// Along the ray, from its origin to where it enters the block.
+	float distance;
+	BlockId id;
+};
+
+/**
+ * @brief A segment to test for line of sight, in block coordinates.
+ */
+struct SightLine {
+	glm::vec3 from;
+	glm::vec3 to;
+};
+
+/**
+ * @brief Walks rays block by block through a voxel world (Amanatides and Woo's 3D DDA), in
+ * block coordinates: block (x, y, z) spans [x, x + 1) on each axis.
+ *
+ * Blocks are read straight from the chunk sections, which are fetched once per section a
+ * ray enters. A ray crosses an empty (or unloaded) section in a single jump instead of 16
+ * or more steps, so rays through the open sky cost almost nothing.
+ *
+ * Rays are traced RAY_BATCH at a time in lockstep. When built with GRAPHICS_ENABLE_AVX2, one
+ * step of the whole batch is a handful of instructions; otherwise a scalar path takes the
+ * exact same steps, so both give the same answers.
+ */
+class VoxelRaycaster {
+public:
+	/**
+	 * @brief Returns the section at a position in sections (x and z are the chunk, y the
+	 * section index within it, always in [0, SECTION_COUNT)), or null if it is all air or not
+	 * loaded. It must stay valid while the raycaster is in use.
+	 */
+	using SectionLookup = std::function<const ChunkSection*(const glm::ivec3& section)>;
+
+	explicit VoxelRaycaster(SectionLookup lookup);
+
+	/**
+	 * @brief The first opaque block a ray enters within maxDistance, including the one it
+	 * starts in.
+	 */
+	std::optional<RayHit> cast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	/**
+	 * @brief For each line, whether no opaque block lies between its ends. The blocks holding
+	 * the ends themselves are not tested, so an eye or a target inside the ground still counts.
+	 * @param visible receives `count` answers.
+	 */
+	void lineOfSight(const SightLine* lines, bool* visible, int count) const;
+
+private:
+	struct Batch;
+
+	SectionLookup m_lookup;
+
+	// Traces the first `count` rays of a batch until each hits an opaque block or ends.
+	void trace(Batch& batch, int count) const;
+	// Visits the block a lane has just entered, jumping over empty sections. Returns false
+	// once the lane is finished.
+	bool visit(Batch& batch, int lane) const;
+};
@@ -0,0 +1,347 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/ext.hpp>
+#include "BlockTicks.h"
+#include "Chunk.h"
+#include "ChunkMesh.h"
+#include "Lighting.h"
+#include "LodTerrain.h"
+#include "SectionConnectivity.h"
+#include "ShaderProgram.h"
+#include "TerrainGenerator.h"
+#include "WorldStorage.h"
+#include "TextureArray.h"
+#include "VoxelRaycast.h"
+
+/**
+ * @brief An unbounded voxel world, streamed in around the player.
+ *
+ * Chunks within the render radius are generated and meshed on the shared ThreadPool,
+ * nearest (and in front of the player) first, then uploaded on the main thread under a
+ * per-frame byte budget. Chunks that fall out of range are evicted.
+ *
+ * Beyond the render radius the terrain continues as tiles of distant terrain (see
+ * LodTerrain.h), each level twice as coarse and reaching twice as far as the one before. The
+ * levels form a quadtree: a tile is replaced by the four finer tiles (or chunks) it splits
+ * into once all of them can be drawn, so moving never leaves holes.
+ *
+ * Blocks that may change on their own, like flowing water, are updated TICKS_PER_SECOND
+ * times a second: only the blocks an edit scheduled (see BlockTickQueue), plus a few random
+ * blocks of each section that holds water. All public methods
+ * must be called from the thread that owns the GL context.
+ */
+class World {
+public:
+	// World-space position of the corner of block (0, 0, 0). Chosen so that the top of the
+	// ground (block y = GROUND_LEVEL - 1) sits at y = -1.5, where the old tile floor was,
+	// and blocks are centered on integer x and z.
+	static constexpr int GROUND_LEVEL = 64;
+	static const glm::vec3 ORIGIN;
+
+	/**
+	 * @param program draws the chunks; see shaders/chunk.vert and shaders/chunk.frag.
+	 * @param blockTextures the texture array that textureLayer() indexes, bound to the
+	 * "blockTextures" sampler when drawing chunks.
+	 * @param renderRadius how many chunks around the player are drawn.
+	 * @param seed selects the terrain; the same seed always generates the same world.
+	 * @param saveDirectory where edited chunks are saved, and loaded from instead of being
+	 * generated. A save directory belongs to one seed.
+	 */
+	World(ShaderProgram program, TextureArray blockTextures, int renderRadius, uint32_t seed,
+		const std::filesystem::path& saveDirectory);
+	/**
+	 * @brief Saves every edited chunk.
+	 */
+	~World();
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	/**
+	 * @brief Streams chunks around the player: collects finished jobs, schedules new ones by
+	 * priority, uploads finished meshes within the frame budget, and evicts far chunks.
+	 * @param viewDir the camera's forward vector, used to prioritize what the player faces.
+	 */
+	void update(const glm::vec3& playerPos, const glm::vec3& viewDir);
+
+	/**
+	 * @brief Draws the chunk sections the camera can see with the world's program, then makes
+	 * the previously active program current again.
+	 *
+	 * Sections are found by a breadth-first walk from the camera's section that only steps
+	 * away from the camera, through faces that are connected inside the section it leaves
+	 * (see SectionConnectivity) and into sections within the view frustum. Caves with no
+	 * opening toward the camera, and most of the solid ground, are never reached.
+	 * @param skyColor the color of full sky light, which follows the time of day.
+	 */
+	void render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& skyColor);
+
+	/**
+	 * @brief How far the terrain reaches from the player, in blocks, counting distant terrain.
+	 */
+	float viewDistance() const;
+
+	/**
+	 * @brief Whether streaming has caught up with the player: no jobs running, and no
+	 * results, uploads or edits waiting. Checked right after update(), a settled world draws
+	 * the same frame again until the player moves or the world changes.
+	 */
+	bool isSettled();
+
+	/**
+	 * @brief Blocks until one of the jobs in flight finishes, so the next update() has a
+	 * result to collect. Returns at once if none are in flight.
+	 */
+	void waitForJob();
+
+	/**
+	 * @brief The block at the given block coordinates, or air if its chunk is not loaded.
+	 */
+	BlockId getBlock(const glm::ivec3& block) const;
+
+	/**
+	 * @brief Changes a block. The sections it touches (including neighbors across section
+	 * borders) are marked dirty and remeshed asynchronously at the next update(), so all
+	 * edits made in one frame cost one remesh per section. Water around the block is
+	 * scheduled to flow. Edits to chunks that are not loaded are ignored.
+	 */
+	void setBlock(const glm::ivec3& block, BlockId id);
+
+	/**
+	 * @brief Removes every block whose center is within the given radius of a world-space point.
+	 */
+	void explode(const glm::vec3& center, float radius);
+
+	/**
+	 * @brief The first opaque block along a ray from a world-space point, within maxDistance.
+	 * Chunks that are not loaded count as air.
+	 */
+	std::optional<RayHit> pickBlock(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	/**
+	 * @brief For each pair of world-space points, whether no opaque block lies between them
+	 * (see VoxelRaycaster::lineOfSight()). Chunks that are not loaded count as air.
+	 */
+	std::vector<bool> lineOfSight(const std::vector<SightLine>& lines) const;
+
+	/**
+	 * @brief The block coordinates containing a world-space position.
+	 */
+	static glm::ivec3 toBlock(const glm::vec3& worldPos);
+	/**
+	 * @brief The chunk containing the given block coordinates.
+	 */
+	static ChunkPos toChunk(const glm::ivec3& block);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	enum class ChunkState {
+		// Wanted, but its generation job has not been submitted yet.
+		Queued,
+		Generating,
+		Generated
+	};
+
+	/**
+	 * @brief Identifies one section of one chunk.
+	 */
+	struct SectionKey {
+		ChunkPos chunk;
+		int sectionY;
+
+		bool operator==(const SectionKey& other) const {
+			return chunk == other.chunk && sectionY == other.sectionY;
+		}
+	};
+
+	struct SectionKeyHash {
+		size_t operator()(const SectionKey& key) const {
+			return std::hash<ChunkPos>()(key.chunk) * 31 + key.sectionY;
+		}
+	};
+
+	struct ChunkSlot {
+		ChunkState state = ChunkState::Queued;
+		// Identifies this slot in job results, so results for an evicted chunk are dropped.
+		uint64_t token = 0;
+		std::unique_ptr<Chunk> chunk;
+		std::array<ChunkMesh, SECTION_COUNT> meshes;
+		// Whether the first meshing job was submitted.
+		bool meshing = false;
+		// Sections of the first meshing job that still have to be uploaded.
+		int pendingSections = 0;
+		// Per section: the revision of the last submitted and last uploaded meshes, so a
+		// slow job never overwrites the result of a newer one.
+		std::array<uint32_t, SECTION_COUNT> meshRevision{};
+		std::array<uint32_t, SECTION_COUNT> uploadedRevision{};
+		// Per section: whether a remesh job is running; further edits wait for it.
+		std::array<bool, SECTION_COUNT> remeshing{};
+		// Per section: how its faces connect, as of the uploaded mesh.
+		std::array<SectionConnectivity, SECTION_COUNT> connectivity{};
+		// Per section: the last frame whose visibility walk reached it.
+		std::array<uint32_t, SECTION_COUNT> visitedFrame{};
+		// Edited since it was last saved.
+		bool modified = false;
+		// Whether the current frame draws this chunk itself; otherwise a tile of distant
+		// terrain covers it.
+		bool fullResolution = false;
+		Clock::time_point requestedAt;
+	};
+
+	struct LodSlot {
+		ChunkState state = ChunkState::Queued;
+		uint64_t token = 0;
+		// One mesh per section of cells, bottom first.
+		std::vector<ChunkMesh> meshes;
+		// Whether the last level-of-detail selection used or requested this tile.
+		bool wanted = false;
+	};
+
+	struct BuiltLodTile {
+		LodKey key;
+		uint64_t token;
+		std::vector<ChunkMeshData> meshes;
+	};
+
+	struct GeneratedChunk {
+		uint64_t token;
+		std::unique_ptr<Chunk> chunk;
+	};
+
+	struct MeshedSection {
+		ChunkPos pos;
+		uint64_t token;
+		int sectionY;
+		uint32_t revision;
+		// Whether this is a remesh after an edit, which is uploaded before streamed chunks.
+		bool edit;
+		ChunkMeshData data;
+		SectionConnectivity connectivity;
+	};
+
+	ShaderProgram m_program;
+	TextureArray m_blockTextures;
+	TerrainGenerator m_terrain;
+	WorldStorage m_storage;
+	Clock::time_point m_lastAutosave;
+	int m_renderRadius;
+	ChunkPos m_center;
+	std::unordered_map<ChunkPos, ChunkSlot> m_chunks;
+	uint64_t m_nextToken;
+	// Tiles of distant terrain, and the ones the current frame draws.
+	std::unordered_map<LodKey, LodSlot> m_lodTiles;
+	std::vector<LodKey> m_lodDraw;
+
+	/**
+	 * @brief Lets light spread through every generated chunk of the world.
+	 */
+	class WorldLightAccess : public LightAccess {
+	private:
+		World& m_world;
+		Chunk* chunkAt(const glm::ivec3& block) const;
+
+	public:
+		explicit WorldLightAccess(World& world) : m_world(world) {}
+
+		bool loaded(const glm::ivec3& block) const override;
+		BlockId getBlock(const glm::ivec3& block) const override;
+		uint8_t getLight(const glm::ivec3& block) const override;
+		void setLight(const glm::ivec3& block, uint8_t light) override;
+	};
+
+	// Reads the generated chunks.
+	VoxelRaycaster m_raycaster;
+
+	// Block updates: the tick count, when the last tick ran, and a random state for picking
+	// random blocks.
+	BlockTickQueue m_ticks;
+	uint64_t m_tick;
+	Clock::time_point m_lastTick;
+	uint32_t m_random;
+
+	// Light changes queued by edits and newly generated chunks, run once per update().
+	WorldLightAccess m_lightAccess;
+	LightPropagator m_lighting;
+
+	// Finished job results, handed from the workers to the main thread.
+	std::mutex m_resultsMutex;
+	std::vector<GeneratedChunk> m_generated;
+	std::vector<MeshedSection> m_meshed;
+	// Meshes waiting for the per-frame upload budget.
+	std::deque<MeshedSection> m_uploads;
+	std::vector<BuiltLodTile> m_builtLod;
+	std::deque<BuiltLodTile> m_lodUploads;
+	// Sections edited since the last update(), waiting to be remeshed.
+	std::unordered_set<SectionKey, SectionKeyHash> m_dirty;
+
+	// Jobs that were submitted and have not finished; the destructor waits for them.
+	std::atomic<int> m_jobsInFlight;
+	std::atomic<bool> m_shuttingDown;
+	std::mutex m_idleMutex;
+	// Signaled whenever a job finishes, which m_finishedJobs counts.
+	std::condition_variable m_idle;
+	uint64_t m_finishedJobs;
+
+	// Counts the frames drawn, to mark the sections each frame's visibility walk reached.
+	uint32_t m_renderFrame;
+	// The sections drawn, and the meshed sections in range, in the last frame.
+	size_t m_drawnSections;
+	size_t m_meshedSections;
+	size_t m_drawnLodSections;
+
+	// Statistics, reported about once a second.
+	Clock::time_point m_lastReport;
+	double m_latencySum;
+	double m_latencyMax;
+	int m_latencyCount;
+
+	float priority(ChunkPos pos, const glm::vec3& playerPos, const glm::vec3& viewDir) const;
+	void collectResults();
+	void requestChunks();
+	void evictChunks();
+	void scheduleGeneration(const glm::vec3& playerPos, const glm::vec3& viewDir);
+	void scheduleMeshing(const glm::vec3& playerPos, const glm::vec3& viewDir);
+	void scheduleRemeshing();
+	void autosave();
+	// Marks every section whose mesh depends on the given block.
+	void markDirty(const glm::ivec3& block);
+	// Queues the light that has to cross the borders between a new chunk and its neighbors.
+	void lightSeams(ChunkPos pos);
+	void relight();
+	// Runs the ticks that are due by now.
+	void runTicks();
+	void tick();
+	void randomTicks();
+	// Schedules every block whose water could change along with the given block.
+	void scheduleAround(const glm::ivec3& block, uint64_t due);
+	bool neighborsGenerated(ChunkPos pos) const;
+	SectionNeighborhood neighborhood(ChunkPos pos, int sectionY) const;
+	void uploadMeshes();
+	// Chooses, from the coarsest tiles down, what draws each part of the terrain this frame,
+	// requesting the tiles it needs and evicting the rest.
+	void selectDetail();
+	void selectTile(LodKey key);
+	// Keeps a tile, or else whatever finer detail under it is ready, and draws it if asked.
+	void coverTile(LodKey key, bool draw);
+	void requestTile(LodKey key);
+	bool lodReady(LodKey key) const;
+	bool chunksReady(LodKey key) const;
+	bool canCover(LodKey key) const;
+	// The distance from the player's chunk to the nearest chunk of a tile, in chunks.
+	float tileDistance(LodKey key) const;
+	void scheduleLod(const glm::vec3& playerPos, const glm::vec3& viewDir);
+	void report();
+
+	template <typename F>
+	void submitJob(float priority, F&& job);
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "Chunk.h"
+#include "RegionFile.h"
+
+/**
+ * @brief Saves and loads the chunks of a world, as region files in one directory.
+ *
+ * save() only queues a snapshot; a background thread serializes, compresses and writes it,
+ * so saving never stalls the frame. Until a snapshot is written, load() returns it instead
+ * of the older data on disk. load() may be called from any thread.
+ */
+class WorldStorage {
+public:
+	/**
+	 * @brief Creates the directory if it does not exist.
+	 */
+	explicit WorldStorage(const std::filesystem::path& directory);
+	/**
+	 * @brief Writes every queued snapshot before returning.
+	 */
+	~WorldStorage();
+
+	WorldStorage(const WorldStorage&) = delete;
+	WorldStorage& operator=(const WorldStorage&) = delete;
+
+	/**
+	 * @brief The saved chunk, or null if it was never saved (or its data is corrupt).
+	 */
+	std::unique_ptr<Chunk> load(ChunkPos pos);
+
+	/**
+	 * @brief Queues a chunk to be written. A newer snapshot of the same chunk replaces one
+	 * that is still waiting.
+	 */
+	void save(ChunkSnapshot snapshot);
+
+private:
+	std::filesystem::path m_directory;
+
+	std::mutex m_regionsMutex;
+	// Keyed by region position, i.e. chunk position divided by REGION_SIZE.
+	std::unordered_map<ChunkPos, std::unique_ptr<RegionFile>> m_regions;
+
+	std::mutex m_queueMutex;
+	std::condition_variable m_queueChanged;
+	// Snapshots waiting to be written, and the ones being written right now.
+	std::unordered_map<ChunkPos, ChunkSnapshot> m_pending;
+	std::unordered_map<ChunkPos, ChunkSnapshot> m_writing;
+	bool m_stopping;
+	std::thread m_saver;
+
+	// The region file holding a chunk. Null if the file does not exist and create is false.
+	RegionFile* region(ChunkPos chunk, bool create);
+	void saveLoop();
+	static std::unique_ptr<Chunk> fromSnapshot(const ChunkSnapshot& snapshot);
+};
@@ -0,0 +1,30 @@
+#version 330
+// A fragment shader for chunk meshes, lit by sky light and the light of glowing blocks.
+layout (location=0) out vec4 FragColor;
+
+in vec3 TexCoord;
+in vec3 Light;
+in float Shade;
+
+// One layer per block texture; TexCoord.z selects the layer.
+uniform sampler2DArray blockTextures;
+
+// The color of full sky light, which follows the time of day.
+uniform vec3 skyColor;
+
+// The color of light from glowing blocks.
+const vec3 BLOCK_LIGHT_COLOR = vec3(1.0, 0.85, 0.6);
+
+// Each light level is 20% dimmer than the one above it.
+float brightness(float level) {
+    return pow(0.8, 15.0 * (1.0 - level));
+}
+
+// How much light reaches a fully occluded corner.
+const float OCCLUDED = 0.45;
+
+void main() {
+    vec3 light = max(skyColor * brightness(Light.x), BLOCK_LIGHT_COLOR * brightness(Light.y));
+    light *= mix(OCCLUDED, 1.0, Light.z) * Shade;
+    FragColor = texture(blockTextures, TexCoord) * vec4(light, 1.0);
+}
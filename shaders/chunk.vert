@@ -0,0 +1,32 @@
+#version 330
+// A vertex shader for chunk meshes, which unpacks the two words of each ChunkVertex.
+layout (location=0) in uint vGeometry;
+layout (location=1) in uint vLighting;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+// Faces in the order of the mesher's face table: +x, -x, +y, -y, +z, -z. Sides facing away
+// from the sun are shaded darker, so edges stay readable where the light is even.
+const float FACE_SHADE[6] = float[6](0.8, 0.8, 1.0, 0.55, 0.65, 0.65);
+const vec2 CORNER_TEX_COORD[4] = vec2[4](vec2(0.0, 1.0), vec2(1.0, 1.0), vec2(1.0, 0.0), vec2(0.0, 0.0));
+
+// Texture coordinates and the layer of the block texture array.
+out vec3 TexCoord;
+// Sky light, block light and ambient occlusion, each 0-1.
+out vec3 Light;
+out float Shade;
+
+void main() {
+    vec3 position = vec3(uvec3(vGeometry, vGeometry >> 5u, vGeometry >> 10u) & 31u);
+    uint face = (vGeometry >> 15u) & 7u;
+    uint corner = (vGeometry >> 18u) & 3u;
+    uint occlusion = (vGeometry >> 20u) & 3u;
+    uint layer = vGeometry >> 22u;
+
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    TexCoord = vec3(CORNER_TEX_COORD[corner], float(layer));
+    Light = vec3(float(vLighting & 255u) / 255.0, float((vLighting >> 8u) & 255u) / 255.0, float(occlusion) / 3.0);
+    Shade = FACE_SHADE[face];
+}
@@ -0,0 +1,49 @@
+#version 330
+// Blends the atlas views chosen by impostor.vert, and writes the depth they recorded.
+layout (location=0) out vec4 FragColor;
+
+in vec4 ViewCoords01;
+in vec4 ViewCoords23;
+flat in vec4 Cells01;
+flat in vec4 Cells23;
+flat in vec4 Weights;
+flat in float Layer;
+in float ViewDepth;
+flat in float Radius;
+
+uniform sampler2DArray impostorColors;
+// The normal in the object's space (rgb), and the depth across the bounding sphere (a).
+uniform sampler2DArray impostorNormalDepths;
+uniform mat4 projection;
+uniform float viewsPerSide;
+
+vec4 color = vec4(0.0);
+float depth = 0.0;
+
+void addView(vec2 cell, vec2 coord, float weight) {
+    // Outside its own view, a sample would land in the neighboring one.
+    if (any(lessThan(coord, vec2(0.0))) || any(greaterThan(coord, vec2(1.0)))) {
+        return;
+    }
+    vec3 atlasCoord = vec3((cell + coord) / viewsPerSide, Layer);
+    vec4 sampled = texture(impostorColors, atlasCoord);
+    color += sampled * weight;
+    depth += texture(impostorNormalDepths, atlasCoord).a * sampled.a * weight;
+}
+
+void main() {
+    addView(Cells01.xy, ViewCoords01.xy, Weights.x);
+    addView(Cells01.zw, ViewCoords01.zw, Weights.y);
+    addView(Cells23.xy, ViewCoords23.xy, Weights.z);
+    addView(Cells23.zw, ViewCoords23.zw, Weights.w);
+    if (color.a < 0.5) {
+        discard;
+    }
+    // Empty texels are transparent black, so filtered colors are premultiplied by coverage.
+    FragColor = vec4(color.rgb / color.a, 1.0);
+
+    // Depth 0 lies a radius in front of the center, toward the camera, and 1 a radius behind.
+    float z = ViewDepth + Radius * (1.0 - 2.0 * depth / color.a);
+    vec4 clip = projection * vec4(0.0, 0.0, z, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+}
@@ -0,0 +1,91 @@
+#version 330
+// Draws distant objects as camera-facing quads that blend the four atlas views taken from
+// the directions nearest the one the object is seen from.
+layout (location=0) in vec2 vCorner;
+// Per instance: the world-space bounding sphere, the object's rotation (local->world, without
+// scale), and its layer of the atlas.
+layout (location=1) in vec4 iCenterRadius;
+layout (location=2) in vec3 iAxisX;
+layout (location=3) in vec3 iAxisY;
+layout (location=4) in vec3 iAxisZ;
+layout (location=5) in float iLayer;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 cameraPosition;
+// The atlas holds viewsPerSide x viewsPerSide views per layer.
+uniform float viewsPerSide;
+
+// Where this corner falls in each of the four views, from 0 to 1 across the view.
+out vec4 ViewCoords01;
+out vec4 ViewCoords23;
+// The views' cells in the atlas, their blend weights, and the layer.
+flat out vec4 Cells01;
+flat out vec4 Cells23;
+flat out vec4 Weights;
+flat out float Layer;
+// View-space depth of the quad, and the sphere's radius, to recover the surface's depth.
+out float ViewDepth;
+flat out float Radius;
+
+// Must match octahedralDirection and viewUp in Impostor.cpp.
+vec3 octahedralDirection(vec2 point) {
+    vec3 direction = vec3(point.x, 1.0 - abs(point.x) - abs(point.y), point.y);
+    if (direction.y < 0.0) {
+        direction.xz = (1.0 - abs(direction.zx)) * vec2(direction.x >= 0.0 ? 1.0 : -1.0, direction.z >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(direction);
+}
+
+vec2 octahedralPoint(vec3 direction) {
+    direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);
+    vec2 point = direction.xz;
+    if (direction.y < 0.0) {
+        point = (1.0 - abs(point.yx)) * vec2(point.x >= 0.0 ? 1.0 : -1.0, point.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return point;
+}
+
+vec3 viewUp(vec3 direction) {
+    return abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+}
+
+// Where a local-space offset from the center, in radii, falls in the view of a cell.
+vec2 viewCoord(vec2 cell, vec3 offset) {
+    vec3 direction = octahedralDirection(cell / (viewsPerSide - 1.0) * 2.0 - 1.0);
+    vec3 right = normalize(cross(viewUp(direction), direction));
+    vec3 up = cross(direction, right);
+    return vec2(dot(offset, right), dot(offset, up)) * 0.5 + 0.5;
+}
+
+void main() {
+    vec3 center = iCenterRadius.xyz;
+    float radius = iCenterRadius.w;
+    mat3 localToWorld = mat3(iAxisX, iAxisY, iAxisZ);
+
+    // The quad faces the camera.
+    vec3 toCamera = normalize(cameraPosition - center);
+    vec3 up = viewUp(toCamera);
+    vec3 right = normalize(cross(up, toCamera));
+    up = cross(toCamera, right);
+    vec3 offset = (right * vCorner.x + up * vCorner.y) * radius;
+    vec4 viewPosition = view * vec4(center + offset, 1.0);
+    gl_Position = projection * viewPosition;
+
+    // The four views around the direction to the camera, in the object's space, weighted by
+    // how close each one is.
+    mat3 worldToLocal = transpose(localToWorld);
+    vec2 grid = (octahedralPoint(worldToLocal * toCamera) * 0.5 + 0.5) * (viewsPerSide - 1.0);
+    vec2 cell = min(floor(grid), vec2(viewsPerSide - 2.0));
+    vec2 f = grid - cell;
+    Cells01 = vec4(cell, cell + vec2(1.0, 0.0));
+    Cells23 = vec4(cell + vec2(0.0, 1.0), cell + vec2(1.0, 1.0));
+    Weights = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+    vec3 localOffset = worldToLocal * offset / radius;
+    ViewCoords01 = vec4(viewCoord(Cells01.xy, localOffset), viewCoord(Cells01.zw, localOffset));
+    ViewCoords23 = vec4(viewCoord(Cells23.xy, localOffset), viewCoord(Cells23.zw, localOffset));
+    Layer = iLayer;
+    ViewDepth = viewPosition.z;
+    Radius = radius;
+}
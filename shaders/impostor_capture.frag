@@ -0,0 +1,27 @@
+#version 330
+// Renders a mesh into the views of an impostor atlas: its color as texturing.frag draws it,
+// and its normal and depth (0 nearest the view, 1 farthest across the bounding sphere).
+layout (location=0) out vec4 FragColor;
+layout (location=1) out vec4 NormalDepth;
+
+in vec2 TexCoord;
+in vec2 LightmapCoord;
+in vec3 Normal;
+
+uniform sampler2D baseTexture;
+// Light baked by bakeLightmaps, stored divided by LIGHTMAP_RANGE; 1x1 and neutral for meshes
+// without one.
+uniform sampler2D lightmap;
+const float LIGHTMAP_RANGE = 2.0;
+
+void main() {
+    vec4 color = texture(baseTexture, TexCoord);
+    // Coverage is all or nothing, so the impostor's edge can be cut at half coverage.
+    if (color.a < 0.5) {
+        discard;
+    }
+    vec3 light = texture(lightmap, LightmapCoord).rgb * LIGHTMAP_RANGE;
+    FragColor = vec4(color.rgb * light, 1.0);
+    // The orthographic projection spans the bounding sphere, so window depth is linear in it.
+    NormalDepth = vec4(normalize(Normal) * 0.5 + 0.5, gl_FragCoord.z);
+}
@@ -4,12 +4,15 @@
 layout (location=0) in vec3 vPosition;
 layout (location=1) in vec3 vNormal;
 layout (location=2) in vec2 vTexCoord;
+// Constant for meshes without a baked lightmap.
+layout (location=3) in vec2 vLightmapCoord;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
 out vec2 TexCoord;
+out vec2 LightmapCoord;
 out vec3 Normal;
 out vec3 FragWorldPos;
 
@@ -18,6 +21,7 @@ void main() {
     gl_Position = projection * view * model * vec4(vPosition, 1.0);
     // Pass along the vertex texture coordinate.
     TexCoord = vTexCoord;
+    LightmapCoord = vLightmapCoord;
     // Transform the vertex normal from local space to world space, using the Normal matrix.
     mat4 normalMatrix = transpose(inverse(model));
     Normal = mat3(normalMatrix) * vNormal;
@@ -7,11 +7,17 @@ layout (location=0) out vec4 FragColor;
 in vec2 TexCoord;
 in vec3 Normal;
 in vec3 FragWorldPos;
+// Constant when the mesh has no lightmap.
+in vec2 LightmapCoord;
 
 // Uniforms: MUST BE PROVIDED BY THE APPLICATION.
 
 // The mesh's base (diffuse) texture.
 uniform sampler2D baseTexture;
+// Light baked by bakeLightmaps (sun, sky and bounces), stored divided by LIGHTMAP_RANGE.
+// Meshes without one get a 1x1 lightmap that scales back to 1.
+uniform sampler2D lightmap;
+const float LIGHTMAP_RANGE = 2.0;
 
 // Material parameters for the whole mesh: k_a, k_d, k_s, shininess.
 uniform vec4 material;
@@ -52,8 +58,9 @@ void main() {
         float k_s = material.z;
         float shininess = material.w;
 
-        // 1. Ambient component
-        vec3 ambientIntensity = k_a * ambientColor;
+        // 1. Ambient component, scaled by the lightmap (neutral for meshes without one).
+        vec3 baked = texture(lightmap, LightmapCoord).rgb * LIGHTMAP_RANGE;
+        vec3 ambientIntensity = k_a * ambientColor * baked;
 
         // 2. Diffuse component
         float NdotL = max(dot(N, L), 0.0);
@@ -68,6 +75,6 @@ void main() {
 
         // Multiply by texture color
         vec4 texColor = texture(baseTexture, TexCoord);
-        FragColor = texture(baseTexture, TexCoord);  // test just the texture
+        FragColor = vec4(lightIntensity, 1) * texColor;
 
 }
\ No newline at end of file
@@ -2,14 +2,18 @@
 layout (location=0) in vec3 vPosition;
 layout (location=1) in vec3 vNormal;
 layout (location=2) in vec2 vTexCoord;
+// Constant for meshes without a baked lightmap.
+layout (location=3) in vec2 vLightmapCoord;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
 out vec2 TexCoord;
+out vec2 LightmapCoord;
 
 void main() {
     gl_Position = projection * view * model * vec4(vPosition, 1.0);
     TexCoord = vTexCoord;
+    LightmapCoord = vLightmapCoord;
 }
@@ -2,13 +2,19 @@
 // A fragment shader for rendering a mesh that has a texture, but no lighting.
 layout (location=0) out vec4 FragColor;
 
-// Input from vertices: interpolated texture coordinate.
+// Input from vertices: interpolated texture coordinate, and lightmap coordinate.
 in vec2 TexCoord;
+in vec2 LightmapCoord;
 
 // Uniform from application: the texture sampler.
 uniform sampler2D baseTexture;
+// Light baked by bakeLightmaps, stored divided by LIGHTMAP_RANGE. Meshes without one get a
+// 1x1 lightmap that scales back to 1.
+uniform sampler2D lightmap;
+const float LIGHTMAP_RANGE = 2.0;
 
 void main() {
-    FragColor = texture(baseTexture, TexCoord);
+    vec3 light = texture(lightmap, LightmapCoord).rgb * LIGHTMAP_RANGE;
+    FragColor = texture(baseTexture, TexCoord) * vec4(light, 1.0);
 
 }
\ No newline at end of file
@@ -5,30 +5,188 @@
 #include <assimp/postprocess.h>
 #include <filesystem>
 #include <unordered_map>
+#include <future>
+#include "ThreadPool.h"
 
 
 
 const size_t FLOATS_PER_VERTEX = 3;
 const size_t VERTICES_PER_FACE = 3;
 
-std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, const std::filesystem::path& modelPath,
+/**
+ * @brief A material map loaded for each mesh, and the sampler it binds to.
+ */
+struct MaterialMap {
+	aiTextureType type;
+	const char* samplerName;
+	// Every shader samples the base texture, so only the other maps wait until a program
+	// that samples them draws the mesh.
+	bool deferred;
+};
+
+const MaterialMap MATERIAL_MAPS[] = {
+	{ aiTextureType_DIFFUSE, "baseTexture", false },
+	{ aiTextureType_SPECULAR, "specMap", true },
+	{ aiTextureType_HEIGHT, "normalMap", true },
+	{ aiTextureType_NORMALS, "normalMap", true },
+};
+
+/**
+ * @brief The texture cache key of an embedded texture: "*N", like assimp's own references.
+ */
+std::string embeddedTextureKey(int index) {
+	return "*" + std::to_string(index);
+}
+
+/**
+ * @brief Decodes one embedded texture. Compressed textures (mHeight == 0) are decoded
+ * directly from the importer's buffer; raw ones are BGRA texels converted to RGBA.
+ */
+StbImage decodeEmbeddedTexture(const aiTexture* texture, const std::string& name) {
+	StbImage image;
+	if (texture->mHeight == 0) {
+		image.loadFromMemory(reinterpret_cast<const unsigned char*>(texture->pcData), texture->mWidth,
+			Texture::mipSkip(), name);
+	}
+	else {
+		size_t texels = static_cast<size_t>(texture->mWidth) * texture->mHeight;
+		auto rgba = std::make_unique<unsigned char[]>(texels * 4);
+		for (size_t i = 0; i < texels; i++) {
+			const aiTexel& t = texture->pcData[i];
+			rgba[i * 4 + 0] = t.r;
+			rgba[i * 4 + 1] = t.g;
+			rgba[i * 4 + 2] = t.b;
+			rgba[i * 4 + 3] = t.a;
+		}
+		image.setPixels(texture->mWidth, texture->mHeight, 4, std::move(rgba));
+	}
+	return image;
+}
+
+/**
+ * @brief Decodes every embedded texture referenced by the scene's materials. Those used by
+ * eager maps are decoded on the shared worker pool and uploaded (on this thread, which owns
+ * the GL context) into the texture cache under their "*N" keys. Those only used by deferred
+ * maps keep a copy of their encoded bytes, since the importer's buffers die with assimpLoad.
+ */
+void loadEmbeddedTextures(const aiScene* scene, const std::filesystem::path& modelPath,
+	std::unordered_map<std::string, Texture>& loadedTextures) {
+	// Find which embedded textures are used, and by which map.
+	std::unordered_map<int, const MaterialMap*> referenced;
+	for (unsigned int m = 0; m < scene->mNumMaterials; m++) {
+		aiMaterial* material = scene->mMaterials[m];
+		for (auto& map : MATERIAL_MAPS) {
+			for (unsigned int i = 0; i < material->GetTextureCount(map.type); i++) {
+				aiString name;
+				material->GetTexture(map.type, i, &name);
+				auto [texture, index] = scene->GetEmbeddedTextureAndIndex(name.C_Str());
+				if (texture == nullptr) {
+					continue;
+				}
+				// An eager reference wins over a deferred one.
+				auto existing = referenced.find(index);
+				if (existing == referenced.end() || (existing->second->deferred && !map.deferred)) {
+					referenced[index] = &map;
+				}
+			}
+		}
+	}
+
+	// The importer keeps its buffers alive until assimpLoad returns, so the workers
+	// can read them in place.
+	std::vector<std::pair<int, std::future<StbImage>>> decodes;
+	for (auto& [index, map] : referenced) {
+		const aiTexture* texture = scene->mTextures[index];
+		std::string name = modelPath.string() + embeddedTextureKey(index);
+		if (map->deferred) {
+			// Raw texels are small and rare, so keep them decoded rather than encoded.
+			auto image = std::make_shared<StbImage>();
+			std::shared_ptr<std::vector<unsigned char>> encoded;
+			if (texture->mHeight == 0) {
+				auto* bytes = reinterpret_cast<const unsigned char*>(texture->pcData);
+				encoded = std::make_shared<std::vector<unsigned char>>(bytes, bytes + texture->mWidth);
+			}
+			else {
+				*image = decodeEmbeddedTexture(texture, name);
+			}
+			loadedTextures.insert(std::make_pair(embeddedTextureKey(index), Texture::loadDeferred(
+				[image, encoded, name]() {
+					if (encoded) {
+						image->loadFromMemory(encoded->data(), encoded->size(), Texture::mipSkip(), name);
+					}
+					return std::move(*image);
+				}, name, map->samplerName, Texture::usageForSampler(map->samplerName))));
+			continue;
+		}
+		decodes.emplace_back(index, ThreadPool::shared().submit([texture, name]() {
+			return decodeEmbeddedTexture(texture, name);
+		}));
+	}
+	try {
+		for (auto& [index, decode] : decodes) {
+			const std::string samplerName = referenced[index]->samplerName;
+			std::cout << "loading embedded texture " << embeddedTextureKey(index) << std::endl;
+			StbImage image = decode.get();
+			loadedTextures.insert(std::make_pair(embeddedTextureKey(index),
+				Texture::loadImage(image, samplerName, Texture::usageForSampler(samplerName))));
+		}
+	}
+	catch (...) {
+		// The importer frees its buffers as the error unwinds assimpLoad, and abandoned futures
+		// do not wait, so let the other workers finish reading them first.
+		for (auto& [index, decode] : decodes) {
+			if (decode.valid()) {
+				decode.wait();
+			}
+		}
+		throw;
+	}
+}
+
+std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
+	bool deferred, const aiScene* scene, const std::filesystem::path& modelPath,
 	std::unordered_map<std::string, Texture>& loadedTextures) {
 	std::vector<Texture> textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString name;
 		mat->GetTexture(type, i, &name);
+
+		// Embedded textures were already decoded by loadEmbeddedTextures.
+		auto [embedded, embeddedIndex] = scene->GetEmbeddedTextureAndIndex(name.C_Str());
+		if (embedded != nullptr) {
+			auto existing = loadedTextures.find(embeddedTextureKey(embeddedIndex));
+			if (existing != loadedTextures.end()) {
+				Texture tex = existing->second;
+				tex.sampler = intern(typeName);
+				textures.push_back(tex);
+			}
+			continue;
+		}
+
 		std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-		std::cout << "loading " << texPath << std::endl;
+		if (!deferred) {
+			std::cout << "loading " << texPath << std::endl;
+		}
 
 		auto existing = loadedTextures.find(texPath.string());
 		if (existing != loadedTextures.end()) {
 			textures.push_back(existing->second);
 		}
+		else if (deferred) {
+			std::string path = texPath.string();
+			Texture tex = Texture::loadDeferred([path]() {
+				StbImage image;
+				image.loadFromFile(path, Texture::mipSkip());
+				return image;
+			}, path, typeName, Texture::usageForSampler(typeName));
+			textures.push_back(tex);
+			loadedTextures.insert(std::make_pair(path, tex));
+		}
 		else {
 			StbImage image;
-			image.loadFromFile(texPath.string());
-			Texture tex = Texture::loadImage(image, typeName);
+			image.loadFromFile(texPath.string(), Texture::mipSkip());
+			Texture tex = Texture::loadImage(image, typeName, Texture::usageForSampler(typeName));
 			textures.push_back(tex);
 			loadedTextures.insert(std::make_pair(texPath.string(), tex));
 		}
@@ -89,18 +247,11 @@ Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::files
 	if (mesh->mMaterialIndex >= 0)
 	{
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-			aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures);
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		std::vector<Texture> specularMaps = loadMaterialTextures(material,
-			aiTextureType_SPECULAR, "specMap", modelPath, loadedTextures);
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		std::vector<Texture> normalMaps = loadMaterialTextures(material,
-			aiTextureType_HEIGHT, "normalMap", modelPath, loadedTextures);
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		normalMaps = loadMaterialTextures(material,
-			aiTextureType_NORMALS, "normalMap", modelPath, loadedTextures);
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		for (auto& map : MATERIAL_MAPS) {
+			std::vector<Texture> maps = loadMaterialTextures(material, map.type, map.samplerName,
+				map.deferred, scene, modelPath, loadedTextures);
+			textures.insert(textures.end(), maps.begin(), maps.end());
+		}
 	}
 
 	return Mesh3D(std::move(vertices), std::move(faces), std::move(textures));
@@ -129,7 +280,16 @@ Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
 	}
 	std::vector<Mesh3D> meshes;
 	std::unordered_map<std::string, Texture> loadedTextures;
+	TextureMemoryStats before = Texture::memoryStats();
+	loadEmbeddedTextures(scene, std::filesystem::path(path), loadedTextures);
 	auto ret = processAssimpNode(scene->mRootNode, scene, std::filesystem::path(path), loadedTextures);
+
+	// Report how much VRAM the channel-aware texture formats saved for this model.
+	TextureMemoryStats after = Texture::memoryStats();
+	size_t used = after.bytes - before.bytes;
+	size_t rgba8 = after.rgba8Bytes - before.rgba8Bytes;
+	std::cout << path << ": " << loadedTextures.size() << " textures, " << used / 1024 << " KiB VRAM ("
+		<< (rgba8 - used) / 1024 << " KiB saved vs. RGBA8)" << std::endl;
 	return ret;
 }
 
@@ -0,0 +1,82 @@
+#include "BlockTicks.h"
+#include <algorithm>
+
+namespace {
+	const glm::ivec3 SIDEWAYS[4] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const glm::ivec3 UP(0, 1, 0);
+
+	ChunkPos chunkOf(const glm::ivec3& block) {
+		auto floorDiv = [](int value, int divisor) {
+			return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+		};
+		return ChunkPos{ floorDiv(block.x, CHUNK_SIZE), floorDiv(block.z, CHUNK_SIZE) };
+	}
+}
+
+void BlockTickQueue::schedule(const glm::ivec3& block, uint64_t due) {
+	if (!m_scheduled.insert(block).second) {
+		return;
+	}
+	m_heap.push_back(Tick{ due, m_nextSequence++, block });
+	std::push_heap(m_heap.begin(), m_heap.end());
+}
+
+std::vector<glm::ivec3> BlockTickQueue::takeDue(uint64_t tick) {
+	std::vector<glm::ivec3> due;
+	while (!m_heap.empty() && m_heap.front().due <= tick) {
+		std::pop_heap(m_heap.begin(), m_heap.end());
+		due.push_back(m_heap.back().block);
+		m_scheduled.erase(m_heap.back().block);
+		m_heap.pop_back();
+	}
+	return due;
+}
+
+void BlockTickQueue::park(const glm::ivec3& block) {
+	m_parked[chunkOf(block)].push_back(block);
+}
+
+void BlockTickQueue::release(ChunkPos chunk, uint64_t due) {
+	auto parked = m_parked.find(chunk);
+	if (parked == m_parked.end()) {
+		return;
+	}
+	for (auto& block : parked->second) {
+		schedule(block, due);
+	}
+	m_parked.erase(parked);
+}
+
+void BlockTickQueue::drop(ChunkPos chunk) {
+	m_parked.erase(chunk);
+}
+
+size_t BlockTickQueue::parkedCount() const {
+	size_t count = 0;
+	for (auto& [chunk, blocks] : m_parked) {
+		count += blocks.size();
+	}
+	return count;
+}
+
+BlockId flowWater(const glm::ivec3& block, const std::function<BlockId(const glm::ivec3&)>& blockAt) {
+	BlockId current = blockAt(block);
+	if (current != Blocks::AIR && !(isWater(current) && waterLevel(current) > 0)) {
+		return current;
+	}
+	if (isWater(blockAt(block + UP))) {
+		return flowingWater(1);
+	}
+	int level = Blocks::WATER_LEVELS;
+	for (auto& offset : SIDEWAYS) {
+		BlockId neighbor = blockAt(block + offset);
+		if (!isWater(neighbor)) {
+			continue;
+		}
+		BlockId below = blockAt(block + offset - UP);
+		if (isOpaque(below) || isWater(below)) {
+			level = std::min(level, waterLevel(neighbor) + 1);
+		}
+	}
+	return level < Blocks::WATER_LEVELS ? flowingWater(level) : static_cast<BlockId>(Blocks::AIR);
+}
@@ -0,0 +1,513 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include "Lanes.h"
+
+namespace {
+	constexpr float NEVER = std::numeric_limits<float>::infinity();
+	// Candidate split planes per axis when building.
+	constexpr int SAH_BINS = 12;
+	// Below this depth splits follow the surface area heuristic; past it they halve the
+	// primitives, which bounds the depth, and with it the traversal stack.
+	constexpr int MAX_SAH_DEPTH = 48;
+	constexpr int STACK_SIZE = 256;
+
+	struct Box {
+		glm::vec3 min = glm::vec3(NEVER);
+		glm::vec3 max = glm::vec3(-NEVER);
+
+		void grow(const glm::vec3& point) {
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+
+		void grow(const Box& other) {
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		float area() const {
+			if (min.x > max.x) {
+				return 0.0f;
+			}
+			glm::vec3 size = max - min;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+	};
+
+	/**
+	 * @brief Builds a hierarchy of BVH_WIDTH-wide nodes over boxes: a binary tree split by
+	 * the surface area heuristic first, then collapsed by pulling each node's largest
+	 * grandchildren up into it until it has BVH_WIDTH children.
+	 */
+	class WideBuilder {
+	public:
+		explicit WideBuilder(const std::vector<Box>& boxes) : m_boxes(boxes) {
+			m_order.resize(boxes.size());
+			m_centroids.reserve(boxes.size());
+			for (size_t i = 0; i < boxes.size(); i++) {
+				m_order[i] = static_cast<uint32_t>(i);
+				m_centroids.push_back((boxes[i].min + boxes[i].max) * 0.5f);
+			}
+			if (!boxes.empty()) {
+				buildBinary(0, static_cast<int>(boxes.size()), 0);
+				emitWide(0);
+			}
+		}
+
+		std::vector<BvhNode> nodes;
+		// Per leaf: how many primitives it holds, and where they start in order.
+		std::vector<glm::ivec2> leaves;
+
+		const std::vector<uint32_t>& order() const { return m_order; }
+
+	private:
+		struct Binary {
+			Box box;
+			// Children, or -1 for a leaf.
+			int left;
+			int right;
+			int first;
+			int count;
+		};
+
+		const std::vector<Box>& m_boxes;
+		std::vector<glm::vec3> m_centroids;
+		std::vector<uint32_t> m_order;
+		std::vector<Binary> m_binary;
+
+		int buildBinary(int first, int count, int depth) {
+			Box box, centroids;
+			for (int i = first; i < first + count; i++) {
+				box.grow(m_boxes[m_order[i]]);
+				centroids.grow(m_centroids[m_order[i]]);
+			}
+			int index = static_cast<int>(m_binary.size());
+			m_binary.push_back(Binary{ box, -1, -1, first, count });
+			// A leaf is tested in one go, so splitting one that fits gains nothing.
+			if (count <= BVH_WIDTH) {
+				return index;
+			}
+
+			int middle = first + count / 2;
+			if (depth < MAX_SAH_DEPTH) {
+				int axis;
+				float plane;
+				if (findSplit(first, count, centroids, axis, plane)) {
+					auto split = std::partition(m_order.begin() + first, m_order.begin() + first + count,
+						[&](uint32_t primitive) { return m_centroids[primitive][axis] < plane; });
+					middle = static_cast<int>(split - m_order.begin());
+				}
+				if (middle == first || middle == first + count) {
+					middle = first + count / 2;
+				}
+			}
+			int left = buildBinary(first, middle - first, depth + 1);
+			int right = buildBinary(middle, first + count - middle, depth + 1);
+			m_binary[index].left = left;
+			m_binary[index].right = right;
+			return index;
+		}
+
+		/**
+		 * @brief Finds the cheapest bin boundary to split the primitives at: the one
+		 * minimizing the surface area of each side times the primitives in it.
+		 * @return false if all the centroids coincide.
+		 */
+		bool findSplit(int first, int count, const Box& centroids, int& bestAxis, float& bestPlane) const {
+			float bestCost = NEVER;
+			bestAxis = -1;
+			for (int axis = 0; axis < 3; axis++) {
+				float low = centroids.min[axis];
+				float extent = centroids.max[axis] - low;
+				if (!(extent > 0.0f)) {
+					continue;
+				}
+				Box bins[SAH_BINS];
+				int counts[SAH_BINS] = {};
+				for (int i = first; i < first + count; i++) {
+					uint32_t primitive = m_order[i];
+					int bin = std::min(SAH_BINS - 1, static_cast<int>((m_centroids[primitive][axis] - low) / extent * SAH_BINS));
+					bins[bin].grow(m_boxes[primitive]);
+					counts[bin]++;
+				}
+				// The cost of every split, sweeping from the right and then from the left.
+				float rightCost[SAH_BINS];
+				Box side;
+				int sideCount = 0;
+				for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+					side.grow(bins[bin]);
+					sideCount += counts[bin];
+					rightCost[bin] = side.area() * sideCount;
+				}
+				side = Box();
+				sideCount = 0;
+				for (int bin = 1; bin < SAH_BINS; bin++) {
+					side.grow(bins[bin - 1]);
+					sideCount += counts[bin - 1];
+					float cost = side.area() * sideCount + rightCost[bin];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestPlane = low + extent * bin / SAH_BINS;
+					}
+				}
+			}
+			return bestAxis >= 0;
+		}
+
+		int emitWide(int binary) {
+			int index = static_cast<int>(nodes.size());
+			nodes.emplace_back();
+
+			int children[BVH_WIDTH];
+			int childCount = 0;
+			if (m_binary[binary].left < 0) {
+				children[childCount++] = binary;
+			}
+			else {
+				children[childCount++] = m_binary[binary].left;
+				children[childCount++] = m_binary[binary].right;
+			}
+			while (childCount < BVH_WIDTH) {
+				int largest = -1;
+				for (int i = 0; i < childCount; i++) {
+					const Binary& child = m_binary[children[i]];
+					if (child.left >= 0 && (largest < 0 || child.box.area() > m_binary[children[largest]].box.area())) {
+						largest = i;
+					}
+				}
+				if (largest < 0) {
+					break;
+				}
+				int opened = children[largest];
+				children[largest] = m_binary[opened].left;
+				children[childCount++] = m_binary[opened].right;
+			}
+
+			BvhNode node;
+			for (int slot = 0; slot < BVH_WIDTH; slot++) {
+				Box box;
+				node.child[slot] = ~0;
+				if (slot < childCount) {
+					const Binary& child = m_binary[children[slot]];
+					box = child.box;
+					if (child.left < 0) {
+						node.child[slot] = ~static_cast<int32_t>(leaves.size());
+						leaves.emplace_back(child.count, child.first);
+					}
+					else {
+						node.child[slot] = emitWide(children[slot]);
+					}
+				}
+				for (int axis = 0; axis < 3; axis++) {
+					node.bounds[0][axis][slot] = box.min[axis];
+					node.bounds[1][axis][slot] = box.max[axis];
+				}
+			}
+			nodes[index] = node;
+			return index;
+		}
+	};
+
+	/**
+	 * @brief A ray, prepared for box tests.
+	 */
+	struct Ray {
+		glm::vec3 origin;
+		glm::vec3 direction;
+		glm::vec3 inverse;
+		// Per axis: 1 if the ray runs toward lower coordinates, so it enters boxes at their
+		// maximum.
+		int negative[3];
+
+		Ray(const glm::vec3& origin, const glm::vec3& direction) : origin(origin), direction(direction) {
+			for (int axis = 0; axis < 3; axis++) {
+				// A tiny component instead of zero keeps the slab distances finite, where zero
+				// would make a NaN of a ray starting on a box face.
+				float d = direction[axis] != 0.0f ? direction[axis] : 1e-30f;
+				inverse[axis] = 1.0f / d;
+				negative[axis] = d < 0.0f ? 1 : 0;
+			}
+		}
+	};
+
+#if defined(__AVX2__)
+	using Lanes = Avx2Lanes4;
+	static_assert(Lanes::WIDTH == BVH_WIDTH);
+#else
+	using Lanes = ScalarLanes;
+#endif
+
+	/**
+	 * @brief Tests a ray against the boxes of a node's children.
+	 * @param entry receives, per child, where the ray enters its box.
+	 * @return a bit per child whose box the ray passes through before tBest.
+	 */
+	template <typename L>
+	int hitBoxes(const BvhNode& node, const Ray& ray, float tBest, float* entry) {
+		int hits = 0;
+		for (int i = 0; i < BVH_WIDTH; i += L::WIDTH) {
+			typename L::Float tNear = L::splat(0.0f), tFar = L::splat(tBest);
+			for (int axis = 0; axis < 3; axis++) {
+				auto origin = L::splat(ray.origin[axis]), inverse = L::splat(ray.inverse[axis]);
+				auto enter = L::mul(L::sub(L::load(&node.bounds[ray.negative[axis]][axis][i]), origin), inverse);
+				auto exit = L::mul(L::sub(L::load(&node.bounds[1 - ray.negative[axis]][axis][i]), origin), inverse);
+				tNear = L::max(enter, tNear);
+				tFar = L::min(exit, tFar);
+			}
+			L::store(&entry[i], tNear);
+			hits |= L::bits(L::lessEqual(tNear, tFar)) << i;
+		}
+		return hits;
+	}
+
+	/**
+	 * @brief Tests a ray against up to BVH_WIDTH triangles (Möller-Trumbore) given as
+	 * corners and edges, one lane each.
+	 * @param t, u, v receive, per triangle, the hit distance and barycentric coordinates.
+	 * @return a bit per triangle the ray hits before tBest.
+	 */
+	template <typename L>
+	int hitTriangles(const float (&corner)[3][BVH_WIDTH], const float (&edge1)[3][BVH_WIDTH],
+		const float (&edge2)[3][BVH_WIDTH], const Ray& ray, float tBest, float* t, float* u, float* v) {
+		auto dx = L::splat(ray.direction.x), dy = L::splat(ray.direction.y), dz = L::splat(ray.direction.z);
+		int hits = 0;
+		for (int i = 0; i < BVH_WIDTH; i += L::WIDTH) {
+			auto e1x = L::load(&edge1[0][i]), e1y = L::load(&edge1[1][i]), e1z = L::load(&edge1[2][i]);
+			auto e2x = L::load(&edge2[0][i]), e2y = L::load(&edge2[1][i]), e2z = L::load(&edge2[2][i]);
+			auto px = L::sub(L::mul(dy, e2z), L::mul(dz, e2y));
+			auto py = L::sub(L::mul(dz, e2x), L::mul(dx, e2z));
+			auto pz = L::sub(L::mul(dx, e2y), L::mul(dy, e2x));
+			auto det = L::add(L::add(L::mul(e1x, px), L::mul(e1y, py)), L::mul(e1z, pz));
+			auto inverse = L::div(L::splat(1.0f), det);
+
+			auto sx = L::sub(L::splat(ray.origin.x), L::load(&corner[0][i]));
+			auto sy = L::sub(L::splat(ray.origin.y), L::load(&corner[1][i]));
+			auto sz = L::sub(L::splat(ray.origin.z), L::load(&corner[2][i]));
+			auto laneU = L::mul(L::add(L::add(L::mul(sx, px), L::mul(sy, py)), L::mul(sz, pz)), inverse);
+			auto qx = L::sub(L::mul(sy, e1z), L::mul(sz, e1y));
+			auto qy = L::sub(L::mul(sz, e1x), L::mul(sx, e1z));
+			auto qz = L::sub(L::mul(sx, e1y), L::mul(sy, e1x));
+			auto laneV = L::mul(L::add(L::add(L::mul(dx, qx), L::mul(dy, qy)), L::mul(dz, qz)), inverse);
+			auto laneT = L::mul(L::add(L::add(L::mul(e2x, qx), L::mul(e2y, qy)), L::mul(e2z, qz)), inverse);
+
+			auto zero = L::splat(0.0f);
+			auto hit = L::both(L::notEqual(det, zero), L::both(L::lessEqual(zero, laneU), L::lessEqual(zero, laneV)));
+			hit = L::both(hit, L::lessEqual(L::add(laneU, laneV), L::splat(1.0f)));
+			hit = L::both(hit, L::both(L::lessEqual(zero, laneT), L::less(laneT, L::splat(tBest))));
+			L::store(&t[i], laneT);
+			L::store(&u[i], laneU);
+			L::store(&v[i], laneV);
+			hits |= L::bits(hit) << i;
+		}
+		return hits;
+	}
+
+	/**
+	 * @brief Walks a hierarchy front to back, handing every leaf the ray reaches to
+	 * testLeaf(leaf, tBest), which narrows tBest when it finds a nearer hit.
+	 */
+	template <typename TestLeaf>
+	void traverse(const std::vector<BvhNode>& nodes, const Ray& ray, float& tBest, TestLeaf&& testLeaf) {
+		if (nodes.empty()) {
+			return;
+		}
+		struct Entry {
+			int32_t child;
+			float entry;
+		};
+		Entry stack[STACK_SIZE];
+		int size = 0;
+		stack[size++] = Entry{ 0, 0.0f };
+		while (size > 0) {
+			Entry top = stack[--size];
+			if (top.entry > tBest) {
+				continue;
+			}
+			if (top.child < 0) {
+				testLeaf(~top.child, tBest);
+				continue;
+			}
+			const BvhNode& node = nodes[top.child];
+			alignas(16) float entry[BVH_WIDTH];
+			int hits = hitBoxes<Lanes>(node, ray, tBest, entry);
+			// Push the farthest child first, so the nearest is visited next.
+			int first = size;
+			for (int slot = 0; slot < BVH_WIDTH; slot++) {
+				if (hits & (1 << slot)) {
+					Entry pushed{ node.child[slot], entry[slot] };
+					int i = size++;
+					while (i > first && stack[i - 1].entry < pushed.entry) {
+						stack[i] = stack[i - 1];
+						i--;
+					}
+					stack[i] = pushed;
+				}
+			}
+		}
+	}
+}
+
+MeshBvh::MeshBvh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& faces)
+	: m_min(0.0f), m_max(0.0f), m_triangleCount(faces.size() / 3) {
+	std::vector<Box> boxes(m_triangleCount);
+	Box all;
+	for (size_t triangle = 0; triangle < m_triangleCount; triangle++) {
+		for (int corner = 0; corner < 3; corner++) {
+			boxes[triangle].grow(positions[faces[triangle * 3 + corner]]);
+		}
+		all.grow(boxes[triangle]);
+	}
+	if (m_triangleCount > 0) {
+		m_min = all.min;
+		m_max = all.max;
+	}
+
+	WideBuilder builder(boxes);
+	m_nodes = std::move(builder.nodes);
+	m_leaves.resize(builder.leaves.size());
+	for (size_t i = 0; i < builder.leaves.size(); i++) {
+		Leaf& leaf = m_leaves[i];
+		for (int lane = 0; lane < BVH_WIDTH; lane++) {
+			glm::vec3 a(0.0f), b(0.0f), c(0.0f);
+			leaf.triangle[lane] = 0;
+			if (lane < builder.leaves[i].x) {
+				uint32_t triangle = builder.order()[builder.leaves[i].y + lane];
+				a = positions[faces[triangle * 3]];
+				b = positions[faces[triangle * 3 + 1]];
+				c = positions[faces[triangle * 3 + 2]];
+				leaf.triangle[lane] = triangle;
+			}
+			for (int axis = 0; axis < 3; axis++) {
+				leaf.corner[axis][lane] = a[axis];
+				leaf.edge1[axis][lane] = b[axis] - a[axis];
+				leaf.edge2[axis][lane] = c[axis] - a[axis];
+			}
+		}
+	}
+}
+
+std::optional<MeshHit> MeshBvh::intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	Ray ray(origin, direction);
+	float tBest = maxDistance;
+	std::optional<MeshHit> nearest;
+	traverse(m_nodes, ray, tBest, [&](int leafIndex, float& best) {
+		const Leaf& leaf = m_leaves[leafIndex];
+		alignas(16) float t[BVH_WIDTH], u[BVH_WIDTH], v[BVH_WIDTH];
+		int hits = hitTriangles<Lanes>(leaf.corner, leaf.edge1, leaf.edge2, ray, best, t, u, v);
+		for (int lane = 0; lane < BVH_WIDTH; lane++) {
+			if ((hits & (1 << lane)) && t[lane] < best) {
+				best = t[lane];
+				nearest = MeshHit{ t[lane], leaf.triangle[lane], u[lane], v[lane] };
+			}
+		}
+	});
+	return nearest;
+}
+
+SceneBvh::SceneBvh(const std::vector<BvhInstance>& instances) : m_min(0.0f), m_max(0.0f) {
+	// Instances of empty meshes have no box, and could never be hit anyway.
+	std::vector<const BvhInstance*> placed;
+	placed.reserve(instances.size());
+	for (auto& instance : instances) {
+		if (instance.mesh->triangleCount() > 0) {
+			placed.push_back(&instance);
+		}
+	}
+
+	std::vector<Box> boxes(placed.size());
+	Box all;
+	for (size_t i = 0; i < placed.size(); i++) {
+		const MeshBvh& mesh = *placed[i]->mesh;
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 local(
+				corner & 1 ? mesh.boundsMax().x : mesh.boundsMin().x,
+				corner & 2 ? mesh.boundsMax().y : mesh.boundsMin().y,
+				corner & 4 ? mesh.boundsMax().z : mesh.boundsMin().z);
+			boxes[i].grow(glm::vec3(placed[i]->model * glm::vec4(local, 1.0f)));
+		}
+		all.grow(boxes[i]);
+	}
+	if (all.min.x <= all.max.x) {
+		m_min = all.min;
+		m_max = all.max;
+	}
+
+	WideBuilder builder(boxes);
+	m_nodes = std::move(builder.nodes);
+	m_leaves = std::move(builder.leaves);
+	m_instances.reserve(placed.size());
+	for (uint32_t i : builder.order()) {
+		m_instances.push_back(Placed{ placed[i]->mesh, glm::inverse(placed[i]->model), placed[i]->id });
+	}
+}
+
+std::optional<InstanceHit> SceneBvh::intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	Ray ray(origin, direction);
+	float tBest = maxDistance;
+	std::optional<InstanceHit> nearest;
+	traverse(m_nodes, ray, tBest, [&](int leafIndex, float& best) {
+		const glm::ivec2& leaf = m_leaves[leafIndex];
+		for (int i = leaf.y; i < leaf.y + leaf.x; i++) {
+			const Placed& instance = m_instances[i];
+			// An affine map keeps distances along the ray, as long as the direction is not
+			// renormalized.
+			glm::vec3 localOrigin(instance.toLocal * glm::vec4(origin, 1.0f));
+			glm::vec3 localDirection(instance.toLocal * glm::vec4(direction, 0.0f));
+			auto hit = instance.mesh->intersect(localOrigin, localDirection, best);
+			if (hit) {
+				best = hit->distance;
+				nearest = InstanceHit{ instance.id, *hit };
+			}
+		}
+	});
+	return nearest;
+}
+
+void SceneBvh::benchmark(int rayCount) const {
+	size_t triangles = 0;
+	for (auto& instance : m_instances) {
+		triangles += instance.mesh->triangleCount();
+	}
+	// Rays from all around the scene's bounds, toward random points inside them.
+	glm::vec3 center = (m_min + m_max) * 0.5f;
+	float radius = glm::length(m_max - m_min) * 0.5f + 1.0f;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::vec3> origins, directions;
+	origins.reserve(rayCount);
+	directions.reserve(rayCount);
+	for (int i = 0; i < rayCount; i++) {
+		float z = unit(random) * 2.0f - 1.0f;
+		float angle = unit(random) * 6.2831853f;
+		float ring = std::sqrt(1.0f - z * z);
+		glm::vec3 origin = center + radius * glm::vec3(ring * std::cos(angle), z, ring * std::sin(angle));
+		glm::vec3 target = m_min + (m_max - m_min) * glm::vec3(unit(random), unit(random), unit(random));
+		origins.push_back(origin);
+		directions.push_back(glm::normalize(target - origin));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	int hits = 0;
+	for (int i = 0; i < rayCount; i++) {
+		if (intersect(origins[i], directions[i], NEVER)) {
+			hits++;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#if defined(__AVX2__)
+	const char* path = "SIMD";
+#else
+	const char* path = "scalar";
+#endif
+	std::cout << "Picking benchmark (" << path << " tests), " << rayCount << " rays over "
+		<< m_instances.size() << " instances of " << triangles << " triangles: "
+		<< rayCount / std::max(seconds, 1e-9) << " rays/s, "
+		<< (rayCount > 0 ? 100.0 * hits / rayCount : 0.0) << "% hit" << std::endl;
+}
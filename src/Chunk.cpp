@@ -0,0 +1,276 @@
+#include "Chunk.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	// Saved chunks start with this; bump it when the format changes.
+	constexpr uint8_t CHUNK_FORMAT_VERSION = 1;
+
+	// Values are stored in host byte order, which is little-endian on every platform this
+	// project targets.
+	template <typename T>
+	void append(std::vector<uint8_t>& out, const T* values, size_t count) {
+		auto bytes = reinterpret_cast<const uint8_t*>(values);
+		out.insert(out.end(), bytes, bytes + count * sizeof(T));
+	}
+
+	template <typename T>
+	void consume(const uint8_t*& cursor, const uint8_t* end, T* values, size_t count) {
+		size_t size = count * sizeof(T);
+		if (static_cast<size_t>(end - cursor) < size) {
+			throw std::runtime_error("Saved chunk data is truncated");
+		}
+		std::memcpy(values, cursor, size);
+		cursor += size;
+	}
+}
+
+ChunkSection::ChunkSection(BlockId fill)
+	: m_palette{ fill }, m_bits(0), m_solidCount(fill != Blocks::AIR ? SECTION_VOLUME : 0) {
+}
+
+ChunkSection::ChunkSection(const BlockId* blocks) : m_bits(0), m_solidCount(0) {
+	std::array<uint32_t, SECTION_VOLUME> entries;
+	uint32_t last = 0;
+	m_palette.push_back(blocks[0]);
+	for (int i = 0; i < SECTION_VOLUME; i++) {
+		m_solidCount += blocks[i] != Blocks::AIR;
+		// Runs of the same block are the common case.
+		if (m_palette[last] != blocks[i]) {
+			auto found = std::find(m_palette.begin(), m_palette.end(), blocks[i]);
+			last = static_cast<uint32_t>(found - m_palette.begin());
+			if (found == m_palette.end()) {
+				m_palette.push_back(blocks[i]);
+			}
+		}
+		entries[i] = last;
+	}
+
+	while ((1u << m_bits) < m_palette.size()) {
+		m_bits = m_bits == 0 ? 1 : m_bits * 2;
+	}
+	m_words.assign(SECTION_VOLUME * m_bits / 64, 0);
+	for (int i = 0; m_bits != 0 && i < SECTION_VOLUME; i++) {
+		uint32_t bit = i * m_bits;
+		m_words[bit >> 6] |= uint64_t(entries[i]) << (bit & 63);
+	}
+}
+
+void ChunkSection::set(int x, int y, int z, BlockId block) {
+	int i = index(x, y, z);
+	BlockId current = m_palette[paletteIndex(i)];
+	if (current == block) {
+		return;
+	}
+	m_solidCount += (block != Blocks::AIR) - (current != Blocks::AIR);
+
+	// Palettes stay small, so a linear search beats any lookup structure.
+	auto found = std::find(m_palette.begin(), m_palette.end(), block);
+	uint32_t entry = static_cast<uint32_t>(found - m_palette.begin());
+	if (found == m_palette.end()) {
+		m_palette.push_back(block);
+		if (entry >= (1u << m_bits)) {
+			widen();
+		}
+	}
+	setPaletteIndex(i, entry);
+}
+
+void ChunkSection::setPaletteIndex(int i, uint32_t entry) {
+	uint32_t bit = i * m_bits;
+	uint64_t mask = ((uint64_t(1) << m_bits) - 1) << (bit & 63);
+	uint64_t& word = m_words[bit >> 6];
+	word = (word & ~mask) | (uint64_t(entry) << (bit & 63));
+}
+
+void ChunkSection::widen() {
+	uint32_t oldBits = m_bits;
+	m_bits = oldBits == 0 ? 1 : oldBits * 2;
+	m_words.resize(SECTION_VOLUME * m_bits / 64, 0);
+	if (oldBits == 0) {
+		return; // Every index is 0, which the zeroed words already say.
+	}
+
+	// Repack back to front: entry i moves from bit i * oldBits to bit 2 * i * oldBits, which
+	// only overlaps entries 2i and 2i + 1, both already moved.
+	uint64_t oldMask = (uint64_t(1) << oldBits) - 1;
+	for (int i = SECTION_VOLUME - 1; i >= 0; i--) {
+		uint32_t bit = i * oldBits;
+		uint32_t entry = static_cast<uint32_t>((m_words[bit >> 6] >> (bit & 63)) & oldMask);
+		setPaletteIndex(i, entry);
+	}
+}
+
+void ChunkSection::unpack(BlockId* out) const {
+	if (m_bits == 0) {
+		std::fill(out, out + SECTION_VOLUME, m_palette[0]);
+		return;
+	}
+	int perWord = 64 / m_bits;
+	uint64_t mask = (uint64_t(1) << m_bits) - 1;
+	for (uint64_t word : m_words) {
+		for (int j = 0; j < perWord; j++) {
+			*out++ = m_palette[word & mask];
+			word >>= m_bits;
+		}
+	}
+}
+
+size_t ChunkSection::memoryUsage() const {
+	return sizeof(ChunkSection) + m_palette.capacity() * sizeof(BlockId) + m_words.capacity() * sizeof(uint64_t);
+}
+
+void ChunkSection::serialize(std::vector<uint8_t>& out) const {
+	uint16_t paletteSize = static_cast<uint16_t>(m_palette.size());
+	uint8_t bits = static_cast<uint8_t>(m_bits);
+	append(out, &paletteSize, 1);
+	append(out, m_palette.data(), m_palette.size());
+	append(out, &bits, 1);
+	append(out, m_words.data(), m_words.size());
+}
+
+std::shared_ptr<ChunkSection> ChunkSection::deserialize(const uint8_t*& cursor, const uint8_t* end) {
+	auto section = std::make_shared<ChunkSection>();
+	uint16_t paletteSize;
+	consume(cursor, end, &paletteSize, 1);
+	section->m_palette.resize(paletteSize);
+	consume(cursor, end, section->m_palette.data(), paletteSize);
+	uint8_t bits;
+	consume(cursor, end, &bits, 1);
+	bool validBits = bits == 0 || bits == 1 || bits == 2 || bits == 4 || bits == 8 || bits == 16;
+	if (paletteSize == 0 || !validBits || (1u << bits) < paletteSize) {
+		throw std::runtime_error("Saved chunk section has an invalid palette");
+	}
+	// Block properties are looked up by id without a range check.
+	for (BlockId block : section->m_palette) {
+		if (block >= Blocks::COUNT) {
+			throw std::runtime_error("Saved chunk section has an unknown block id " + std::to_string(block));
+		}
+	}
+	section->m_bits = bits;
+	section->m_words.resize(SECTION_VOLUME * bits / 64);
+	consume(cursor, end, section->m_words.data(), section->m_words.size());
+
+	// Check every index while counting solid blocks, so get() can trust them.
+	section->m_solidCount = 0;
+	for (int i = 0; i < SECTION_VOLUME; i++) {
+		uint32_t entry = section->paletteIndex(i);
+		if (entry >= paletteSize) {
+			throw std::runtime_error("Saved chunk section has an index outside its palette");
+		}
+		section->m_solidCount += section->m_palette[entry] != Blocks::AIR;
+	}
+	return section;
+}
+
+void ChunkSnapshot::serialize(std::vector<uint8_t>& out) const {
+	uint8_t header[2] = { CHUNK_FORMAT_VERSION, 0 };
+	for (int sy = 0; sy < SECTION_COUNT; sy++) {
+		header[1] |= (sections[sy] != nullptr) << sy;
+	}
+	append(out, header, 2);
+	for (auto& section : sections) {
+		if (section) {
+			section->serialize(out);
+		}
+	}
+}
+
+Chunk::Chunk(ChunkPos pos) : m_pos(pos) {
+}
+
+ChunkSnapshot Chunk::snapshot() const {
+	ChunkSnapshot snapshot{ m_pos };
+	for (int sy = 0; sy < SECTION_COUNT; sy++) {
+		snapshot.sections[sy] = m_sections[sy];
+	}
+	return snapshot;
+}
+
+std::unique_ptr<Chunk> Chunk::deserialize(ChunkPos pos, const uint8_t* data, size_t size) {
+	const uint8_t* end = data + size;
+	uint8_t header[2];
+	consume(data, end, header, 2);
+	if (header[0] != CHUNK_FORMAT_VERSION) {
+		throw std::runtime_error("Saved chunk has unknown format version " + std::to_string(header[0]));
+	}
+	auto chunk = std::make_unique<Chunk>(pos);
+	for (int sy = 0; sy < SECTION_COUNT; sy++) {
+		if (header[1] & (1 << sy)) {
+			chunk->setSection(sy, ChunkSection::deserialize(data, end));
+		}
+	}
+	return chunk;
+}
+
+BlockId Chunk::getBlock(int x, int y, int z) const {
+	if (y < 0 || y >= CHUNK_HEIGHT) {
+		return Blocks::AIR;
+	}
+	auto& section = m_sections[y / CHUNK_SIZE];
+	return section ? section->get(x, y % CHUNK_SIZE, z) : Blocks::AIR;
+}
+
+void Chunk::setBlock(int x, int y, int z, BlockId block) {
+	if (y < 0 || y >= CHUNK_HEIGHT) {
+		return;
+	}
+	auto& section = m_sections[y / CHUNK_SIZE];
+	if (!section) {
+		if (block == Blocks::AIR) {
+			return;
+		}
+		section = std::make_shared<ChunkSection>();
+	}
+	else if (section.use_count() > 1) {
+		// A mesher (or saver) still reads this section; give them the old copy.
+		section = std::make_shared<ChunkSection>(*section);
+	}
+	section->set(x, y % CHUNK_SIZE, z, block);
+	if (section->isEmpty()) {
+		section.reset();
+	}
+}
+
+uint8_t Chunk::getLight(int x, int y, int z) const {
+	if (y < 0) {
+		return 0;
+	}
+	if (y >= CHUNK_HEIGHT) {
+		return FULL_SKY_LIGHT;
+	}
+	auto& light = m_light[y / CHUNK_SIZE];
+	return light ? (*light)[ChunkSection::index(x, y % CHUNK_SIZE, z)] : FULL_SKY_LIGHT;
+}
+
+void Chunk::setLight(int x, int y, int z, uint8_t light) {
+	if (y < 0 || y >= CHUNK_HEIGHT) {
+		return;
+	}
+	auto& section = m_light[y / CHUNK_SIZE];
+	if (!section) {
+		if (light == FULL_SKY_LIGHT) {
+			return;
+		}
+		section = std::make_shared<LightSection>();
+		section->fill(FULL_SKY_LIGHT);
+	}
+	else if (section.use_count() > 1) {
+		section = std::make_shared<LightSection>(*section);
+	}
+	(*section)[ChunkSection::index(x, y % CHUNK_SIZE, z)] = light;
+}
+
+void Chunk::setSection(int sectionY, std::shared_ptr<ChunkSection> section) {
+	m_sections[sectionY] = section && !section->isEmpty() ? std::move(section) : nullptr;
+}
+
+size_t Chunk::memoryUsage() const {
+	size_t bytes = 0;
+	for (auto& section : m_sections) {
+		bytes += section ? section->memoryUsage() : 0;
+	}
+	return bytes;
+}
@@ -0,0 +1,85 @@
+#include "ChunkMesh.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <utility>
+
+ChunkMesh::ChunkMesh() : m_front(0) {
+}
+
+ChunkMesh::~ChunkMesh() {
+	release(m_buffers[0]);
+	release(m_buffers[1]);
+}
+
+ChunkMesh::ChunkMesh(ChunkMesh&& other) noexcept
+	: m_buffers{ std::exchange(other.m_buffers[0], Buffers()), std::exchange(other.m_buffers[1], Buffers()) },
+	m_front(other.m_front) {
+}
+
+ChunkMesh& ChunkMesh::operator=(ChunkMesh&& other) noexcept {
+	if (this != &other) {
+		release(m_buffers[0]);
+		release(m_buffers[1]);
+		m_buffers[0] = std::exchange(other.m_buffers[0], Buffers());
+		m_buffers[1] = std::exchange(other.m_buffers[1], Buffers());
+		m_front = other.m_front;
+	}
+	return *this;
+}
+
+void ChunkMesh::release(Buffers& buffers) {
+	if (buffers.vao != 0) {
+		glDeleteVertexArrays(1, &buffers.vao);
+		glDeleteBuffers(1, &buffers.vbo);
+		glDeleteBuffers(1, &buffers.ebo);
+	}
+	buffers = Buffers();
+}
+
+void ChunkMesh::upload(const ChunkMeshData& data) {
+	if (data.indices.empty()) {
+		release(m_buffers[0]);
+		release(m_buffers[1]);
+		return;
+	}
+
+	// Write the set that is not being drawn; the GPU may still be reading the other one.
+	Buffers& back = m_buffers[1 - m_front];
+	if (back.vao == 0) {
+		glGenVertexArrays(1, &back.vao);
+		glGenBuffers(1, &back.vbo);
+		glGenBuffers(1, &back.ebo);
+		glBindVertexArray(back.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, back.vbo);
+		// Both words stay integers; the vertex shader unpacks them.
+		glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)offsetof(ChunkVertex, geometry));
+		glEnableVertexAttribArray(0);
+		glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)offsetof(ChunkVertex, lighting));
+		glEnableVertexAttribArray(1);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, back.ebo);
+	}
+	else {
+		glBindVertexArray(back.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, back.vbo);
+	}
+
+	size_t vertexBytes = data.vertices.size() * sizeof(ChunkVertex);
+	size_t indexBytes = data.indices.size() * sizeof(uint16_t);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, data.vertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, data.indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+
+	back.indexCount = static_cast<uint32_t>(data.indices.size());
+	back.bytes = vertexBytes + indexBytes;
+	m_front = 1 - m_front;
+}
+
+void ChunkMesh::render() const {
+	const Buffers& front = m_buffers[m_front];
+	if (front.indexCount == 0) {
+		return;
+	}
+	glBindVertexArray(front.vao);
+	glDrawElements(GL_TRIANGLES, front.indexCount, GL_UNSIGNED_SHORT, nullptr);
+	glBindVertexArray(0);
+}
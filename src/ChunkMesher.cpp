@@ -0,0 +1,222 @@
+#include "ChunkMesher.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace {
+	// The section plus a one-block border on every side.
+	constexpr int PADDED = CHUNK_SIZE + 2;
+
+	int paddedIndex(int x, int y, int z) {
+		return ((y + 1) * PADDED + (z + 1)) * PADDED + (x + 1);
+	}
+
+	/**
+	 * @brief A block face: its normal, and the corner and edges of its quad, chosen so that
+	 * cross(u, v) == normal and the quad winds counter-clockwise seen from outside.
+	 */
+	struct FaceDirection {
+		glm::ivec3 normal;
+		glm::ivec3 origin;
+		glm::ivec3 u;
+		glm::ivec3 v;
+	};
+
+	// The index of a face in this table is packed into its vertices; shaders/chunk.vert has
+	// the same order.
+	const FaceDirection FACES[6] = {
+		{ { 1, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+		{ { -1, 0, 0 }, { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+		{ { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },
+		{ { 0, -1, 0 }, { 0, 0, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+		{ { 0, 0, 1 }, { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, -1 }, { 0, 0, 0 }, { 0, 1, 0 }, { 1, 0, 0 } },
+	};
+
+	/**
+	 * @brief Copies the center section and the one-block shell around it into flat arrays
+	 * of blocks and light, so the face loop never has to care about section borders.
+	 */
+	void gatherPadded(const SectionNeighborhood& neighborhood, std::vector<BlockId>& padded,
+		std::vector<uint8_t>& paddedLight) {
+		padded.assign(PADDED * PADDED * PADDED, Blocks::AIR);
+		paddedLight.assign(PADDED * PADDED * PADDED, FULL_SKY_LIGHT);
+
+		// The center is decoded in one pass; only the shell reads blocks one at a time.
+		std::array<BlockId, SECTION_VOLUME> center;
+		neighborhood.at(0, 0, 0)->unpack(center.data());
+		const LightSection* centerLight = neighborhood.lightAt(0, 0, 0);
+		for (int y = 0; y < CHUNK_SIZE; y++) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				int row = ChunkSection::index(0, y, z);
+				std::copy_n(&center[row], CHUNK_SIZE, &padded[paddedIndex(0, y, z)]);
+				if (centerLight != nullptr) {
+					std::copy_n(&(*centerLight)[row], CHUNK_SIZE, &paddedLight[paddedIndex(0, y, z)]);
+				}
+			}
+		}
+
+		for (int y = -1; y <= CHUNK_SIZE; y++) {
+			int sy = y < 0 ? -1 : (y >= CHUNK_SIZE ? 1 : 0);
+			for (int z = -1; z <= CHUNK_SIZE; z++) {
+				int sz = z < 0 ? -1 : (z >= CHUNK_SIZE ? 1 : 0);
+				for (int x = -1; x <= CHUNK_SIZE; x++) {
+					int sx = x < 0 ? -1 : (x >= CHUNK_SIZE ? 1 : 0);
+					if (sx == 0 && sy == 0 && sz == 0) {
+						continue;
+					}
+					int lx = x - sx * CHUNK_SIZE, ly = y - sy * CHUNK_SIZE, lz = z - sz * CHUNK_SIZE;
+					const ChunkSection* section = neighborhood.at(sx, sy, sz);
+					if (section != nullptr) {
+						padded[paddedIndex(x, y, z)] = section->get(lx, ly, lz);
+					}
+					const LightSection* light = neighborhood.lightAt(sx, sy, sz);
+					if (light != nullptr) {
+						paddedLight[paddedIndex(x, y, z)] = (*light)[ChunkSection::index(lx, ly, lz)];
+					}
+				}
+			}
+		}
+	}
+
+	// One bit per block of a padded row along x, set where the block is opaque. A face's
+	// visibility and the occlusion at its corners are then bit tests on a couple of KiB.
+	using OpaqueRows = std::array<uint32_t, PADDED * PADDED>;
+
+	int rowIndex(int y, int z) {
+		return (y + 1) * PADDED + (z + 1);
+	}
+
+	bool opaqueAt(const OpaqueRows& rows, const glm::ivec3& block) {
+		return (rows[rowIndex(block.y, block.z)] >> (block.x + 1)) & 1;
+	}
+
+	// Also marks the water in rows of the same layout.
+	void buildOpaqueRows(const std::vector<BlockId>& padded, OpaqueRows& rows, OpaqueRows& water) {
+		for (int y = -1; y <= CHUNK_SIZE; y++) {
+			for (int z = -1; z <= CHUNK_SIZE; z++) {
+				const BlockId* row = &padded[paddedIndex(-1, y, z)];
+				uint32_t bits = 0, waterBits = 0;
+				for (int i = 0; i < PADDED; i++) {
+					bits |= static_cast<uint32_t>(isOpaque(row[i])) << i;
+					waterBits |= static_cast<uint32_t>(isWater(row[i])) << i;
+				}
+				rows[rowIndex(y, z)] = bits;
+				water[rowIndex(y, z)] = waterBits;
+			}
+		}
+	}
+
+	// The faces of the blocks in `blocks` (a row's worth of bits) that are not covered by
+	// the matching bits of the rows around them, per face.
+	void visibleFaces(const OpaqueRows& cover, uint32_t blocks, int y, int z, bool worldBottom, uint32_t visible[6]) {
+		visible[0] = blocks & ~(cover[rowIndex(y, z)] >> 1);
+		visible[1] = blocks & ~(cover[rowIndex(y, z)] << 1);
+		visible[2] = blocks & ~cover[rowIndex(y + 1, z)];
+		visible[3] = y == 0 && worldBottom ? 0 : blocks & ~cover[rowIndex(y - 1, z)];
+		visible[4] = blocks & ~cover[rowIndex(y, z + 1)];
+		visible[5] = blocks & ~cover[rowIndex(y, z - 1)];
+	}
+
+	/**
+	 * @brief Appends the quad of one visible face, with ambient occlusion and smooth light at
+	 * each corner.
+	 *
+	 * A corner is darkened by the opaque blocks among the two beside it and the one
+	 * diagonally across it, in the layer the face looks into; with both sides opaque the
+	 * corner is fully occluded whatever the diagonal holds. Its light is the average over
+	 * the open blocks of those four (the faced block included), so light fades smoothly
+	 * across faces instead of stepping per block.
+	 */
+	void emitFace(ChunkMeshData& mesh, int faceIndex, const glm::ivec3& block, uint16_t layer, const OpaqueRows& opaque,
+		const std::vector<uint8_t>& paddedLight) {
+		// Corner i of the quad lies toward -u or +u, and -v or +v.
+		const int SIGNS[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+		const FaceDirection& face = FACES[faceIndex];
+		glm::ivec3 facing = block + face.normal;
+		uint8_t facingLight = paddedLight[paddedIndex(facing.x, facing.y, facing.z)];
+		glm::ivec3 origin = block + face.origin;
+		uint16_t base = static_cast<uint16_t>(mesh.vertices.size());
+		int occlusion[4];
+		for (int i = 0; i < 4; i++) {
+			glm::ivec3 side1 = facing + SIGNS[i][0] * face.u;
+			glm::ivec3 side2 = facing + SIGNS[i][1] * face.v;
+			glm::ivec3 diagonal = side1 + SIGNS[i][1] * face.v;
+			bool opaque1 = opaqueAt(opaque, side1), opaque2 = opaqueAt(opaque, side2);
+			bool opaqueDiagonal = opaqueAt(opaque, diagonal);
+			occlusion[i] = opaque1 && opaque2 ? 0 : 3 - (opaque1 + opaque2 + opaqueDiagonal);
+
+			int sky = skyLight(facingLight), glow = blockLight(facingLight), count = 1;
+			auto sample = [&](const glm::ivec3& p) {
+				uint8_t light = paddedLight[paddedIndex(p.x, p.y, p.z)];
+				sky += skyLight(light);
+				glow += blockLight(light);
+				count++;
+			};
+			if (!opaque1) {
+				sample(side1);
+			}
+			if (!opaque2) {
+				sample(side2);
+			}
+			if (!opaqueDiagonal && !(opaque1 && opaque2)) {
+				sample(diagonal);
+			}
+
+			float scale = 1.0f / (count * MAX_LIGHT);
+			glm::ivec3 position = origin + (SIGNS[i][0] + 1) / 2 * face.u + (SIGNS[i][1] + 1) / 2 * face.v;
+			mesh.vertices.push_back(ChunkVertex::pack(position, faceIndex, i, occlusion[i], layer, sky * scale, glow * scale));
+		}
+
+		// Split the quad along the diagonal whose corners are less occluded than the other
+		// pair; splitting along the other one makes the shading visibly anisotropic.
+		const uint16_t SPLIT_02[6] = { 0, 1, 2, 0, 2, 3 };
+		const uint16_t SPLIT_13[6] = { 1, 2, 3, 1, 3, 0 };
+		const uint16_t* split = occlusion[0] + occlusion[2] < occlusion[1] + occlusion[3] ? SPLIT_13 : SPLIT_02;
+		for (int i = 0; i < 6; i++) {
+			mesh.indices.push_back(static_cast<uint16_t>(base + split[i]));
+		}
+	}
+}
+
+ChunkMeshData meshSection(const SectionNeighborhood& neighborhood) {
+	ChunkMeshData mesh;
+	const ChunkSection* center = neighborhood.at(0, 0, 0);
+	if (center == nullptr || center->isEmpty()) {
+		return mesh;
+	}
+
+	std::vector<BlockId> padded;
+	std::vector<uint8_t> paddedLight;
+	gatherPadded(neighborhood, padded, paddedLight);
+	OpaqueRows opaque, water, wet;
+	buildOpaqueRows(padded, opaque, water);
+	for (size_t i = 0; i < opaque.size(); i++) {
+		wet[i] = opaque[i] | water[i];
+	}
+
+	// Whole rows at a time: a face is visible where a solid block's neighbor is not opaque,
+	// so the visible faces of a row are a few shifts and masks of the rows around it. Water
+	// shows where it meets neither opaque blocks nor more water.
+	constexpr uint32_t CENTER_BITS = ((1u << CHUNK_SIZE) - 1) << 1;
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int z = 0; z < CHUNK_SIZE; z++) {
+			uint32_t solid = opaque[rowIndex(y, z)] & CENTER_BITS;
+			uint32_t liquid = water[rowIndex(y, z)] & CENTER_BITS;
+			if ((solid | liquid) == 0) {
+				continue;
+			}
+			uint32_t visible[6], visibleWater[6];
+			visibleFaces(opaque, solid, y, z, neighborhood.worldBottom, visible);
+			visibleFaces(wet, liquid, y, z, neighborhood.worldBottom, visibleWater);
+			for (int f = 0; f < 6; f++) {
+				for (uint32_t bits = visible[f] | visibleWater[f]; bits != 0; bits &= bits - 1) {
+					int x = std::countr_zero(bits) - 1;
+					emitFace(mesh, f, glm::ivec3(x, y, z), textureLayer(padded[paddedIndex(x, y, z)], f), opaque, paddedLight);
+				}
+			}
+		}
+	}
+	return mesh;
+}
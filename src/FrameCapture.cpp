@@ -0,0 +1,265 @@
+#include "FrameCapture.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "StbImage.h"
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	constexpr uint32_t SHARED_CAPTURE_MAGIC = 0x50414347; // "GCAP"
+	constexpr uint32_t SHARED_CAPTURE_VERSION = 1;
+	// Marks a slot that is being overwritten.
+	constexpr uint64_t SLOT_WRITING = UINT64_MAX;
+
+	double secondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+FrameCapture::FrameCapture(int width, int height, CaptureFormat format, const std::string& destination)
+	: m_width(width), m_height(height), m_format(format), m_buffers{}, m_queuedReads(0), m_capturedFrames(0),
+	m_droppedFrames(0), m_captureSeconds(0.0), m_stopping(false), m_writeSeconds(0.0), m_shared(nullptr), m_sharedSize(0) {
+#ifdef _WIN32
+	m_mapping = nullptr;
+#endif
+	if (format == CaptureFormat::SharedMemory) {
+		openShared(destination);
+	}
+	else {
+		m_directory = destination;
+		std::filesystem::create_directories(m_directory);
+		if (format == CaptureFormat::Raw) {
+			m_raw = std::make_unique<std::ofstream>(m_directory / "capture.rgb", std::ios::binary | std::ios::trunc);
+			if (!*m_raw) {
+				throw std::runtime_error("Could not open " + (m_directory / "capture.rgb").string());
+			}
+		}
+	}
+
+	size_t frameBytes = static_cast<size_t>(width) * height * 3;
+	glGenBuffers(RING_SIZE, m_buffers.data());
+	for (GLuint buffer : m_buffers) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_writer = std::thread(&FrameCapture::writeLoop, this);
+}
+
+FrameCapture::~FrameCapture() {
+	// The last reads are still in flight; these maps wait for them.
+	for (uint64_t frame = m_queuedReads < RING_SIZE - 1 ? 0 : m_queuedReads - (RING_SIZE - 1); frame < m_queuedReads; frame++) {
+		collect(frame);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_queueChanged.notify_all();
+	m_writer.join();
+	glDeleteBuffers(RING_SIZE, m_buffers.data());
+	closeShared();
+
+	if (m_queuedReads > 0) {
+		double elapsed = std::chrono::duration<double>(m_lastCapture - m_firstCapture).count();
+		uint64_t written = m_capturedFrames - m_droppedFrames;
+		std::cout << "Captured " << m_capturedFrames << " frames (" << m_droppedFrames << " dropped): "
+			<< m_captureSeconds * 1000.0 / m_queuedReads << " ms per frame on the render thread, "
+			<< (written > 0 ? m_writeSeconds * 1000.0 / written : 0.0) << " ms writing each, "
+			<< (elapsed > 0.0 ? (m_queuedReads - 1) / elapsed : 0.0) << " FPS while capturing" << std::endl;
+	}
+}
+
+void FrameCapture::capture() {
+	auto start = std::chrono::steady_clock::now();
+	if (m_queuedReads == 0) {
+		m_firstCapture = start;
+	}
+	m_lastCapture = start;
+
+	// The read lands in the buffer, so glReadPixels returns without waiting for the frame.
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[m_queuedReads % RING_SIZE]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_queuedReads++;
+
+	// The read from two frames ago has finished by now, and its buffer is the next one due.
+	if (m_queuedReads >= RING_SIZE) {
+		collect(m_queuedReads - RING_SIZE);
+	}
+	m_captureSeconds += secondsSince(start);
+}
+
+void FrameCapture::collect(uint64_t frame) {
+	m_capturedFrames++;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		if (m_queue.size() >= MAX_QUEUED_FRAMES) {
+			m_droppedFrames++;
+			return;
+		}
+	}
+
+	size_t frameBytes = static_cast<size_t>(m_width) * m_height * 3;
+	Frame captured{ frame, std::vector<uint8_t>(frameBytes) };
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[frame % RING_SIZE]);
+	auto* pixels = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT));
+	if (pixels == nullptr) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		m_droppedFrames++;
+		return;
+	}
+	std::memcpy(captured.pixels.data(), pixels, frameBytes);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queue.push_back(std::move(captured));
+	}
+	m_queueChanged.notify_one();
+}
+
+void FrameCapture::writeLoop() {
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	while (true) {
+		m_queueChanged.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+		if (m_queue.empty()) {
+			return;
+		}
+		Frame frame = std::move(m_queue.front());
+		m_queue.pop_front();
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		try {
+			write(frame);
+		}
+		catch (const std::runtime_error& error) {
+			std::cout << "Could not write captured frame " << frame.number << ": " << error.what() << std::endl;
+		}
+		double seconds = secondsSince(start);
+
+		lock.lock();
+		m_writeSeconds += seconds;
+	}
+}
+
+void FrameCapture::write(const Frame& frame) {
+	size_t rowSize = static_cast<size_t>(m_width) * 3;
+	// OpenGL's first row is the bottom one.
+	auto flip = [&](uint8_t* out) {
+		for (int y = 0; y < m_height; y++) {
+			std::memcpy(out + y * rowSize, &frame.pixels[(m_height - 1 - y) * rowSize], rowSize);
+		}
+	};
+
+	if (m_format == CaptureFormat::Png) {
+		auto pixels = std::make_unique<unsigned char[]>(frame.pixels.size());
+		flip(pixels.get());
+		StbImage image;
+		image.setPixels(m_width, m_height, 3, std::move(pixels));
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(frame.number));
+		image.saveToPng((m_directory / name).string());
+	}
+	else if (m_format == CaptureFormat::Raw) {
+		for (int y = m_height - 1; y >= 0; y--) {
+			m_raw->write(reinterpret_cast<const char*>(&frame.pixels[y * rowSize]), rowSize);
+		}
+		if (!*m_raw) {
+			throw std::runtime_error("the disk is full or the file was closed");
+		}
+	}
+	else {
+		auto* header = reinterpret_cast<SharedCaptureHeader*>(m_shared);
+		std::atomic_ref<uint64_t> written(header->written);
+		uint64_t index = written.load(std::memory_order_relaxed);
+		uint8_t* slot = m_shared + sizeof(SharedCaptureHeader) + (index % SHARED_CAPTURE_SLOTS) * header->slotBytes;
+		std::atomic_ref<uint64_t> number(*reinterpret_cast<uint64_t*>(slot));
+		number.store(SLOT_WRITING, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		flip(slot + sizeof(uint64_t));
+		number.store(frame.number, std::memory_order_release);
+		written.store(index + 1, std::memory_order_release);
+	}
+}
+
+void FrameCapture::openShared(const std::string& name) {
+	uint32_t slotBytes = static_cast<uint32_t>(sizeof(uint64_t) + static_cast<size_t>(m_width) * m_height * 3);
+	// Keep every slot's frame number 8-byte aligned.
+	slotBytes = (slotBytes + 7) & ~7u;
+	m_sharedSize = sizeof(SharedCaptureHeader) + static_cast<size_t>(slotBytes) * SHARED_CAPTURE_SLOTS;
+
+#ifdef _WIN32
+	m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<uint64_t>(m_sharedSize) >> 32), static_cast<DWORD>(m_sharedSize), name.c_str());
+	if (m_mapping == nullptr) {
+		throw std::runtime_error("Could not create shared memory " + name);
+	}
+	m_shared = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_sharedSize));
+	if (m_shared == nullptr) {
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+		throw std::runtime_error("Could not map shared memory " + name);
+	}
+#else
+	// POSIX names start with a slash.
+	m_sharedName = "/" + name;
+	int file = shm_open(m_sharedName.c_str(), O_RDWR | O_CREAT, 0600);
+	if (file < 0) {
+		throw std::runtime_error("Could not create shared memory " + name);
+	}
+	if (ftruncate(file, static_cast<off_t>(m_sharedSize)) != 0) {
+		close(file);
+		shm_unlink(m_sharedName.c_str());
+		throw std::runtime_error("Could not size shared memory " + name);
+	}
+	void* view = mmap(nullptr, m_sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (view == MAP_FAILED) {
+		shm_unlink(m_sharedName.c_str());
+		throw std::runtime_error("Could not map shared memory " + name);
+	}
+	m_shared = static_cast<uint8_t*>(view);
+#endif
+
+	std::memset(m_shared, 0, sizeof(SharedCaptureHeader));
+	auto* header = reinterpret_cast<SharedCaptureHeader*>(m_shared);
+	header->version = SHARED_CAPTURE_VERSION;
+	header->width = m_width;
+	header->height = m_height;
+	header->slotCount = SHARED_CAPTURE_SLOTS;
+	header->slotBytes = slotBytes;
+	// A reader that sees the magic sees the rest of the header.
+	std::atomic_ref<uint32_t>(header->magic).store(SHARED_CAPTURE_MAGIC, std::memory_order_release);
+	std::cout << "Capturing " << m_width << "x" << m_height << " frames into shared memory " << name << std::endl;
+}
+
+void FrameCapture::closeShared() {
+	if (m_shared == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(m_shared);
+	CloseHandle(m_mapping);
+	m_mapping = nullptr;
+#else
+	munmap(m_shared, m_sharedSize);
+	// Readers that have it mapped keep it until they let go.
+	shm_unlink(m_sharedName.c_str());
+#endif
+	m_shared = nullptr;
+}
@@ -0,0 +1,63 @@
+#include "Framebuffer.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+Framebuffer::Framebuffer(int width, int height) : m_width(width), m_height(height) {
+	glGenFramebuffers(1, &m_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+	glGenRenderbuffers(1, &m_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+
+	glGenRenderbuffers(1, &m_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		glDeleteFramebuffers(1, &m_fbo);
+		glDeleteRenderbuffers(1, &m_color);
+		glDeleteRenderbuffers(1, &m_depth);
+		throw std::runtime_error("Offscreen framebuffer is incomplete (status " + std::to_string(status) + ")");
+	}
+}
+
+Framebuffer::~Framebuffer() {
+	glDeleteFramebuffers(1, &m_fbo);
+	glDeleteRenderbuffers(1, &m_color);
+	glDeleteRenderbuffers(1, &m_depth);
+}
+
+void Framebuffer::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	glViewport(0, 0, m_width, m_height);
+}
+
+void Framebuffer::bindDefault(int width, int height) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+}
+
+StbImage Framebuffer::readPixels() const {
+	size_t rowSize = static_cast<size_t>(m_width) * 3;
+	auto bottomUp = std::make_unique<unsigned char[]>(rowSize * m_height);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, bottomUp.get());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	// OpenGL's first row is the bottom one.
+	auto pixels = std::make_unique<unsigned char[]>(rowSize * m_height);
+	for (int y = 0; y < m_height; y++) {
+		std::memcpy(&pixels[y * rowSize], &bottomUp[(m_height - 1 - y) * rowSize], rowSize);
+	}
+	StbImage image;
+	image.setPixels(m_width, m_height, 3, std::move(pixels));
+	return image;
+}
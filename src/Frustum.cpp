@@ -0,0 +1,36 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+	// A clip-space point is inside when -w <= x, y, z <= w; each inequality is one plane
+	// (Gribb and Hartmann). glm matrices are column-major, so row i is m[column][i].
+	glm::mat4 m = glm::transpose(viewProjection);
+	m_planes[0] = m[3] + m[0];
+	m_planes[1] = m[3] - m[0];
+	m_planes[2] = m[3] + m[1];
+	m_planes[3] = m[3] - m[1];
+	m_planes[4] = m[3] + m[2];
+	m_planes[5] = m[3] - m[2];
+	for (auto& plane : m_planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+bool Frustum::intersects(const glm::vec3& min, const glm::vec3& max) const {
+	for (auto& plane : m_planes) {
+		// The corner furthest along the plane's normal; if it is outside, the whole box is.
+		glm::vec3 corner(plane.x >= 0 ? max.x : min.x, plane.y >= 0 ? max.y : min.y, plane.z >= 0 ? max.z : min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersects(const glm::vec3& center, float radius) const {
+	for (auto& plane : m_planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,70 @@
+#include "ImageCompare.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <glm/ext.hpp>
+
+namespace {
+	/**
+	 * @brief An 8-bit sRGB color in CIELAB, for the D65 white point.
+	 */
+	glm::vec3 toLab(const unsigned char* pixel, int channels) {
+		glm::vec3 linear;
+		for (int c = 0; c < 3; c++) {
+			float value = pixel[channels < 3 ? 0 : c] / 255.0f;
+			linear[c] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+		glm::vec3 xyz(
+			(0.4124f * linear.r + 0.3576f * linear.g + 0.1805f * linear.b) / 0.95047f,
+			0.2126f * linear.r + 0.7152f * linear.g + 0.0722f * linear.b,
+			(0.0193f * linear.r + 0.1192f * linear.g + 0.9505f * linear.b) / 1.08883f);
+		for (int c = 0; c < 3; c++) {
+			xyz[c] = xyz[c] > 0.008856f ? std::cbrt(xyz[c]) : 7.787f * xyz[c] + 16.0f / 116.0f;
+		}
+		return glm::vec3(116.0f * xyz.y - 16.0f, 500.0f * (xyz.x - xyz.y), 200.0f * (xyz.y - xyz.z));
+	}
+
+	std::vector<glm::vec3> toLab(const StbImage& image) {
+		std::vector<glm::vec3> lab(static_cast<size_t>(image.getWidth()) * image.getHeight());
+		for (size_t i = 0; i < lab.size(); i++) {
+			lab[i] = toLab(image.getData() + i * image.getBpp(), image.getBpp());
+		}
+		return lab;
+	}
+}
+
+ImageDifference compareImages(const StbImage& expected, const StbImage& actual) {
+	if (expected.getWidth() != actual.getWidth() || expected.getHeight() != actual.getHeight()
+		|| expected.getBpp() != actual.getBpp()) {
+		throw std::runtime_error("Cannot compare a " + std::to_string(actual.getWidth()) + "x"
+			+ std::to_string(actual.getHeight()) + " image with a " + std::to_string(expected.getWidth()) + "x"
+			+ std::to_string(expected.getHeight()) + " one, or with different channels");
+	}
+	int width = expected.getWidth(), height = expected.getHeight();
+	std::vector<glm::vec3> want = toLab(expected), got = toLab(actual);
+
+	ImageDifference difference{ 0.0f, 0.0f, 0.0f };
+	double total = 0.0;
+	size_t differing = 0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t pixel = static_cast<size_t>(y) * width + x;
+			total += glm::length(got[pixel] - want[pixel]);
+			float nearest = std::numeric_limits<float>::infinity();
+			for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ny++) {
+				for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); nx++) {
+					nearest = std::min(nearest, glm::length(got[pixel] - want[static_cast<size_t>(ny) * width + nx]));
+				}
+			}
+			difference.worstDeltaE = std::max(difference.worstDeltaE, nearest);
+			differing += nearest > NOTICEABLE_DELTA_E ? 1 : 0;
+		}
+	}
+	size_t pixels = std::max<size_t>(1, want.size());
+	difference.meanDeltaE = static_cast<float>(total / pixels);
+	difference.differingShare = static_cast<float>(differing) / pixels;
+	return difference;
+}
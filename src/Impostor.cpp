@@ -0,0 +1,266 @@
+#include "Impostor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	constexpr Symbol COLORS_SAMPLER = "impostorColors";
+	constexpr Symbol NORMAL_DEPTHS_SAMPLER = "impostorNormalDepths";
+
+	/**
+	 * @brief The direction (toward the viewer) of the view at a point of the octahedral map,
+	 * which runs from -1 to 1 on both axes. Must match octahedralDirection in impostor.vert.
+	 */
+	glm::vec3 octahedralDirection(glm::vec2 point) {
+		glm::vec3 direction(point.x, 1.0f - std::abs(point.x) - std::abs(point.y), point.y);
+		if (direction.y < 0.0f) {
+			float x = direction.x, z = direction.z;
+			direction.x = (1.0f - std::abs(z)) * (x >= 0.0f ? 1.0f : -1.0f);
+			direction.z = (1.0f - std::abs(x)) * (z >= 0.0f ? 1.0f : -1.0f);
+		}
+		return glm::normalize(direction);
+	}
+
+	/**
+	 * @brief The up direction of a view; straight up or down, where that is the view itself,
+	 * +Z instead. Must match viewUp in impostor.vert.
+	 */
+	glm::vec3 viewUp(const glm::vec3& direction) {
+		return std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+}
+
+ImpostorAtlas::ImpostorAtlas(ShaderProgram captureProgram, ShaderProgram program, int viewsPerSide, int cellSize)
+	: m_captureProgram(captureProgram), m_program(program), m_viewsPerSide(viewsPerSide), m_cellSize(cellSize),
+	m_colors(0), m_normalDepths(0), m_drawn(0), m_view(1.0f), m_projection(1.0f), m_cameraPosition(0.0f),
+	m_frustum(glm::mat4(1.0f)), m_pixelsPerUnitAngle(1.0f) {
+	// One quad, shared by every instance. Its corners span the bounding sphere's diameter.
+	const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+	glGenBuffers(1, &m_corners);
+	glBindBuffer(GL_ARRAY_BUFFER, m_corners);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+	glEnableVertexAttribArray(0);
+
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	auto attribute = [](GLuint location, GLint size, size_t offset) {
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(Instance), reinterpret_cast<void*>(offset));
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	};
+	attribute(1, 4, offsetof(Instance, centerRadius));
+	attribute(2, 3, offsetof(Instance, axisX));
+	attribute(3, 3, offsetof(Instance, axisY));
+	attribute(4, 3, offsetof(Instance, axisZ));
+	attribute(5, 1, offsetof(Instance, layer));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ImpostorAtlas::~ImpostorAtlas() {
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteBuffers(1, &m_corners);
+	glDeleteBuffers(1, &m_instanceBuffer);
+	glDeleteTextures(1, &m_colors);
+	glDeleteTextures(1, &m_normalDepths);
+}
+
+void ImpostorAtlas::bake(const std::vector<Object3D*>& objects) {
+	auto start = std::chrono::steady_clock::now();
+	int size = m_viewsPerSide * m_cellSize;
+	int layers = std::max<int>(1, static_cast<int>(objects.size()));
+	// The smallest mip level still has four texels per view, so views barely bleed into
+	// their neighbors.
+	int levels = std::max(1, static_cast<int>(std::log2(m_cellSize)) - 1);
+
+	glDeleteTextures(1, &m_colors);
+	glDeleteTextures(1, &m_normalDepths);
+	auto allocate = [&](uint32_t& texture) {
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	};
+	// Color is stored as the texturing program outputs it, so impostors match the meshes.
+	allocate(m_colors);
+	allocate(m_normalDepths);
+
+	GLint previousProgram = 0, previousFramebuffer = 0;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	GLuint framebuffer, depth;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, buffers);
+	m_captureProgram.activate();
+	m_captureProgram.setUniform("model", glm::mat4(1.0f));
+
+	// Objects nested in others are left out of their ancestors' views, and the ancestors
+	// render them separately, so they can still move relative to each other.
+	for (size_t layer = 0; layer < objects.size(); layer++) {
+		objects[layer]->setImpostor(static_cast<int32_t>(layer));
+	}
+	m_bounds.assign(objects.size(), Bounds{ glm::vec3(0.0f), 0.0f });
+	GLenum status = GL_FRAMEBUFFER_COMPLETE;
+	for (size_t layer = 0; layer < objects.size(); layer++) {
+		Object3D& object = *objects[layer];
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colors, 0, static_cast<GLint>(layer));
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, m_normalDepths, 0, static_cast<GLint>(layer));
+		status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			break;
+		}
+		glViewport(0, 0, size, size);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// Views are taken in the object's own space, so the impostor turns and scales with it.
+		glm::mat4 worldToLocal = glm::inverse(object.getModelMatrix());
+		glm::vec3 min(INFINITY), max(-INFINITY);
+		std::vector<glm::vec3> points;
+		object.forEachImpostorMesh([&](Mesh3D& mesh, const glm::mat4& model) {
+			for (auto& vertex : mesh.geometry().vertices) {
+				glm::vec3 point(model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f));
+				min = glm::min(min, point);
+				max = glm::max(max, point);
+				points.push_back(point);
+			}
+		}, worldToLocal);
+		if (points.empty()) {
+			continue;
+		}
+		Bounds& bounds = m_bounds[layer];
+		bounds.center = (min + max) * 0.5f;
+		for (auto& point : points) {
+			bounds.radius = std::max(bounds.radius, glm::distance(point, bounds.center));
+		}
+		bounds.radius = std::max(bounds.radius, 1e-4f);
+
+		float r = bounds.radius;
+		m_captureProgram.setUniform("projection", glm::ortho(-r, r, -r, r, 0.0f, 2.0f * r));
+		for (int y = 0; y < m_viewsPerSide; y++) {
+			for (int x = 0; x < m_viewsPerSide; x++) {
+				glm::vec2 point = glm::vec2(x, y) / static_cast<float>(m_viewsPerSide - 1) * 2.0f - 1.0f;
+				glm::vec3 direction = octahedralDirection(point);
+				m_captureProgram.setUniform("view", glm::lookAt(bounds.center + direction * r, bounds.center, viewUp(direction)));
+				glViewport(x * m_cellSize, y * m_cellSize, m_cellSize, m_cellSize);
+				object.forEachImpostorMesh([&](Mesh3D& mesh, const glm::mat4& model) {
+					m_captureProgram.setUniform("model", model);
+					mesh.render(m_captureProgram);
+				}, worldToLocal);
+			}
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depth);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	glUseProgram(previousProgram);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		m_bounds.clear();
+		for (Object3D* object : objects) {
+			object->setImpostor(-1);
+		}
+		throw std::runtime_error("Impostor atlas framebuffer is incomplete (status " + std::to_string(status) + ")");
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_colors);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_normalDepths);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Baked " << objects.size() << " impostors of " << m_viewsPerSide * m_viewsPerSide << " views in "
+		<< ms << " ms (" << 2 * size * size * layers * 4 / (1024 * 1024) << " MiB before mipmaps)" << std::endl;
+}
+
+void ImpostorAtlas::beginFrame(const glm::mat4& view, const glm::mat4& projection) {
+	m_view = view;
+	m_projection = projection;
+	m_cameraPosition = glm::vec3(glm::inverse(view)[3]);
+	m_frustum = Frustum(projection * view);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	// projection[1][1] is the cotangent of half the vertical field of view.
+	m_pixelsPerUnitAngle = projection[1][1] * viewport[3] * 0.5f;
+	m_instances.clear();
+}
+
+bool ImpostorAtlas::queue(int32_t impostor, const glm::mat4& model) {
+	if (impostor < 0 || impostor >= static_cast<int32_t>(m_bounds.size()) || m_bounds[impostor].radius == 0.0f) {
+		return false;
+	}
+	const Bounds& bounds = m_bounds[impostor];
+	glm::vec3 axisX(model[0]), axisY(model[1]), axisZ(model[2]);
+	float scale = std::max({ glm::length(axisX), glm::length(axisY), glm::length(axisZ) });
+	glm::vec3 center(model * glm::vec4(bounds.center, 1.0f));
+	float radius = bounds.radius * scale;
+
+	// The meshes are needed once the object covers more pixels than one view has.
+	float distance = glm::distance(center, m_cameraPosition);
+	if (distance <= radius || radius / distance * m_pixelsPerUnitAngle > m_cellSize * 0.5f) {
+		return false;
+	}
+	if (m_frustum.intersects(center, radius)) {
+		m_instances.push_back(Instance{ glm::vec4(center, radius), axisX / glm::length(axisX), axisY / glm::length(axisY),
+			axisZ / glm::length(axisZ), static_cast<float>(impostor) });
+	}
+	return true;
+}
+
+void ImpostorAtlas::draw() {
+	m_drawn = m_instances.size();
+	if (m_instances.empty()) {
+		return;
+	}
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	m_program.activate();
+	m_program.setUniform("view", m_view);
+	m_program.setUniform("projection", m_projection);
+	m_program.setUniform("cameraPosition", m_cameraPosition);
+	m_program.setUniform("viewsPerSide", static_cast<float>(m_viewsPerSide));
+
+	int32_t unit = m_program.samplerUnit(COLORS_SAMPLER.id);
+	if (unit >= 0) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_colors);
+	}
+	unit = m_program.samplerUnit(NORMAL_DEPTHS_SAMPLER.id);
+	if (unit >= 0) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_normalDepths);
+	}
+
+	// Rewritten every frame; orphaning the old storage keeps the driver from waiting on it.
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_instances.size() * sizeof(Instance), m_instances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(m_vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(m_instances.size()));
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glUseProgram(previousProgram);
+}
@@ -0,0 +1,178 @@
+#include "Lighting.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+	const glm::ivec3 NEIGHBORS[6] = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+	};
+	constexpr int DOWN = 3;
+
+	/**
+	 * @brief Access to a single chunk in its local coordinates, for lighting it before its
+	 * neighbors exist.
+	 */
+	class ChunkLightAccess : public LightAccess {
+	private:
+		Chunk& m_chunk;
+
+	public:
+		explicit ChunkLightAccess(Chunk& chunk) : m_chunk(chunk) {}
+
+		bool loaded(const glm::ivec3& block) const override {
+			return block.x >= 0 && block.x < CHUNK_SIZE && block.z >= 0 && block.z < CHUNK_SIZE
+				&& block.y >= 0 && block.y < CHUNK_HEIGHT;
+		}
+		BlockId getBlock(const glm::ivec3& block) const override {
+			return m_chunk.getBlock(block.x, block.y, block.z);
+		}
+		uint8_t getLight(const glm::ivec3& block) const override {
+			return m_chunk.getLight(block.x, block.y, block.z);
+		}
+		void setLight(const glm::ivec3& block, uint8_t light) override {
+			m_chunk.setLight(block.x, block.y, block.z, light);
+		}
+	};
+}
+
+LightPropagator::LightPropagator(LightAccess& access) : m_access(access) {
+}
+
+uint8_t LightPropagator::level(const glm::ivec3& block, Channel channel) const {
+	uint8_t light = m_access.getLight(block);
+	return channel == SKY ? skyLight(light) : blockLight(light);
+}
+
+void LightPropagator::setLevel(const glm::ivec3& block, Channel channel, uint8_t level) {
+	uint8_t light = m_access.getLight(block);
+	light = channel == SKY ? packLight(level, blockLight(light)) : packLight(skyLight(light), level);
+	m_access.setLight(block, light);
+	m_changed.push_back(block);
+}
+
+void LightPropagator::addSource(const glm::ivec3& block) {
+	m_additions.push_back(Addition{ block, SKY });
+	m_additions.push_back(Addition{ block, BLOCK });
+}
+
+void LightPropagator::blockChanged(const glm::ivec3& block) {
+	BlockId current = m_access.getBlock(block);
+	for (Channel channel : { SKY, BLOCK }) {
+		// Whatever light was here goes, along with everything it lit...
+		uint8_t old = level(block, channel);
+		if (old > 0) {
+			setLevel(block, channel, 0);
+			m_removals.push_back(Removal{ block, channel, old });
+		}
+		// ...then the block's own light, and that of its neighbors, fill back in.
+		uint8_t emitted = channel == BLOCK ? lightEmission(current) : 0;
+		if (emitted > 0) {
+			setLevel(block, channel, emitted);
+			m_additions.push_back(Addition{ block, channel });
+		}
+		if (!isOpaque(current)) {
+			for (auto& offset : NEIGHBORS) {
+				glm::ivec3 neighbor = block + offset;
+				if (m_access.loaded(neighbor) && level(neighbor, channel) > 0) {
+					m_additions.push_back(Addition{ neighbor, channel });
+				}
+			}
+		}
+	}
+}
+
+void LightPropagator::propagate() {
+	// Removal: darken every neighbor whose light could have come from a removed block. A
+	// neighbor at least as bright has another source, and refills the darkened area.
+	while (!m_removals.empty()) {
+		Removal removal = m_removals.front();
+		m_removals.pop_front();
+		for (int direction = 0; direction < 6; direction++) {
+			glm::ivec3 neighbor = removal.block + NEIGHBORS[direction];
+			if (!m_access.loaded(neighbor)) {
+				continue;
+			}
+			uint8_t neighborLevel = level(neighbor, removal.channel);
+			if (neighborLevel == 0) {
+				continue;
+			}
+			bool skyColumn = removal.channel == SKY && direction == DOWN && removal.level == MAX_LIGHT;
+			if (neighborLevel < removal.level || (skyColumn && neighborLevel == MAX_LIGHT)) {
+				setLevel(neighbor, removal.channel, 0);
+				m_removals.push_back(Removal{ neighbor, removal.channel, neighborLevel });
+				uint8_t emitted = removal.channel == BLOCK ? lightEmission(m_access.getBlock(neighbor)) : 0;
+				if (emitted > 0) {
+					setLevel(neighbor, removal.channel, emitted);
+					m_additions.push_back(Addition{ neighbor, removal.channel });
+				}
+			}
+			else {
+				m_additions.push_back(Addition{ neighbor, removal.channel });
+			}
+		}
+	}
+
+	// Addition: spread outward while it brightens something.
+	while (!m_additions.empty()) {
+		Addition addition = m_additions.front();
+		m_additions.pop_front();
+		uint8_t current = level(addition.block, addition.channel);
+		if (current == 0) {
+			continue;
+		}
+		for (int direction = 0; direction < 6; direction++) {
+			glm::ivec3 neighbor = addition.block + NEIGHBORS[direction];
+			if (!m_access.loaded(neighbor) || isOpaque(m_access.getBlock(neighbor))) {
+				continue;
+			}
+			bool skyColumn = addition.channel == SKY && direction == DOWN && current == MAX_LIGHT;
+			uint8_t spread = skyColumn ? MAX_LIGHT : current - 1;
+			if (level(neighbor, addition.channel) < spread) {
+				setLevel(neighbor, addition.channel, spread);
+				m_additions.push_back(Addition{ neighbor, addition.channel });
+			}
+		}
+	}
+}
+
+void LightPropagator::lightChunk(Chunk& chunk) {
+	ChunkLightAccess access(chunk);
+	LightPropagator propagator(access);
+
+	// Sky light falls straight down each column until the first opaque block. Glowing
+	// blocks light themselves.
+	std::array<int, CHUNK_SIZE * CHUNK_SIZE> litFrom;
+	int highest = 0;
+	for (int z = 0; z < CHUNK_SIZE; z++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			// The lowest block that still sees the sky.
+			int& top = litFrom[z * CHUNK_SIZE + x];
+			top = 0;
+			bool open = true;
+			for (int y = CHUNK_HEIGHT - 1; y >= 0; y--) {
+				BlockId block = chunk.getBlock(x, y, z);
+				if (open && isOpaque(block)) {
+					open = false;
+					top = y + 1;
+				}
+				uint8_t emitted = lightEmission(block);
+				chunk.setLight(x, y, z, packLight(open ? MAX_LIGHT : 0, emitted));
+				if (emitted > 0) {
+					propagator.m_additions.push_back(Addition{ glm::ivec3(x, y, z), BLOCK });
+				}
+			}
+			highest = std::max(highest, top);
+		}
+	}
+
+	// Then sideways, under overhangs and into caves. Only lit blocks below the highest
+	// column top can have a darker neighbor.
+	for (int z = 0; z < CHUNK_SIZE; z++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			for (int y = litFrom[z * CHUNK_SIZE + x]; y < highest; y++) {
+				propagator.m_additions.push_back(Addition{ glm::ivec3(x, y, z), SKY });
+			}
+		}
+	}
+	propagator.propagate();
+}
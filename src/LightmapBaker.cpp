@@ -0,0 +1,453 @@
+#include "LightmapBaker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "ThreadPool.h"
+
+namespace {
+	constexpr float NEVER = std::numeric_limits<float>::infinity();
+	constexpr float PI = 3.14159265f;
+	// Texels around every chart, so filtering and mipmaps never reach a neighboring chart.
+	constexpr int CHART_PADDING = 1;
+	// Each retry of a layout that does not fit in maxSize shrinks the texel density by this.
+	constexpr float DENSITY_STEP = 0.75f;
+	// Cache files start with "LMAP" and this version.
+	constexpr uint32_t CACHE_MAGIC = 0x50414d4c;
+	constexpr uint32_t CACHE_VERSION = 1;
+
+	/**
+	 * @brief A mesh of a static object, where the object placed it.
+	 */
+	struct StaticMesh {
+		Mesh3D* mesh;
+		glm::mat4 model;
+		glm::mat3 normalMatrix;
+		// World-space normal of every triangle, for the surfaces paths bounce off.
+		std::vector<glm::vec3> triangleNormals;
+	};
+
+	/**
+	 * @brief A triangle's place in its lightmap.
+	 */
+	struct Chart {
+		// The corners, in texels from the chart's first texel.
+		glm::vec2 corner[3];
+		glm::ivec2 size;
+		// The chart's first texel in the lightmap.
+		glm::ivec2 origin;
+	};
+
+	struct Lightmap {
+		int width = 0;
+		int height = 0;
+		std::vector<Chart> charts;
+		// RGB, divided by LIGHTMAP_RANGE.
+		std::vector<unsigned char> texels;
+	};
+
+	/**
+	 * @brief Lays out one chart per triangle: the triangle as it lies in its plane, at the
+	 * given density, with the gutter around it.
+	 */
+	std::vector<Chart> makeCharts(const StaticMesh& mesh, float texelsPerUnit, int maxSize) {
+		const MeshGeometry& geometry = mesh.mesh->geometry();
+		std::vector<Chart> charts(geometry.faces.size() / 3);
+		for (size_t triangle = 0; triangle < charts.size(); triangle++) {
+			glm::vec3 world[3];
+			for (int corner = 0; corner < 3; corner++) {
+				const Vertex3D& vertex = geometry.vertices[geometry.faces[triangle * 3 + corner]];
+				world[corner] = glm::vec3(mesh.model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f));
+			}
+			glm::vec3 edge = world[1] - world[0];
+			float length = glm::length(edge);
+			float height = length > 0.0f ? glm::length(glm::cross(edge, world[2] - world[0])) / length : 0.0f;
+			float across = length > 0.0f ? glm::dot(world[2] - world[0], edge / length) : 0.0f;
+
+			glm::vec2 flat[3] = { { 0.0f, 0.0f }, { length, 0.0f }, { across, height } };
+			float left = std::min(0.0f, across);
+			glm::vec2 extent(std::max(length, across) - left, height);
+			// A chart too large for any lightmap is scaled down on its own.
+			float scale = texelsPerUnit;
+			float largest = std::max(extent.x, extent.y) * scale;
+			if (largest > maxSize - 2 * CHART_PADDING) {
+				scale *= (maxSize - 2 * CHART_PADDING) / largest;
+			}
+
+			Chart& chart = charts[triangle];
+			chart.size = glm::ivec2(glm::max(glm::ceil(extent * scale), glm::vec2(1.0f))) + 2 * CHART_PADDING;
+			for (int corner = 0; corner < 3; corner++) {
+				chart.corner[corner] = (flat[corner] - glm::vec2(left, 0.0f)) * scale + static_cast<float>(CHART_PADDING);
+			}
+		}
+		return charts;
+	}
+
+	/**
+	 * @brief Packs charts into shelves, tallest first, in a lightmap as wide as the square
+	 * that holds their area.
+	 * @return false if they do not fit in maxSize.
+	 */
+	bool packCharts(std::vector<Chart>& charts, int maxSize, int& width, int& height) {
+		std::vector<size_t> order(charts.size());
+		double area = 0.0;
+		int widest = 1;
+		for (size_t i = 0; i < charts.size(); i++) {
+			order[i] = i;
+			area += static_cast<double>(charts[i].size.x) * charts[i].size.y;
+			widest = std::max(widest, charts[i].size.x);
+		}
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return charts[a].size.y > charts[b].size.y;
+		});
+		width = std::min(maxSize, std::max(widest, static_cast<int>(std::ceil(std::sqrt(area * 1.1)))));
+		int x = 0, y = 0, shelfHeight = 0;
+		for (size_t i : order) {
+			Chart& chart = charts[i];
+			if (x + chart.size.x > width) {
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+			chart.origin = glm::ivec2(x, y);
+			x += chart.size.x;
+			shelfHeight = std::max(shelfHeight, chart.size.y);
+		}
+		height = std::max(1, y + shelfHeight);
+		return height <= maxSize;
+	}
+
+	uint32_t nextRandom(uint32_t& state) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	float randomUnit(uint32_t& state) {
+		return (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+	}
+
+	/**
+	 * @brief A direction around a normal, more likely the closer it is to the normal, as
+	 * diffuse surfaces scatter light.
+	 */
+	glm::vec3 cosineDirection(const glm::vec3& normal, uint32_t& random) {
+		float angle = 2.0f * PI * randomUnit(random);
+		float radius = std::sqrt(randomUnit(random));
+		glm::vec3 helper = std::abs(normal.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		return glm::normalize(tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle))
+			+ normal * std::sqrt(std::max(0.0f, 1.0f - radius * radius)));
+	}
+
+	/**
+	 * @brief Traces the light arriving at the static meshes.
+	 */
+	class PathTracer {
+	public:
+		PathTracer(const std::vector<StaticMesh>& meshes, const SceneBvh& scene, const LightmapSettings& settings, float offset)
+			: m_meshes(meshes), m_scene(scene), m_settings(settings), m_offset(offset),
+			m_toSun(-glm::normalize(settings.sunDirection)) {
+		}
+
+		/**
+		 * @brief The light a diffuse surface at a point receives, divided by pi so that
+		 * multiplying by the surface's color gives the light it reflects.
+		 */
+		glm::vec3 gather(const glm::vec3& point, const glm::vec3& normal, uint32_t& random) const {
+			glm::vec3 indirect(0.0f);
+			for (int sample = 0; sample < m_settings.samples; sample++) {
+				indirect += radiance(point + normal * m_offset, cosineDirection(normal, random), m_settings.bounces, random);
+			}
+			return sunlight(point, normal) + indirect / static_cast<float>(std::max(1, m_settings.samples));
+		}
+
+	private:
+		const std::vector<StaticMesh>& m_meshes;
+		const SceneBvh& m_scene;
+		const LightmapSettings& m_settings;
+		// How far rays start off the surfaces, so they do not hit the surface they leave.
+		float m_offset;
+		glm::vec3 m_toSun;
+
+		glm::vec3 sunlight(const glm::vec3& point, const glm::vec3& normal) const {
+			float facing = glm::dot(normal, m_toSun);
+			if (facing <= 0.0f || m_scene.intersect(point + normal * m_offset, m_toSun, NEVER)) {
+				return glm::vec3(0.0f);
+			}
+			return m_settings.sunColor * (facing / PI);
+		}
+
+		// The light arriving along a ray, after up to the given number of bounces.
+		glm::vec3 radiance(const glm::vec3& origin, const glm::vec3& direction, int bounces, uint32_t& random) const {
+			auto hit = m_scene.intersect(origin, direction, NEVER);
+			if (!hit) {
+				return m_settings.skyColor;
+			}
+			if (bounces == 0) {
+				return glm::vec3(0.0f);
+			}
+			glm::vec3 point = origin + direction * hit->hit.distance;
+			glm::vec3 normal = m_meshes[hit->id].triangleNormals[hit->hit.triangle];
+			if (glm::dot(normal, direction) > 0.0f) {
+				normal = -normal;
+			}
+			glm::vec3 bounced = radiance(point + normal * m_offset, cosineDirection(normal, random), bounces - 1, random);
+			return m_settings.albedo * (sunlight(point, normal) + bounced);
+		}
+	};
+
+	/**
+	 * @brief Bakes every texel of the given charts. Each texel takes its light from the
+	 * nearest point of its chart's triangle, so the gutters continue the edges.
+	 */
+	void bakeCharts(const PathTracer& tracer, const StaticMesh& mesh, Lightmap& lightmap, size_t first, size_t last) {
+		const MeshGeometry& geometry = mesh.mesh->geometry();
+		for (size_t triangle = first; triangle < last; triangle++) {
+			const Chart& chart = lightmap.charts[triangle];
+			glm::vec3 position[3], normal[3];
+			for (int corner = 0; corner < 3; corner++) {
+				const Vertex3D& vertex = geometry.vertices[geometry.faces[triangle * 3 + corner]];
+				position[corner] = glm::vec3(mesh.model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f));
+				normal[corner] = mesh.normalMatrix * glm::vec3(vertex.nx, vertex.ny, vertex.nz);
+			}
+			glm::vec3 faceNormal = mesh.triangleNormals[triangle];
+
+			glm::vec2 edge1 = chart.corner[1] - chart.corner[0], edge2 = chart.corner[2] - chart.corner[0];
+			float area = edge1.x * edge2.y - edge1.y * edge2.x;
+			for (int y = 0; y < chart.size.y; y++) {
+				for (int x = 0; x < chart.size.x; x++) {
+					glm::vec3 weights(1.0f / 3.0f);
+					if (area != 0.0f) {
+						glm::vec2 texel = glm::vec2(x + 0.5f, y + 0.5f) - chart.corner[0];
+						float u = (texel.x * edge2.y - texel.y * edge2.x) / area;
+						float v = (edge1.x * texel.y - edge1.y * texel.x) / area;
+						weights = glm::max(glm::vec3(1.0f - u - v, u, v), glm::vec3(0.0f));
+						weights /= weights.x + weights.y + weights.z;
+					}
+					glm::vec3 point = position[0] * weights.x + position[1] * weights.y + position[2] * weights.z;
+					glm::vec3 shading = normal[0] * weights.x + normal[1] * weights.y + normal[2] * weights.z;
+					shading = glm::length(shading) > 0.0f ? glm::normalize(shading) : faceNormal;
+
+					glm::ivec2 at = chart.origin + glm::ivec2(x, y);
+					uint32_t random = static_cast<uint32_t>(at.y * lightmap.width + at.x) * 2654435761u + 1u;
+					glm::vec3 light = tracer.gather(point, shading, random) / LIGHTMAP_RANGE;
+					unsigned char* texel = &lightmap.texels[(static_cast<size_t>(at.y) * lightmap.width + at.x) * 3];
+					for (int channel = 0; channel < 3; channel++) {
+						texel[channel] = static_cast<unsigned char>(std::clamp(light[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief FNV-1a, over everything that changes the baked light.
+	 */
+	struct CacheKey {
+		uint64_t hash = 14695981039346656037ull;
+
+		void add(const void* data, size_t size) {
+			auto bytes = static_cast<const unsigned char*>(data);
+			for (size_t i = 0; i < size; i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		}
+
+		template <typename T>
+		void add(const T& value) {
+			add(&value, sizeof(T));
+		}
+	};
+
+	uint64_t cacheKey(const std::vector<StaticMesh>& meshes, const LightmapSettings& settings) {
+		CacheKey key;
+		key.add(CACHE_VERSION);
+		key.add(settings.texelsPerUnit);
+		key.add(settings.maxSize);
+		key.add(settings.samples);
+		key.add(settings.bounces);
+		key.add(settings.albedo);
+		key.add(settings.sunDirection);
+		key.add(settings.sunColor);
+		key.add(settings.skyColor);
+		for (auto& mesh : meshes) {
+			const MeshGeometry& geometry = mesh.mesh->geometry();
+			key.add(mesh.model);
+			for (auto& vertex : geometry.vertices) {
+				key.add(vertex.x);
+				key.add(vertex.y);
+				key.add(vertex.z);
+				key.add(vertex.nx);
+				key.add(vertex.ny);
+				key.add(vertex.nz);
+			}
+			key.add(geometry.faces.data(), geometry.faces.size() * sizeof(uint32_t));
+		}
+		return key.hash;
+	}
+
+	/**
+	 * @brief Reads the texels of every lightmap, whose layouts are already known.
+	 */
+	void readCache(const std::filesystem::path& path, std::vector<Lightmap>& lightmaps) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("Could not open lightmap cache " + path.string());
+		}
+		uint32_t header[3];
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!file || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION || header[2] != lightmaps.size()) {
+			throw std::runtime_error("Lightmap cache " + path.string() + " is corrupt");
+		}
+		for (auto& lightmap : lightmaps) {
+			int32_t size[2];
+			file.read(reinterpret_cast<char*>(size), sizeof(size));
+			if (!file || size[0] != lightmap.width || size[1] != lightmap.height) {
+				throw std::runtime_error("Lightmap cache " + path.string() + " is corrupt");
+			}
+			file.read(reinterpret_cast<char*>(lightmap.texels.data()), lightmap.texels.size());
+			if (!file) {
+				throw std::runtime_error("Lightmap cache " + path.string() + " is truncated");
+			}
+		}
+	}
+
+	void writeCache(const std::filesystem::path& path, const std::vector<Lightmap>& lightmaps) {
+		std::filesystem::create_directories(path.parent_path());
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		uint32_t header[3] = { CACHE_MAGIC, CACHE_VERSION, static_cast<uint32_t>(lightmaps.size()) };
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		for (auto& lightmap : lightmaps) {
+			int32_t size[2] = { lightmap.width, lightmap.height };
+			file.write(reinterpret_cast<const char*>(size), sizeof(size));
+			file.write(reinterpret_cast<const char*>(lightmap.texels.data()), lightmap.texels.size());
+		}
+		if (!file) {
+			throw std::runtime_error("Could not write lightmap cache " + path.string());
+		}
+	}
+}
+
+void bakeLightmaps(const std::vector<Object3D*>& objects, const LightmapSettings& settings,
+	const std::filesystem::path& cacheDirectory) {
+	std::vector<StaticMesh> meshes;
+	for (auto object : objects) {
+		object->forEachMesh([&](Mesh3D& mesh, const glm::mat4& model) {
+			meshes.push_back(StaticMesh{ &mesh, model, glm::mat3(glm::transpose(glm::inverse(model))), {} });
+		}, glm::mat4(1));
+	}
+
+	// The scene the paths travel through, and how far off the surfaces they start.
+	std::vector<BvhInstance> instances;
+	glm::vec3 low(NEVER), high(-NEVER);
+	for (size_t i = 0; i < meshes.size(); i++) {
+		StaticMesh& mesh = meshes[i];
+		const MeshGeometry& geometry = mesh.mesh->geometry();
+		instances.push_back(BvhInstance{ &geometry.bvh, mesh.model, static_cast<uint32_t>(i) });
+		for (size_t corner = 0; corner + 2 < geometry.faces.size(); corner += 3) {
+			glm::vec3 world[3];
+			for (int j = 0; j < 3; j++) {
+				const Vertex3D& vertex = geometry.vertices[geometry.faces[corner + j]];
+				world[j] = glm::vec3(mesh.model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f));
+				low = glm::min(low, world[j]);
+				high = glm::max(high, world[j]);
+			}
+			glm::vec3 normal = glm::cross(world[1] - world[0], world[2] - world[0]);
+			mesh.triangleNormals.push_back(glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+	}
+	if (meshes.empty()) {
+		return;
+	}
+	SceneBvh scene(instances);
+	float offset = std::max(1e-4f, glm::length(high - low) * 1e-4f);
+
+	std::vector<Lightmap> lightmaps(meshes.size());
+	size_t texelCount = 0;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		Lightmap& lightmap = lightmaps[i];
+		float density = settings.texelsPerUnit;
+		do {
+			lightmap.charts = makeCharts(meshes[i], density, settings.maxSize);
+			density *= DENSITY_STEP;
+		} while (!packCharts(lightmap.charts, settings.maxSize, lightmap.width, lightmap.height));
+		lightmap.texels.assign(static_cast<size_t>(lightmap.width) * lightmap.height * 3, 0);
+		texelCount += static_cast<size_t>(lightmap.width) * lightmap.height;
+	}
+
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << cacheKey(meshes, settings) << ".lightmaps";
+	std::filesystem::path cachePath = cacheDirectory / name.str();
+	bool cached = false;
+	if (std::filesystem::exists(cachePath)) {
+		try {
+			readCache(cachePath, lightmaps);
+			cached = true;
+			std::cout << "Loaded " << lightmaps.size() << " baked lightmaps from " << cachePath.string() << std::endl;
+		}
+		catch (const std::runtime_error& error) {
+			std::cout << "Could not load baked lightmaps, baking them again: " << error.what() << std::endl;
+		}
+	}
+
+	if (!cached) {
+		auto start = std::chrono::steady_clock::now();
+		PathTracer tracer(meshes, scene, settings, offset);
+		ThreadPool& pool = ThreadPool::shared();
+		// Enough jobs per mesh to keep every core busy, in runs of whole charts.
+		size_t jobsPerMesh = pool.threadCount() * 4;
+		std::vector<std::future<void>> jobs;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			size_t charts = lightmaps[i].charts.size();
+			size_t run = std::max<size_t>(1, (charts + jobsPerMesh - 1) / jobsPerMesh);
+			for (size_t first = 0; first < charts; first += run) {
+				size_t last = std::min(charts, first + run);
+				jobs.push_back(pool.submit([&tracer, &mesh = meshes[i], &lightmap = lightmaps[i], first, last]() {
+					bakeCharts(tracer, mesh, lightmap, first, last);
+				}));
+			}
+		}
+		for (auto& job : jobs) {
+			job.get();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Baked " << lightmaps.size() << " lightmaps (" << texelCount << " texels, "
+			<< settings.samples << " paths each) in " << seconds << " s on " << pool.threadCount()
+			<< " threads" << std::endl;
+		try {
+			writeCache(cachePath, lightmaps);
+		}
+		catch (const std::runtime_error& error) {
+			std::cout << "Could not save baked lightmaps: " << error.what() << std::endl;
+		}
+	}
+
+	// Swap in the lightmapped meshes only now: the old ones own the geometry the scene traced.
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const Lightmap& lightmap = lightmaps[i];
+		std::vector<glm::vec2> coords;
+		coords.reserve(lightmap.charts.size() * 3);
+		glm::vec2 size(static_cast<float>(lightmap.width), static_cast<float>(lightmap.height));
+		for (auto& chart : lightmap.charts) {
+			for (int corner = 0; corner < 3; corner++) {
+				coords.push_back((glm::vec2(chart.origin) + chart.corner[corner]) / size);
+			}
+		}
+		auto pixels = std::make_unique<unsigned char[]>(lightmap.texels.size());
+		std::memcpy(pixels.get(), lightmap.texels.data(), lightmap.texels.size());
+		StbImage image;
+		image.setPixels(lightmap.width, lightmap.height, 3, std::move(pixels));
+		Texture texture = Texture::loadImage(image, "lightmap", TextureUsage::Data);
+		*meshes[i].mesh = meshes[i].mesh->withLightmap(coords, texture);
+	}
+}
@@ -0,0 +1,80 @@
+#include "LodTerrain.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+
+namespace {
+	constexpr int PADDED = CHUNK_SIZE + 2;
+	// How far skirts reach below the surface of the neighboring tile, in blocks.
+	constexpr int SKIRT_DEPTH = 8;
+}
+
+std::vector<ChunkMeshData> buildLodTile(const TerrainGenerator& terrain, LodKey key) {
+	int scale = key.scale();
+	std::array<int, PADDED * PADDED> heights;
+	terrain.downsampledHeights(key.firstChunk(), scale, heights.data());
+
+	// Lowering the border columns exposes the walls along the tile's edges, which become its
+	// skirts. Neighbors of the same level hide them inside their own ground.
+	int skirt = std::max(1, SKIRT_DEPTH / scale);
+	for (int z = 0; z < PADDED; z++) {
+		for (int x = 0; x < PADDED; x++) {
+			if (x == 0 || z == 0 || x == PADDED - 1 || z == PADDED - 1) {
+				heights[z * PADDED + x] = std::max(0, heights[z * PADDED + x] - skirt);
+			}
+		}
+	}
+	auto solid = [&](int x, int y, int z) {
+		return y < heights[(z + 1) * PADDED + (x + 1)];
+	};
+
+	// The tile as sections of cells, plus the ring of sections around it; the ring only
+	// holds the border columns, which is all the mesher reads from it.
+	int sectionCount = CHUNK_HEIGHT / scale / CHUNK_SIZE;
+	int highest = *std::max_element(heights.begin(), heights.end());
+	std::vector<std::array<std::shared_ptr<const ChunkSection>, 9>> sections(sectionCount);
+	std::array<BlockId, SECTION_VOLUME> cells;
+	for (int sy = 0; sy * CHUNK_SIZE < highest && sy < sectionCount; sy++) {
+		for (int sz = -1; sz <= 1; sz++) {
+			for (int sx = -1; sx <= 1; sx++) {
+				bool any = false;
+				for (int y = 0; y < CHUNK_SIZE; y++) {
+					for (int z = 0; z < CHUNK_SIZE; z++) {
+						for (int x = 0; x < CHUNK_SIZE; x++) {
+							int tileX = sx * CHUNK_SIZE + x, tileZ = sz * CHUNK_SIZE + z;
+							bool inside = tileX >= -1 && tileX <= CHUNK_SIZE && tileZ >= -1 && tileZ <= CHUNK_SIZE;
+							bool cell = inside && solid(tileX, sy * CHUNK_SIZE + y, tileZ);
+							cells[ChunkSection::index(x, y, z)] = cell ? Blocks::COBBLESTONE : Blocks::AIR;
+							any = any || cell;
+						}
+					}
+				}
+				if (any) {
+					sections[sy][(sz + 1) * 3 + (sx + 1)] = std::make_shared<ChunkSection>(cells.data());
+				}
+			}
+		}
+	}
+
+	std::vector<ChunkMeshData> meshes(sectionCount);
+	for (int sy = 0; sy < sectionCount; sy++) {
+		if (sections[sy][4] == nullptr) {
+			continue;
+		}
+		// No light sections: distant terrain is lit as open sky.
+		SectionNeighborhood neighbors;
+		neighbors.worldBottom = sy == 0;
+		for (int dy = -1; dy <= 1; dy++) {
+			if (sy + dy < 0 || sy + dy >= sectionCount) {
+				continue;
+			}
+			for (int dz = -1; dz <= 1; dz++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					neighbors.slot(dx, dy, dz) = sections[sy + dy][(dz + 1) * 3 + (dx + 1)];
+				}
+			}
+		}
+		meshes[sy] = meshSection(neighbors);
+	}
+	return meshes;
+}
@@ -1,6 +1,42 @@
 #include <iostream>
 #include "Mesh3D.h"
 #include <glad/glad.h>
+#include "LightmapBaker.h"
+
+namespace {
+	/**
+	 * @brief The camera meshlets are culled against, shared by every mesh, and the scratch
+	 * space for their draw ranges.
+	 */
+	struct CullingState {
+		bool active = false;
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		glm::vec3 cameraPosition = glm::vec3(0.0f);
+		MeshletStats stats;
+		std::vector<GLsizei> counts;
+		std::vector<const void*> offsets;
+	};
+	CullingState culling;
+
+	/**
+	 * @brief A 1x1 lightmap of plain, unscaled light, for meshes without one of their own, so
+	 * the shaders can sample the lightmap unconditionally. Created on first use.
+	 */
+	uint32_t neutralLightmap() {
+		static uint32_t texture = 0;
+		if (texture == 0) {
+			// Float texels hold 1 / LIGHTMAP_RANGE exactly, so the shaders scale it back to 1.
+			float light[3] = { 1.0f / LIGHTMAP_RANGE, 1.0f / LIGHTMAP_RANGE, 1.0f / LIGHTMAP_RANGE };
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 1, 1, 0, GL_RGB, GL_FLOAT, light);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		return texture;
+	}
+}
 
 
 Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
@@ -9,7 +45,11 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 }
 
 Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures)
-	: m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures) {
+	: m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures), m_lightmapCoords(0) {
+	// Keep the geometry for picking, baking and other queries, which the GPU copy can't answer.
+	// Dense meshes are split into meshlets here, which reorders their faces.
+	m_geometry = std::make_shared<const MeshGeometry>(std::move(vertices), std::move(faces));
+	auto& geometry = *m_geometry;
 
 	// Generate a vertex array object on the GPU.
 	glGenVertexArrays(1, &m_vao);
@@ -24,7 +64,7 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	// This vbo is now associated with m_vao.
 	// Copy the contents of the vertices list to the buffer that lives on the GPU.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex3D), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, geometry.vertices.size() * sizeof(Vertex3D), &geometry.vertices[0], GL_STATIC_DRAW);
 	// Inform OpenGL how to interpret the buffer: each vertex is 3 floats for position...
 	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex3D), 0);
 	glEnableVertexAttribArray(0);
@@ -42,23 +82,59 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 	uint32_t ebo;
 	glGenBuffers(1, &ebo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(uint32_t), &faces[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, geometry.faces.size() * sizeof(uint32_t), &geometry.faces[0], GL_STATIC_DRAW);
 
 	// Unbind the vertex array, so no one else can accidentally mess with it.
 	glBindVertexArray(0);
 }
 
+MeshGeometry::MeshGeometry(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces)
+	: MeshGeometry(std::move(vertices), std::move(faces), [&vertices] {
+		std::vector<glm::vec3> positions;
+		positions.reserve(vertices.size());
+		for (auto& vertex : vertices) {
+			positions.emplace_back(vertex.x, vertex.y, vertex.z);
+		}
+		return positions;
+	}()) {
+}
+
+MeshGeometry::MeshGeometry(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, const std::vector<glm::vec3>& positions)
+	: vertices(std::move(vertices)), faces(std::move(faces)), meshlets(positions, this->faces), bvh(positions, this->faces) {
+}
+
+Mesh3D Mesh3D::withLightmap(const std::vector<glm::vec2>& lightmapCoords, Texture lightmap) const {
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> faces;
+	vertices.reserve(m_geometry->faces.size());
+	faces.reserve(m_geometry->faces.size());
+	for (size_t i = 0; i < m_geometry->faces.size(); i++) {
+		vertices.push_back(m_geometry->vertices[m_geometry->faces[i]]);
+		faces.push_back(static_cast<uint32_t>(i));
+	}
+	std::vector<Texture> textures = m_textures;
+	textures.push_back(lightmap);
+	Mesh3D mesh(std::move(vertices), std::move(faces), std::move(textures));
+
+	// The vertices are unshared and the faces in order, so the coordinates line up with
+	// the vertices as they are. Attribute 3 reads them from their own buffer.
+	glBindVertexArray(mesh.m_vao);
+	glGenBuffers(1, &mesh.m_lightmapCoords);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.m_lightmapCoords);
+	glBufferData(GL_ARRAY_BUFFER, lightmapCoords.size() * sizeof(glm::vec2), lightmapCoords.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(3, 2, GL_FLOAT, false, sizeof(glm::vec2), 0);
+	glEnableVertexAttribArray(3);
+	glBindVertexArray(0);
+	return mesh;
+}
+
 void Mesh3D::addTexture(Texture texture) {
 	m_textures.push_back(texture);
 }
 
 void Mesh3D::render(ShaderProgram& program) const {
 	glBindVertexArray(m_vao);
-	for (auto i = 0; i < m_textures.size(); i++) {
-		program.setUniform(m_textures[i].samplerName, i);
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textures[i].textureId);
-	}
+	bindTextures(program);
 
 	// Draw the vertex array, using its "element buffer" to identify the faces.
 	glDrawElements(GL_TRIANGLES, m_faceCount, GL_UNSIGNED_INT, nullptr);
@@ -67,6 +143,75 @@ void Mesh3D::render(ShaderProgram& program) const {
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void Mesh3D::render(ShaderProgram& program, const glm::mat4& model) const {
+	const MeshletSet& meshlets = m_geometry->meshlets;
+	if (!culling.active || meshlets.empty()) {
+		render(program);
+		return;
+	}
+	glm::vec3 camera(glm::inverse(model) * glm::vec4(culling.cameraPosition, 1.0f));
+	culling.stats += meshlets.cull(culling.viewProjection * model, camera, culling.counts, culling.offsets);
+	if (culling.counts.empty()) {
+		return;
+	}
+
+	glBindVertexArray(m_vao);
+	bindTextures(program);
+	// Every range of surviving meshlets in one call.
+	glMultiDrawElements(GL_TRIANGLES, culling.counts.data(), GL_UNSIGNED_INT, culling.offsets.data(),
+		static_cast<GLsizei>(culling.counts.size()));
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Mesh3D::cullFor(const glm::mat4& view, const glm::mat4& projection) {
+	culling.active = true;
+	culling.viewProjection = projection * view;
+	culling.cameraPosition = glm::vec3(glm::inverse(view)[3]);
+	culling.stats = MeshletStats();
+}
+
+void Mesh3D::stopCulling() {
+	culling.active = false;
+}
+
+const MeshletStats& Mesh3D::cullingStats() {
+	return culling.stats;
+}
+
+void Mesh3D::bindTextures(ShaderProgram& program) const {
+	// Attribute 3 is disabled in the vertex arrays of meshes without a lightmap, so it reads the
+	// current value, which other draws may have changed. Their lightmap unit gets the neutral
+	// lightmap, rather than whatever the last mesh left there.
+	if (m_lightmapCoords == 0) {
+		glVertexAttrib2f(3, -1.0f, -1.0f);
+		static const SymbolId lightmapSampler = intern("lightmap");
+		int32_t unit = program.samplerUnit(lightmapSampler);
+		if (unit >= 0) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(GL_TEXTURE_2D, neutralLightmap());
+		}
+	}
+	// Only bind the textures the program actually samples; the rest would cost a bind each
+	// and, if their load was deferred, a decode nobody looks at. Sampler units were assigned
+	// when the program was linked, so no uniforms are set here.
+	// Deferred uploads bind their texture on the active unit, so finish them all before
+	// binding any, or one would unbind the texture the previous iteration left there.
+	for (auto& texture : m_textures) {
+		if (program.samplerUnit(texture.sampler) >= 0) {
+			texture.ensureLoaded();
+		}
+	}
+	for (auto& texture : m_textures) {
+		int32_t unit = program.samplerUnit(texture.sampler);
+		if (unit < 0) {
+			continue;
+		}
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, texture.textureId);
+	}
+}
+
 
 Mesh3D Mesh3D::square(const std::vector<Texture>& textures) {
 	return Mesh3D(
@@ -0,0 +1,305 @@
+#include "Meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include "Frustum.h"
+#include "Lanes.h"
+
+namespace {
+#if defined(__AVX2__)
+	using Lanes = Avx2Lanes;
+	static_assert(Lanes::WIDTH == MESHLET_BATCH);
+#else
+	using Lanes = ScalarLanes;
+#endif
+
+	/**
+	 * @brief Classifies a batch of meshlets: one bit per meshlet that lies outside the frustum,
+	 * and one per meshlet that faces away from the camera.
+	 */
+	template <typename L, typename Batch>
+	void classify(const Batch& batch, const Frustum& frustum, const glm::vec3& camera, int& outside, int& backfacing) {
+		outside = 0;
+		backfacing = 0;
+		for (int i = 0; i < MESHLET_BATCH; i += L::WIDTH) {
+			auto cx = L::load(&batch.center[0][i]), cy = L::load(&batch.center[1][i]), cz = L::load(&batch.center[2][i]);
+			auto radius = L::load(&batch.radius[i]);
+			auto negativeRadius = L::sub(L::splat(0.0f), radius);
+
+			auto out = L::none();
+			for (int p = 0; p < 6; p++) {
+				const glm::vec4& plane = frustum.plane(p);
+				auto distance = L::add(L::add(L::mul(cx, L::splat(plane.x)), L::mul(cy, L::splat(plane.y))),
+					L::add(L::mul(cz, L::splat(plane.z)), L::splat(plane.w)));
+				out = L::either(out, L::less(distance, negativeRadius));
+			}
+
+			// From the camera to the center, against the axis of the normal cone.
+			auto dx = L::sub(cx, L::splat(camera.x)), dy = L::sub(cy, L::splat(camera.y)), dz = L::sub(cz, L::splat(camera.z));
+			auto length = L::sqrt(L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz)));
+			auto along = L::add(L::add(L::mul(dx, L::load(&batch.axis[0][i])), L::mul(dy, L::load(&batch.axis[1][i]))),
+				L::mul(dz, L::load(&batch.axis[2][i])));
+			auto away = L::lessEqual(L::add(L::mul(L::load(&batch.cutoff[i]), length), radius), along);
+
+			outside |= L::bits(out) << i;
+			backfacing |= L::bits(away) << i;
+		}
+	}
+
+	/**
+	 * @brief Whether every edge of the mesh is shared by exactly one triangle on each side and
+	 * the triangles face outward, so from outside only front faces show. Vertices split at
+	 * texture seams are welded by position first.
+	 */
+	bool isClosed(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& faces) {
+		struct PositionHash {
+			size_t operator()(const glm::vec3& p) const {
+				// Adding zero turns -0 into 0, which compares equal to it.
+				float coordinates[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+				uint32_t bits[3];
+				std::memcpy(bits, coordinates, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+		struct PositionEqual {
+			bool operator()(const glm::vec3& a, const glm::vec3& b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+		};
+		std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> welded;
+		std::vector<uint32_t> weld(positions.size());
+		for (size_t i = 0; i < positions.size(); i++) {
+			weld[i] = welded.try_emplace(positions[i], static_cast<uint32_t>(welded.size())).first->second;
+		}
+
+		std::unordered_map<uint64_t, int> edges;
+		auto key = [](uint32_t from, uint32_t to) { return static_cast<uint64_t>(from) << 32 | to; };
+		double volume = 0.0;
+		for (size_t f = 0; f + 2 < faces.size(); f += 3) {
+			uint32_t a = weld[faces[f]], b = weld[faces[f + 1]], c = weld[faces[f + 2]];
+			if (a == b || b == c || c == a) {
+				continue;
+			}
+			edges[key(a, b)]++;
+			edges[key(b, c)]++;
+			edges[key(c, a)]++;
+			volume += glm::dot(positions[faces[f]], glm::cross(positions[faces[f + 1]], positions[faces[f + 2]]));
+		}
+		for (auto& [edge, count] : edges) {
+			auto reverse = edges.find(key(static_cast<uint32_t>(edge), static_cast<uint32_t>(edge >> 32)));
+			if (reverse == edges.end() || reverse->second != count) {
+				return false;
+			}
+		}
+		return !edges.empty() && volume > 0.0;
+	}
+}
+
+MeshletSet::MeshletSet(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& faces)
+	: m_closed(false), m_min(INFINITY), m_max(-INFINITY) {
+	size_t triangleCount = faces.size() / 3;
+	if (triangleCount < MESHLET_MIN_TRIANGLES) {
+		return;
+	}
+	for (uint32_t index : faces) {
+		m_min = glm::min(m_min, positions[index]);
+		m_max = glm::max(m_max, positions[index]);
+	}
+	m_closed = isClosed(positions, faces);
+
+	// The triangles around each vertex.
+	std::vector<uint32_t> adjacencyStart(positions.size() + 1, 0);
+	for (uint32_t index : faces) {
+		adjacencyStart[index + 1]++;
+	}
+	for (size_t v = 0; v < positions.size(); v++) {
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t f = 0; f < triangleCount * 3; f++) {
+		adjacency[fill[faces[f]]++] = static_cast<uint32_t>(f / 3);
+	}
+	auto centroid = [&](uint32_t t) {
+		return (positions[faces[t * 3]] + positions[faces[t * 3 + 1]] + positions[faces[t * 3 + 2]]) / 3.0f;
+	};
+
+	// Grow each meshlet from the first unused triangle, always adding the neighbor that needs
+	// the fewest new vertices, then the one nearest its center.
+	std::vector<bool> used(triangleCount, false);
+	// Which meshlet last took each vertex.
+	std::vector<uint32_t> owner(positions.size(), UINT32_MAX);
+	std::vector<uint32_t> ordered;
+	ordered.reserve(faces.size());
+	std::vector<uint32_t> triangles, candidates;
+	size_t seed = 0;
+	while (ordered.size() < triangleCount * 3) {
+		uint32_t meshlet = static_cast<uint32_t>(m_first.size());
+		int vertexCount = 0;
+		glm::vec3 centroidSum(0.0f);
+		triangles.clear();
+		candidates.clear();
+		auto add = [&](uint32_t t) {
+			used[t] = true;
+			triangles.push_back(t);
+			centroidSum += centroid(t);
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = faces[t * 3 + k];
+				if (owner[v] == meshlet) {
+					continue;
+				}
+				owner[v] = meshlet;
+				vertexCount++;
+				for (uint32_t a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++) {
+					if (!used[adjacency[a]]) {
+						candidates.push_back(adjacency[a]);
+					}
+				}
+			}
+		};
+
+		while (used[seed]) {
+			seed++;
+		}
+		add(static_cast<uint32_t>(seed));
+		while (triangles.size() < MESHLET_MAX_TRIANGLES) {
+			glm::vec3 center = centroidSum / static_cast<float>(triangles.size());
+			int64_t best = -1;
+			int bestNew = 4;
+			float bestDistance = INFINITY;
+			for (size_t i = 0; i < candidates.size();) {
+				uint32_t t = candidates[i];
+				if (used[t]) {
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				i++;
+				int added = (owner[faces[t * 3]] != meshlet) + (owner[faces[t * 3 + 1]] != meshlet) + (owner[faces[t * 3 + 2]] != meshlet);
+				if (vertexCount + added > MESHLET_MAX_VERTICES || added > bestNew) {
+					continue;
+				}
+				glm::vec3 offset = centroid(t) - center;
+				float distance = glm::dot(offset, offset);
+				if (added < bestNew || distance < bestDistance) {
+					best = t;
+					bestNew = added;
+					bestDistance = distance;
+				}
+			}
+			if (best < 0) {
+				break;
+			}
+			add(static_cast<uint32_t>(best));
+		}
+
+		m_first.push_back(static_cast<uint32_t>(ordered.size() / 3));
+		m_triangles.push_back(static_cast<uint32_t>(triangles.size()));
+		for (uint32_t t : triangles) {
+			ordered.insert(ordered.end(), faces.begin() + t * 3, faces.begin() + t * 3 + 3);
+		}
+	}
+	faces.swap(ordered);
+
+	// Bound each meshlet's vertices with a sphere, and its normals with a cone.
+	m_batches.resize((m_first.size() + MESHLET_BATCH - 1) / MESHLET_BATCH);
+	for (auto& batch : m_batches) {
+		std::fill(std::begin(batch.cutoff), std::end(batch.cutoff), 1.0f);
+		std::fill(std::begin(batch.radius), std::end(batch.radius), 0.0f);
+		for (int a = 0; a < 3; a++) {
+			std::fill(std::begin(batch.center[a]), std::end(batch.center[a]), 0.0f);
+			std::fill(std::begin(batch.axis[a]), std::end(batch.axis[a]), 0.0f);
+		}
+	}
+	for (size_t m = 0; m < m_first.size(); m++) {
+		const uint32_t* first = &faces[m_first[m] * 3];
+		size_t indexCount = m_triangles[m] * 3;
+		glm::vec3 min(INFINITY), max(-INFINITY);
+		for (size_t i = 0; i < indexCount; i++) {
+			min = glm::min(min, positions[first[i]]);
+			max = glm::max(max, positions[first[i]]);
+		}
+		glm::vec3 center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (size_t i = 0; i < indexCount; i++) {
+			radius = std::max(radius, glm::distance(positions[first[i]], center));
+		}
+
+		// Area-weighted, so slivers barely tilt the axis.
+		std::vector<glm::vec3> normals;
+		glm::vec3 axis(0.0f);
+		for (size_t i = 0; i < indexCount; i += 3) {
+			glm::vec3 a = positions[first[i]], b = positions[first[i + 1]], c = positions[first[i + 2]];
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+			if (area > 0.0f) {
+				axis += normal;
+				normals.push_back(normal / area);
+			}
+		}
+		float cutoff = 1.0f;
+		float axisLength = glm::length(axis);
+		if (axisLength > 0.0f) {
+			axis /= axisLength;
+			float minDot = 1.0f;
+			for (auto& normal : normals) {
+				minDot = std::min(minDot, glm::dot(normal, axis));
+			}
+			// Cones wider than about 84 degrees are too wide to ever face away as a whole.
+			if (minDot > 0.1f) {
+				cutoff = std::sqrt(1.0f - minDot * minDot);
+			}
+		}
+
+		Batch& batch = m_batches[m / MESHLET_BATCH];
+		int lane = static_cast<int>(m % MESHLET_BATCH);
+		for (int a = 0; a < 3; a++) {
+			batch.center[a][lane] = center[a];
+			batch.axis[a][lane] = axisLength > 0.0f ? axis[a] : 0.0f;
+		}
+		batch.radius[lane] = radius;
+		batch.cutoff[lane] = cutoff;
+	}
+}
+
+MeshletStats MeshletSet::cull(const glm::mat4& viewProjectionModel, const glm::vec3& camera,
+	std::vector<GLsizei>& counts, std::vector<const void*>& offsets) const {
+	counts.clear();
+	offsets.clear();
+	MeshletStats stats;
+	Frustum frustum(viewProjectionModel);
+	// From inside the mesh, its back faces are the ones that show.
+	bool inside = camera.x >= m_min.x && camera.y >= m_min.y && camera.z >= m_min.z
+		&& camera.x <= m_max.x && camera.y <= m_max.y && camera.z <= m_max.z;
+	bool cullBackfaces = m_closed && !inside;
+
+	uint32_t runEnd = UINT32_MAX;
+	for (size_t b = 0; b < m_batches.size(); b++) {
+		int outside, backfacing;
+		classify<Lanes>(m_batches[b], frustum, camera, outside, backfacing);
+		size_t end = std::min(m_first.size(), (b + 1) * MESHLET_BATCH);
+		for (size_t m = b * MESHLET_BATCH; m < end; m++) {
+			int bit = 1 << (m % MESHLET_BATCH);
+			stats.triangles += m_triangles[m];
+			if (outside & bit) {
+				stats.outsideTriangles += m_triangles[m];
+				continue;
+			}
+			if (cullBackfaces && (backfacing & bit)) {
+				stats.backfacingTriangles += m_triangles[m];
+				continue;
+			}
+			// Meshlets that follow each other in the index buffer share one range.
+			if (m_first[m] == runEnd) {
+				counts.back() += m_triangles[m] * 3;
+			}
+			else {
+				counts.push_back(m_triangles[m] * 3);
+				offsets.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(m_first[m]) * 3 * sizeof(uint32_t)));
+			}
+			runEnd = m_first[m] + m_triangles[m];
+		}
+	}
+	return stats;
+}
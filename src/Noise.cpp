@@ -0,0 +1,166 @@
+#include "Noise.h"
+#include <cmath>
+#include "Lanes.h"
+
+namespace {
+	constexpr uint32_t PRIME_X = 0x27d4eb2du;
+	constexpr uint32_t PRIME_Y = 0x165667b1u;
+	constexpr uint32_t PRIME_Z = 0x9e3779b1u;
+	// Added to the seed for every octave, so octaves are not copies of each other.
+	constexpr uint32_t OCTAVE_SEED_STEP = 0x85ebca6bu;
+
+	// Callers pass arrays with no particular alignment, so the batches use unaligned loads.
+#if defined(__AVX2__)
+	using Lanes = Avx2Lanes;
+	static_assert(Lanes::WIDTH == NOISE_BATCH);
+#else
+	using Lanes = ScalarLanes;
+#endif
+
+	// Both lane types run the exact same sequence of IEEE operations (there is no FMA
+	// contraction), so they produce bit-identical results.
+
+	template <typename L>
+	typename L::UInt hash(typename L::UInt h) {
+		h = L::xorUInt(h, L::shiftRight(h, 15));
+		h = L::mulUInt(h, L::splatUInt(0x2c1b3c6du));
+		h = L::xorUInt(h, L::shiftRight(h, 12));
+		h = L::mulUInt(h, L::splatUInt(0x297a2d39u));
+		return L::xorUInt(h, L::shiftRight(h, 15));
+	}
+
+	// Quintic smoothstep, 6t^5 - 15t^4 + 10t^3.
+	template <typename L>
+	typename L::Float fade(typename L::Float t) {
+		auto inner = L::add(L::mul(t, L::sub(L::mul(t, L::splat(6.0f)), L::splat(15.0f))), L::splat(10.0f));
+		return L::mul(L::mul(L::mul(t, t), t), inner);
+	}
+
+	template <typename L>
+	typename L::Float lerp(typename L::Float a, typename L::Float b, typename L::Float t) {
+		return L::add(a, L::mul(t, L::sub(b, a)));
+	}
+
+	// Gradients are the diagonals (+-1, +-1) and (+-1, +-1, +-1), picked by the low hash
+	// bits, so the dot product is just a sum with flipped signs.
+	template <typename L>
+	typename L::Float grad2(typename L::UInt h, typename L::Float x, typename L::Float z) {
+		return L::add(L::flipSign(x, h, 0), L::flipSign(z, h, 1));
+	}
+
+	template <typename L>
+	typename L::Float grad3(typename L::UInt h, typename L::Float x, typename L::Float y, typename L::Float z) {
+		return L::add(L::add(L::flipSign(x, h, 0), L::flipSign(y, h, 1)), L::flipSign(z, h, 2));
+	}
+
+	template <typename L>
+	typename L::Float noise2(typename L::Float x, typename L::Float z, uint32_t seed) {
+		auto fx = L::floor(x), fz = L::floor(z);
+		auto tx = L::sub(x, fx), tz = L::sub(z, fz);
+		auto one = L::splat(1.0f);
+
+		// Hash inputs of the four corners: seed ^ cx * PRIME_X ^ cz * PRIME_Z.
+		auto x0 = L::mulUInt(L::toUInt(fx), L::splatUInt(PRIME_X));
+		auto x1 = L::addUInt(x0, L::splatUInt(PRIME_X));
+		auto z0 = L::xorUInt(L::mulUInt(L::toUInt(fz), L::splatUInt(PRIME_Z)), L::splatUInt(seed));
+		auto z1 = L::xorUInt(L::addUInt(L::mulUInt(L::toUInt(fz), L::splatUInt(PRIME_Z)), L::splatUInt(PRIME_Z)),
+			L::splatUInt(seed));
+
+		auto n00 = grad2<L>(hash<L>(L::xorUInt(x0, z0)), tx, tz);
+		auto n10 = grad2<L>(hash<L>(L::xorUInt(x1, z0)), L::sub(tx, one), tz);
+		auto n01 = grad2<L>(hash<L>(L::xorUInt(x0, z1)), tx, L::sub(tz, one));
+		auto n11 = grad2<L>(hash<L>(L::xorUInt(x1, z1)), L::sub(tx, one), L::sub(tz, one));
+
+		auto u = fade<L>(tx), v = fade<L>(tz);
+		// Diagonal gradients peak at about +-1.0 in 2D already.
+		return lerp<L>(lerp<L>(n00, n10, u), lerp<L>(n01, n11, u), v);
+	}
+
+	template <typename L>
+	typename L::Float noise3(typename L::Float x, typename L::Float y, typename L::Float z, uint32_t seed) {
+		auto fx = L::floor(x), fy = L::floor(y), fz = L::floor(z);
+		auto tx = L::sub(x, fx), ty = L::sub(y, fy), tz = L::sub(z, fz);
+		auto one = L::splat(1.0f);
+		auto tx1 = L::sub(tx, one), ty1 = L::sub(ty, one), tz1 = L::sub(tz, one);
+
+		auto x0 = L::mulUInt(L::toUInt(fx), L::splatUInt(PRIME_X));
+		auto x1 = L::addUInt(x0, L::splatUInt(PRIME_X));
+		auto y0 = L::mulUInt(L::toUInt(fy), L::splatUInt(PRIME_Y));
+		auto y1 = L::addUInt(y0, L::splatUInt(PRIME_Y));
+		auto z0 = L::xorUInt(L::mulUInt(L::toUInt(fz), L::splatUInt(PRIME_Z)), L::splatUInt(seed));
+		auto z1 = L::xorUInt(L::addUInt(L::mulUInt(L::toUInt(fz), L::splatUInt(PRIME_Z)), L::splatUInt(PRIME_Z)),
+			L::splatUInt(seed));
+
+		auto y0z0 = L::xorUInt(y0, z0), y1z0 = L::xorUInt(y1, z0);
+		auto y0z1 = L::xorUInt(y0, z1), y1z1 = L::xorUInt(y1, z1);
+		auto n000 = grad3<L>(hash<L>(L::xorUInt(x0, y0z0)), tx, ty, tz);
+		auto n100 = grad3<L>(hash<L>(L::xorUInt(x1, y0z0)), tx1, ty, tz);
+		auto n010 = grad3<L>(hash<L>(L::xorUInt(x0, y1z0)), tx, ty1, tz);
+		auto n110 = grad3<L>(hash<L>(L::xorUInt(x1, y1z0)), tx1, ty1, tz);
+		auto n001 = grad3<L>(hash<L>(L::xorUInt(x0, y0z1)), tx, ty, tz1);
+		auto n101 = grad3<L>(hash<L>(L::xorUInt(x1, y0z1)), tx1, ty, tz1);
+		auto n011 = grad3<L>(hash<L>(L::xorUInt(x0, y1z1)), tx, ty1, tz1);
+		auto n111 = grad3<L>(hash<L>(L::xorUInt(x1, y1z1)), tx1, ty1, tz1);
+
+		auto u = fade<L>(tx), v = fade<L>(ty), w = fade<L>(tz);
+		auto nz0 = lerp<L>(lerp<L>(n000, n100, u), lerp<L>(n010, n110, u), v);
+		auto nz1 = lerp<L>(lerp<L>(n001, n101, u), lerp<L>(n011, n111, u), v);
+		// The (+-1, +-1, +-1) gradients reach about +-1.5; scale back to about +-1.
+		return L::mul(lerp<L>(nz0, nz1, w), L::splat(2.0f / 3.0f));
+	}
+
+	template <typename L>
+	void fractal2(const float* x, const float* z, float* out, int count, uint32_t seed, int octaves, float frequency) {
+		for (int i = 0; i < count; i += L::WIDTH) {
+			auto px = L::loadUnaligned(x + i), pz = L::loadUnaligned(z + i);
+			auto sum = L::splat(0.0f);
+			float amplitude = 1.0f, norm = 0.0f, scale = frequency;
+			for (int octave = 0; octave < octaves; octave++) {
+				auto n = noise2<L>(L::mul(px, L::splat(scale)), L::mul(pz, L::splat(scale)),
+					seed + octave * OCTAVE_SEED_STEP);
+				sum = L::add(sum, L::mul(L::splat(amplitude), n));
+				norm += amplitude;
+				amplitude *= 0.5f;
+				scale *= 2.0f;
+			}
+			L::storeUnaligned(out + i, L::div(sum, L::splat(norm)));
+		}
+	}
+
+	template <typename L>
+	void fractal3(const float* x, const float* y, const float* z, float* out, int count, uint32_t seed,
+		int octaves, float frequency) {
+		for (int i = 0; i < count; i += L::WIDTH) {
+			auto px = L::loadUnaligned(x + i), py = L::loadUnaligned(y + i), pz = L::loadUnaligned(z + i);
+			auto sum = L::splat(0.0f);
+			float amplitude = 1.0f, norm = 0.0f, scale = frequency;
+			for (int octave = 0; octave < octaves; octave++) {
+				auto s = L::splat(scale);
+				auto n = noise3<L>(L::mul(px, s), L::mul(py, s), L::mul(pz, s), seed + octave * OCTAVE_SEED_STEP);
+				sum = L::add(sum, L::mul(L::splat(amplitude), n));
+				norm += amplitude;
+				amplitude *= 0.5f;
+				scale *= 2.0f;
+			}
+			L::storeUnaligned(out + i, L::div(sum, L::splat(norm)));
+		}
+	}
+}
+
+void gradientNoise2D(const float* x, const float* z, float* out, int count, uint32_t seed) {
+	fractal2<Lanes>(x, z, out, count, seed, 1, 1.0f);
+}
+
+void gradientNoise3D(const float* x, const float* y, const float* z, float* out, int count, uint32_t seed) {
+	fractal3<Lanes>(x, y, z, out, count, seed, 1, 1.0f);
+}
+
+void fractalNoise2D(const float* x, const float* z, float* out, int count, uint32_t seed,
+	int octaves, float frequency) {
+	fractal2<Lanes>(x, z, out, count, seed, octaves, frequency);
+}
+
+void fractalNoise3D(const float* x, const float* y, const float* z, float* out, int count, uint32_t seed,
+	int octaves, float frequency) {
+	fractal3<Lanes>(x, y, z, out, count, seed, octaves, frequency);
+}
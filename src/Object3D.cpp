@@ -1,7 +1,11 @@
 #include "Object3D.h"
 #include "ShaderProgram.h"
+#include "Impostor.h"
 #include <glm/ext.hpp>
 
+// Set once per object per draw, so hashed once at compile time instead.
+constexpr Symbol MODEL_UNIFORM = "model";
+
 glm::mat4 Object3D::buildModelMatrix() const {
 	auto m = glm::translate(glm::mat4(1), m_position);
 	m = glm::translate(m, m_center * m_scale);
@@ -20,7 +24,7 @@ Object3D::Object3D(std::vector<Mesh3D>&& meshes)
 
 Object3D::Object3D(std::vector<Mesh3D>&& meshes, const glm::mat4& baseTransform)
 	: m_meshes(meshes), m_position(), m_orientation(), m_scale(1.0),
-	m_center(), m_baseTransform(baseTransform), m_material(0.1, 1.0, 0.3, 4)
+	m_center(), m_baseTransform(baseTransform), m_material(0.1, 1.0, 0.3, 4), m_impostor(-1)
 {
 }
 
@@ -51,6 +55,17 @@ const glm::vec4& Object3D::getMaterial() const {
 	return m_material;
 }
 
+int32_t Object3D::getImpostor() const {
+	return m_impostor;
+}
+
+/**
+ * @brief Gets the object's local->world matrix, without its parents'.
+ */
+glm::mat4 Object3D::getModelMatrix() const {
+	return buildModelMatrix();
+}
+
 size_t Object3D::numberOfChildren() const {
 	return m_children.size();
 }
@@ -92,6 +107,10 @@ void Object3D::setMaterial(const glm::vec4& material) {
 	m_material = material;
 }
 
+void Object3D::setImpostor(int32_t impostor) {
+	m_impostor = impostor;
+}
+
 void Object3D::move(const glm::vec3& offset) {
 	m_position = m_position + offset;
 }
@@ -108,25 +127,80 @@ void Object3D::addChild(Object3D&& child) {
 	m_children.emplace_back(child);
 }
 
-void Object3D::render(ShaderProgram& shaderProgram) const {
-	renderRecursive(shaderProgram, glm::mat4(1));
+void Object3D::render(ShaderProgram& shaderProgram, ImpostorAtlas* impostors) const {
+	renderRecursive(shaderProgram, glm::mat4(1), impostors);
 }
 
 /**
  * @brief Renders the object and its children, recursively.
  * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
  */
-void Object3D::renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const {
+void Object3D::renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix, ImpostorAtlas* impostors) const {
 	// This object's true model matrix is the combination of its parent's matrix and the object's matrix.
 	glm::mat4 trueModel = parentMatrix * buildModelMatrix();
-	shaderProgram.setUniform("model", trueModel);
+	// Far away, the impostor stands in for the object and its children, except those with
+	// impostors of their own, which move on their own.
+	if (impostors && m_impostor >= 0 && impostors->queue(m_impostor, trueModel)) {
+		renderDetached(shaderProgram, trueModel, impostors);
+		return;
+	}
+	shaderProgram.setUniform(MODEL_UNIFORM, trueModel);
 	// Render each mesh in the object.
 	for (auto& mesh : m_meshes) {
-		mesh.render(shaderProgram);
+		mesh.render(shaderProgram, trueModel);
 	}
 	// Render the children of the object.
 	for (auto& child : m_children) {
-		child.renderRecursive(shaderProgram, trueModel);
+		child.renderRecursive(shaderProgram, trueModel, impostors);
+	}
+}
+
+void Object3D::renderDetached(ShaderProgram& shaderProgram, const glm::mat4& model, ImpostorAtlas* impostors) const {
+	for (auto& child : m_children) {
+		if (child.m_impostor >= 0) {
+			child.renderRecursive(shaderProgram, model, impostors);
+		}
+		else {
+			child.renderDetached(shaderProgram, model * child.buildModelMatrix(), impostors);
+		}
+	}
+}
+
+/**
+ * @brief Places the meshes of the object and its children, recursively, the same way they
+ * are rendered.
+ * @param id tags every instance, e.g. with the index of the top-level object in its scene.
+ * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
+ */
+void Object3D::collectBvhInstances(std::vector<BvhInstance>& instances, uint32_t id, const glm::mat4& parentMatrix) const {
+	glm::mat4 trueModel = parentMatrix * buildModelMatrix();
+	for (auto& mesh : m_meshes) {
+		instances.push_back(BvhInstance{ &mesh.bvh(), trueModel, id });
+	}
+	for (auto& child : m_children) {
+		child.collectBvhInstances(instances, id, trueModel);
+	}
+}
+
+void Object3D::forEachMesh(const std::function<void(Mesh3D&, const glm::mat4&)>& visit, const glm::mat4& parentMatrix) {
+	glm::mat4 trueModel = parentMatrix * buildModelMatrix();
+	for (auto& mesh : m_meshes) {
+		visit(mesh, trueModel);
+	}
+	for (auto& child : m_children) {
+		child.forEachMesh(visit, trueModel);
+	}
+}
+
+void Object3D::forEachImpostorMesh(const std::function<void(Mesh3D&, const glm::mat4&)>& visit, const glm::mat4& parentMatrix) {
+	glm::mat4 trueModel = parentMatrix * buildModelMatrix();
+	for (auto& mesh : m_meshes) {
+		visit(mesh, trueModel);
+	}
+	for (auto& child : m_children) {
+		if (child.m_impostor < 0) {
+			child.forEachImpostorMesh(visit, trueModel);
+		}
 	}
 }
 
@@ -0,0 +1,303 @@
+#include "ReferenceRenderer.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include "ThreadPool.h"
+
+namespace {
+	constexpr float NEVER = std::numeric_limits<float>::infinity();
+	constexpr float PI = 3.14159265f;
+	constexpr int TILE_SIZE = 16;
+	// The color of surfaces without a base texture.
+	const glm::vec3 UNTEXTURED(0.8f);
+
+	/**
+	 * @brief A well-mixed starting state for the random numbers of one path.
+	 */
+	uint32_t pathSeed(uint32_t seed, uint32_t pixel, uint32_t sample) {
+		uint64_t z = (static_cast<uint64_t>(seed) << 32 | pixel) ^ (static_cast<uint64_t>(sample) * 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		z ^= z >> 31;
+		return static_cast<uint32_t>(z) | 1u;
+	}
+
+	float randomUnit(uint32_t& state) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	glm::vec3 cosineDirection(const glm::vec3& normal, uint32_t& random) {
+		float angle = 2.0f * PI * randomUnit(random);
+		float radius = std::sqrt(randomUnit(random));
+		glm::vec3 helper = std::abs(normal.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		return glm::normalize(tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle))
+			+ normal * std::sqrt(std::max(0.0f, 1.0f - radius * radius)));
+	}
+
+	const std::array<float, 256> SRGB_TO_LINEAR = [] {
+		std::array<float, 256> table{};
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return table;
+	}();
+
+	unsigned char linearToSrgb(float c) {
+		c = std::clamp(c, 0.0f, 1.0f);
+		c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+		return static_cast<unsigned char>(c * 255.0f + 0.5f);
+	}
+
+	float luminance(const glm::vec3& c) {
+		return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+	}
+}
+
+ReferenceRenderer::ReferenceRenderer(const std::vector<Object3D*>& objects, const RenderSettings& settings)
+	: m_settings(settings), m_scene(std::vector<BvhInstance>{}), m_offset(1e-4f) {
+	std::unordered_map<uint32_t, int> downloaded;
+	for (auto object : objects) {
+		object->forEachMesh([&](Mesh3D& mesh, const glm::mat4& model) {
+			int texture = -1;
+			for (auto& candidate : mesh.textures()) {
+				if (candidate.sampler != hashSymbol("baseTexture")) {
+					continue;
+				}
+				auto [known, inserted] = downloaded.try_emplace(candidate.textureId, static_cast<int>(m_textures.size()));
+				if (inserted) {
+					m_textures.push_back(candidate.download());
+				}
+				texture = known->second;
+				break;
+			}
+			m_surfaces.push_back(Surface{ &mesh.geometry(), model, glm::mat3(glm::transpose(glm::inverse(model))), texture });
+		}, glm::mat4(1));
+	}
+
+	std::vector<BvhInstance> instances;
+	glm::vec3 low(NEVER), high(-NEVER);
+	for (size_t i = 0; i < m_surfaces.size(); i++) {
+		const Surface& surface = m_surfaces[i];
+		instances.push_back(BvhInstance{ &surface.geometry->bvh, surface.model, static_cast<uint32_t>(i) });
+		for (auto& vertex : surface.geometry->vertices) {
+			glm::vec3 world(surface.model * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f));
+			low = glm::min(low, world);
+			high = glm::max(high, world);
+		}
+	}
+	m_scene = SceneBvh(instances);
+	if (low.x <= high.x) {
+		m_offset = std::max(1e-4f, glm::length(high - low) * 1e-4f);
+	}
+}
+
+glm::vec3 ReferenceRenderer::albedo(const Surface& surface, uint32_t triangle, float u, float v) const {
+	if (surface.texture < 0) {
+		return UNTEXTURED;
+	}
+	const MeshGeometry& geometry = *surface.geometry;
+	const Vertex3D& a = geometry.vertices[geometry.faces[triangle * 3]];
+	const Vertex3D& b = geometry.vertices[geometry.faces[triangle * 3 + 1]];
+	const Vertex3D& c = geometry.vertices[geometry.faces[triangle * 3 + 2]];
+	float w = 1.0f - u - v;
+	glm::vec2 uv(a.u * w + b.u * u + c.u * v, a.v * w + b.v * u + c.v * v);
+
+	// Bilinear, repeating, as the rasterizer samples the top mip level.
+	const StbImage& image = m_textures[surface.texture];
+	int width = image.getWidth(), height = image.getHeight();
+	if (width == 0 || height == 0) {
+		return UNTEXTURED;
+	}
+	glm::vec2 at = uv * glm::vec2(width, height) - 0.5f;
+	glm::vec2 cell = glm::floor(at);
+	glm::vec2 blend = at - cell;
+	glm::vec3 color(0.0f);
+	for (int dy = 0; dy < 2; dy++) {
+		for (int dx = 0; dx < 2; dx++) {
+			int x = ((static_cast<int>(cell.x) + dx) % width + width) % width;
+			int y = ((static_cast<int>(cell.y) + dy) % height + height) % height;
+			const unsigned char* texel = image.getData() + (static_cast<size_t>(y) * width + x) * 4;
+			float weight = (dx ? blend.x : 1.0f - blend.x) * (dy ? blend.y : 1.0f - blend.y);
+			color += weight * glm::vec3(SRGB_TO_LINEAR[texel[0]], SRGB_TO_LINEAR[texel[1]], SRGB_TO_LINEAR[texel[2]]);
+		}
+	}
+	return color;
+}
+
+glm::vec3 ReferenceRenderer::trace(glm::vec3 origin, glm::vec3 direction, uint32_t random) const {
+	glm::vec3 toSun = -glm::normalize(m_settings.sunDirection);
+	glm::vec3 color(0.0f), throughput(1.0f);
+	for (int bounce = 0; ; bounce++) {
+		auto hit = m_scene.intersect(origin, direction, NEVER);
+		if (!hit) {
+			color += throughput * m_settings.skyColor;
+			break;
+		}
+		const Surface& surface = m_surfaces[hit->id];
+		const MeshGeometry& geometry = *surface.geometry;
+		uint32_t triangle = hit->hit.triangle;
+		float u = hit->hit.u, v = hit->hit.v, w = 1.0f - u - v;
+		const Vertex3D* corners[3] = {
+			&geometry.vertices[geometry.faces[triangle * 3]],
+			&geometry.vertices[geometry.faces[triangle * 3 + 1]],
+			&geometry.vertices[geometry.faces[triangle * 3 + 2]]
+		};
+		glm::vec3 world[3];
+		for (int i = 0; i < 3; i++) {
+			world[i] = glm::vec3(surface.model * glm::vec4(corners[i]->x, corners[i]->y, corners[i]->z, 1.0f));
+		}
+		glm::vec3 faceNormal = glm::cross(world[1] - world[0], world[2] - world[0]);
+		faceNormal = glm::length(faceNormal) > 0.0f ? glm::normalize(faceNormal) : -direction;
+		if (glm::dot(faceNormal, direction) > 0.0f) {
+			faceNormal = -faceNormal;
+		}
+		glm::vec3 normal = surface.normalMatrix * (glm::vec3(corners[0]->nx, corners[0]->ny, corners[0]->nz) * w
+			+ glm::vec3(corners[1]->nx, corners[1]->ny, corners[1]->nz) * u
+			+ glm::vec3(corners[2]->nx, corners[2]->ny, corners[2]->nz) * v);
+		normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : faceNormal;
+		if (glm::dot(normal, faceNormal) < 0.0f) {
+			normal = -normal;
+		}
+
+		glm::vec3 point = origin + direction * hit->hit.distance + faceNormal * m_offset;
+		glm::vec3 reflectance = albedo(surface, triangle, u, v);
+		float facing = glm::dot(normal, toSun);
+		if (facing > 0.0f && glm::dot(faceNormal, toSun) > 0.0f && !m_scene.intersect(point, toSun, NEVER)) {
+			color += throughput * reflectance * m_settings.sunColor * (facing / PI);
+		}
+		if (bounce == m_settings.bounces) {
+			break;
+		}
+		throughput *= reflectance;
+		origin = point;
+		direction = cosineDirection(faceNormal, random);
+	}
+	return color;
+}
+
+StbImage ReferenceRenderer::render(const glm::vec3& position, const glm::vec3& forward, const glm::vec3& up) const {
+	int width = m_settings.width, height = m_settings.height;
+	glm::vec3 front = glm::normalize(forward);
+	glm::vec3 right = glm::normalize(glm::cross(front, up));
+	glm::vec3 above = glm::cross(right, front);
+	float halfHeight = std::tan(glm::radians(m_settings.verticalFov) * 0.5f);
+	float halfWidth = halfHeight * width / height;
+
+	struct Tile {
+		glm::ivec2 first;
+		glm::ivec2 last;
+		int samples = 0;
+		bool converged = false;
+	};
+	std::vector<Tile> tiles;
+	for (int y = 0; y < height; y += TILE_SIZE) {
+		for (int x = 0; x < width; x += TILE_SIZE) {
+			tiles.push_back(Tile{ { x, y }, { std::min(width, x + TILE_SIZE), std::min(height, y + TILE_SIZE) } });
+		}
+	}
+	// Per pixel: the sum of its samples, and of their brightness and its square.
+	std::vector<glm::vec3> sums(static_cast<size_t>(width) * height, glm::vec3(0.0f));
+	std::vector<float> brightness(sums.size(), 0.0f), brightnessSquared(sums.size(), 0.0f);
+
+	ThreadPool& pool = ThreadPool::shared();
+	auto start = std::chrono::steady_clock::now();
+	uint64_t paths = 0;
+	int passes = 0;
+	for (;;) {
+		std::vector<std::future<void>> jobs;
+		int pass = std::max(1, m_settings.samplesPerPass);
+		for (auto& tile : tiles) {
+			if (tile.converged) {
+				continue;
+			}
+			int first = tile.samples, last = std::min(m_settings.maxSamples, tile.samples + pass);
+			paths += static_cast<uint64_t>(last - first) * (tile.last.x - tile.first.x) * (tile.last.y - tile.first.y);
+			jobs.push_back(pool.submit([&, tile, first, last]() {
+				for (int y = tile.first.y; y < tile.last.y; y++) {
+					for (int x = tile.first.x; x < tile.last.x; x++) {
+						size_t pixel = static_cast<size_t>(y) * width + x;
+						for (int sample = first; sample < last; sample++) {
+							uint32_t random = pathSeed(m_settings.seed, static_cast<uint32_t>(pixel), sample);
+							float px = ((x + randomUnit(random)) / width) * 2.0f - 1.0f;
+							float py = 1.0f - ((y + randomUnit(random)) / height) * 2.0f;
+							glm::vec3 direction = glm::normalize(front + right * (px * halfWidth) + above * (py * halfHeight));
+							glm::vec3 color = trace(position, direction, random);
+							float level = luminance(color);
+							sums[pixel] += color;
+							brightness[pixel] += level;
+							brightnessSquared[pixel] += level * level;
+						}
+					}
+				}
+			}));
+			tile.samples = last;
+		}
+		if (jobs.empty()) {
+			break;
+		}
+		for (auto& job : jobs) {
+			job.get();
+		}
+		passes++;
+
+		for (auto& tile : tiles) {
+			if (tile.converged || tile.samples < m_settings.minSamples) {
+				continue;
+			}
+			float n = static_cast<float>(tile.samples);
+			double mean = 0.0, variance = 0.0;
+			int pixels = 0;
+			for (int y = tile.first.y; y < tile.last.y; y++) {
+				for (int x = tile.first.x; x < tile.last.x; x++) {
+					size_t pixel = static_cast<size_t>(y) * width + x;
+					float average = brightness[pixel] / n;
+					mean += average;
+					// The variance of the pixel's mean, from the spread of its samples.
+					variance += std::max(0.0f, brightnessSquared[pixel] / n - average * average) / n;
+					pixels++;
+				}
+			}
+			mean /= pixels;
+			double error = std::sqrt(variance / pixels);
+			tile.converged = error <= m_settings.noiseThreshold * std::max(mean, 1e-3)
+				|| tile.samples >= m_settings.maxSamples;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	auto pixels = std::make_unique<unsigned char[]>(sums.size() * 3);
+	int fewest = m_settings.maxSamples, most = 0;
+	size_t belowThreshold = 0;
+	for (auto& tile : tiles) {
+		fewest = std::min(fewest, tile.samples);
+		most = std::max(most, tile.samples);
+		belowThreshold += tile.samples < m_settings.maxSamples ? 1 : 0;
+		for (int y = tile.first.y; y < tile.last.y; y++) {
+			for (int x = tile.first.x; x < tile.last.x; x++) {
+				size_t pixel = static_cast<size_t>(y) * width + x;
+				glm::vec3 color = sums[pixel] / static_cast<float>(std::max(1, tile.samples));
+				for (int channel = 0; channel < 3; channel++) {
+					pixels[pixel * 3 + channel] = linearToSrgb(color[channel]);
+				}
+			}
+		}
+	}
+	std::cout << "Reference render " << width << "x" << height << ": " << paths << " paths in " << seconds
+		<< " s (" << paths / std::max(seconds, 1e-9) << " samples/s on " << pool.threadCount() << " threads), "
+		<< passes << " passes, " << fewest << "-" << most << " samples per pixel, " << belowThreshold << " of "
+		<< tiles.size() << " tiles converged below " << m_settings.noiseThreshold << " noise" << std::endl;
+	StbImage image;
+	image.setPixels(width, height, 3, std::move(pixels));
+	return image;
+}
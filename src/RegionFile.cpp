@@ -0,0 +1,257 @@
+#include "RegionFile.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <lz4.h>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	constexpr uint64_t SECTOR_BYTES = 4096;
+	constexpr uint32_t TABLE_BYTES = REGION_SIZE * REGION_SIZE * 2 * sizeof(uint32_t);
+	constexpr uint32_t TABLE_SECTORS = static_cast<uint32_t>((TABLE_BYTES + SECTOR_BYTES - 1) / SECTOR_BYTES);
+	// No valid chunk comes close to this; larger sizes mean the file is corrupt.
+	constexpr uint32_t MAX_CHUNK_BYTES = 16 * 1024 * 1024;
+
+	int entryIndex(int localX, int localZ) {
+		return localZ * REGION_SIZE + localX;
+	}
+}
+
+RegionFile::RegionFile(const std::filesystem::path& path) : m_path(path), m_table{}, m_view(nullptr), m_viewSize(0) {
+#ifdef _WIN32
+	m_mapping = nullptr;
+	m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Could not open region file " + path.string());
+	}
+#else
+	m_file = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (m_file < 0) {
+		throw std::runtime_error("Could not open region file " + path.string());
+	}
+#endif
+
+	uint64_t size = fileSize();
+	if (size < TABLE_BYTES) {
+		// A new (or truncated) file starts with an empty table.
+		writeAt(0, m_table.data(), TABLE_BYTES);
+		size = TABLE_BYTES;
+	}
+	remap();
+	std::memcpy(m_table.data(), m_view, TABLE_BYTES);
+
+	m_usedSectors.assign(static_cast<size_t>((size + SECTOR_BYTES - 1) / SECTOR_BYTES), false);
+	for (uint32_t sector = 0; sector < TABLE_SECTORS; sector++) {
+		m_usedSectors[sector] = true;
+	}
+	for (auto& entry : m_table) {
+		if (entry.length == 0) {
+			continue;
+		}
+		uint64_t end = entry.sector * SECTOR_BYTES + entry.length;
+		if (entry.sector < TABLE_SECTORS || end > size || entry.length > MAX_CHUNK_BYTES) {
+			std::cout << "Dropping corrupt chunk entry in " << path.string() << std::endl;
+			entry = Entry{ 0, 0 };
+			continue;
+		}
+		for (uint64_t sector = entry.sector; sector * SECTOR_BYTES < end; sector++) {
+			m_usedSectors[sector] = true;
+		}
+	}
+}
+
+RegionFile::~RegionFile() {
+	unmap();
+#ifdef _WIN32
+	CloseHandle(m_file);
+#else
+	close(m_file);
+#endif
+}
+
+std::vector<uint8_t> RegionFile::read(int localX, int localZ) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Entry entry = m_table[entryIndex(localX, localZ)];
+	if (entry.length == 0) {
+		return {};
+	}
+	uint64_t begin = entry.sector * SECTOR_BYTES;
+	if (begin + entry.length > m_viewSize) {
+		remap();
+	}
+	uint32_t rawSize;
+	if (begin + entry.length > m_viewSize || entry.length < sizeof(rawSize)) {
+		throw std::runtime_error("Chunk data lies outside region file " + m_path.string());
+	}
+
+	const uint8_t* blob = m_view + begin;
+	std::memcpy(&rawSize, blob, sizeof(rawSize));
+	if (rawSize > MAX_CHUNK_BYTES) {
+		throw std::runtime_error("Chunk in region file " + m_path.string() + " is corrupt");
+	}
+	std::vector<uint8_t> data(rawSize);
+	int decompressed = LZ4_decompress_safe(reinterpret_cast<const char*>(blob + sizeof(rawSize)),
+		reinterpret_cast<char*>(data.data()), static_cast<int>(entry.length - sizeof(rawSize)), static_cast<int>(rawSize));
+	if (decompressed != static_cast<int>(rawSize)) {
+		throw std::runtime_error("Chunk in region file " + m_path.string() + " is corrupt");
+	}
+	return data;
+}
+
+size_t RegionFile::write(int localX, int localZ, const std::vector<uint8_t>& data) {
+	// Compress before taking the lock, so readers are not held up. Stored as the raw size
+	// followed by the LZ4 block.
+	uint32_t rawSize = static_cast<uint32_t>(data.size());
+	std::vector<uint8_t> blob(sizeof(rawSize) + LZ4_compressBound(static_cast<int>(data.size())));
+	std::memcpy(blob.data(), &rawSize, sizeof(rawSize));
+	int compressed = LZ4_compress_default(reinterpret_cast<const char*>(data.data()),
+		reinterpret_cast<char*>(blob.data() + sizeof(rawSize)), static_cast<int>(data.size()),
+		static_cast<int>(blob.size() - sizeof(rawSize)));
+	if (compressed <= 0) {
+		throw std::runtime_error("Could not compress chunk for " + m_path.string());
+	}
+	blob.resize(sizeof(rawSize) + compressed);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int index = entryIndex(localX, localZ);
+	uint32_t sectors = static_cast<uint32_t>((blob.size() + SECTOR_BYTES - 1) / SECTOR_BYTES);
+	// The old sectors stay taken until the table stops pointing at them, so the new data
+	// never overwrites the old: data first, then the table entry that points to it.
+	Entry old = m_table[index];
+	Entry entry{ allocate(sectors), static_cast<uint32_t>(blob.size()) };
+	writeAt(entry.sector * SECTOR_BYTES, blob.data(), blob.size());
+	writeAt(index * sizeof(Entry), &entry, sizeof(Entry));
+	m_table[index] = entry;
+	release(old);
+	return blob.size();
+}
+
+uint32_t RegionFile::allocate(uint32_t sectors) {
+	// First fit.
+	uint32_t run = 0;
+	for (uint32_t sector = TABLE_SECTORS; sector < m_usedSectors.size(); sector++) {
+		run = m_usedSectors[sector] ? 0 : run + 1;
+		if (run == sectors) {
+			uint32_t first = sector + 1 - sectors;
+			std::fill(m_usedSectors.begin() + first, m_usedSectors.begin() + sector + 1, true);
+			return first;
+		}
+	}
+	uint32_t first = static_cast<uint32_t>(m_usedSectors.size());
+	m_usedSectors.resize(m_usedSectors.size() + sectors, true);
+	return first;
+}
+
+void RegionFile::release(Entry entry) {
+	if (entry.length == 0) {
+		return;
+	}
+	uint64_t end = entry.sector * SECTOR_BYTES + entry.length;
+	for (uint64_t sector = entry.sector; sector * SECTOR_BYTES < end; sector++) {
+		m_usedSectors[sector] = false;
+	}
+}
+
+#ifdef _WIN32
+uint64_t RegionFile::fileSize() const {
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size)) {
+		throw std::runtime_error("Could not get the size of region file " + m_path.string());
+	}
+	return static_cast<uint64_t>(size.QuadPart);
+}
+
+void RegionFile::writeAt(uint64_t offset, const void* data, size_t size) {
+	OVERLAPPED position{};
+	position.Offset = static_cast<DWORD>(offset);
+	position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	DWORD written = 0;
+	if (!WriteFile(m_file, data, static_cast<DWORD>(size), &written, &position) || written != size) {
+		throw std::runtime_error("Could not write region file " + m_path.string());
+	}
+}
+
+void RegionFile::unmap() {
+	if (m_view != nullptr) {
+		UnmapViewOfFile(m_view);
+		CloseHandle(m_mapping);
+	}
+	m_view = nullptr;
+	m_mapping = nullptr;
+	m_viewSize = 0;
+}
+
+void RegionFile::remap() {
+	uint64_t size = fileSize();
+	if (size == m_viewSize) {
+		return;
+	}
+	unmap();
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr) {
+		throw std::runtime_error("Could not map region file " + m_path.string());
+	}
+	m_view = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_view == nullptr) {
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+		throw std::runtime_error("Could not map region file " + m_path.string());
+	}
+	m_viewSize = static_cast<size_t>(size);
+}
+#else
+uint64_t RegionFile::fileSize() const {
+	struct stat status;
+	if (fstat(m_file, &status) != 0) {
+		throw std::runtime_error("Could not get the size of region file " + m_path.string());
+	}
+	return static_cast<uint64_t>(status.st_size);
+}
+
+void RegionFile::writeAt(uint64_t offset, const void* data, size_t size) {
+	auto bytes = static_cast<const uint8_t*>(data);
+	while (size > 0) {
+		ssize_t written = pwrite(m_file, bytes, size, static_cast<off_t>(offset));
+		if (written <= 0) {
+			throw std::runtime_error("Could not write region file " + m_path.string());
+		}
+		bytes += written;
+		offset += written;
+		size -= written;
+	}
+}
+
+void RegionFile::unmap() {
+	if (m_view != nullptr) {
+		munmap(const_cast<uint8_t*>(m_view), m_viewSize);
+	}
+	m_view = nullptr;
+	m_viewSize = 0;
+}
+
+void RegionFile::remap() {
+	uint64_t size = fileSize();
+	if (size == m_viewSize) {
+		return;
+	}
+	unmap();
+	void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_file, 0);
+	if (view == MAP_FAILED) {
+		throw std::runtime_error("Could not map region file " + m_path.string());
+	}
+	m_view = static_cast<const uint8_t*>(view);
+	m_viewSize = static_cast<size_t>(size);
+}
+#endif
@@ -0,0 +1,61 @@
+#include "SectionConnectivity.h"
+#include <array>
+#include <bitset>
+#include <vector>
+
+SectionConnectivity SectionConnectivity::compute(const ChunkSection* section) {
+	SectionConnectivity result;
+	if (section == nullptr || section->isEmpty()) {
+		return result;
+	}
+	std::array<BlockId, SECTION_VOLUME> blocks;
+	section->unpack(blocks.data());
+
+	// Opaque blocks count as already visited, so the fills only walk open ones.
+	std::bitset<SECTION_VOLUME> visited;
+	for (int i = 0; i < SECTION_VOLUME; i++) {
+		visited[i] = isOpaque(blocks[i]);
+	}
+	uint16_t connected = 0;
+	std::vector<uint16_t> stack;
+	for (int start = 0; start < SECTION_VOLUME; start++) {
+		if (visited[start]) {
+			continue;
+		}
+		visited[start] = true;
+		stack.push_back(static_cast<uint16_t>(start));
+		// The faces this fill touches, one bit each.
+		uint8_t faces = 0;
+		while (!stack.empty()) {
+			int i = stack.back();
+			stack.pop_back();
+			int x = i % CHUNK_SIZE, z = i / CHUNK_SIZE % CHUNK_SIZE, y = i / (CHUNK_SIZE * CHUNK_SIZE);
+			const int coordinates[3] = { x, y, z };
+			const int strides[3] = { 1, CHUNK_SIZE * CHUNK_SIZE, CHUNK_SIZE };
+			for (int axis = 0; axis < 3; axis++) {
+				// Step toward + (face 2 * axis) and - (face 2 * axis + 1) along the axis.
+				for (int side = 0; side < 2; side++) {
+					bool atFace = side == 0 ? coordinates[axis] == CHUNK_SIZE - 1 : coordinates[axis] == 0;
+					if (atFace) {
+						faces |= 1 << (2 * axis + side);
+						continue;
+					}
+					int neighbor = side == 0 ? i + strides[axis] : i - strides[axis];
+					if (!visited[neighbor]) {
+						visited[neighbor] = true;
+						stack.push_back(static_cast<uint16_t>(neighbor));
+					}
+				}
+			}
+		}
+		for (int a = 0; a < 6; a++) {
+			for (int b = a + 1; b < 6; b++) {
+				if ((faces >> a & 1) && (faces >> b & 1)) {
+					connected |= pairBit(a, b);
+				}
+			}
+		}
+	}
+	result.separated = static_cast<uint16_t>(~connected & 0x7FFF);
+	return result;
+}
@@ -88,6 +88,73 @@ void ShaderProgram::load(const std::string& vertexShaderPath, const std::string&
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    reflectUniforms();
+}
+
+void ShaderProgram::reflectUniforms()
+{
+    m_uniforms.clear();
+
+    // Sampler units are fixed here, once per program, so drawing never has to assign them.
+    GLint previousProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+    glUseProgram(m_programId);
+
+    int uniformCount = 0;
+    int32_t nextUnit = 0;
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORMS, &uniformCount);
+    for (int i = 0; i < uniformCount; i++) {
+        char name[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_programId, i, sizeof(name), &length, &size, &type, name);
+        std::string_view uniformName(name, length);
+        // Arrays are reported as "name[0]"; they are set through their base name.
+        if (uniformName.size() > 3 && uniformName.substr(uniformName.size() - 3) == "[0]") {
+            uniformName.remove_suffix(3);
+        }
+        UniformSlot slot{ intern(uniformName), glGetUniformLocation(m_programId, name), -1 };
+
+        switch (type) {
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_SHADOW:
+            slot.unit = nextUnit++;
+            glUniform1i(slot.location, slot.unit);
+            break;
+        default:
+            break;
+        }
+        m_uniforms.push_back(slot);
+    }
+
+    glUseProgram(previousProgram);
+}
+
+int32_t ShaderProgram::location(Symbol uniformName) const
+{
+    // Programs have a handful of uniforms, so a linear scan beats any hashing.
+    for (auto& slot : m_uniforms) {
+        if (slot.name == uniformName.id) {
+            return slot.location;
+        }
+    }
+    return -1;
+}
+
+int32_t ShaderProgram::samplerUnit(SymbolId samplerName) const
+{
+    for (auto& slot : m_uniforms) {
+        if (slot.name == samplerName) {
+            return slot.unit;
+        }
+    }
+    return -1;
 }
 
 void ShaderProgram::activate()
@@ -95,47 +162,47 @@ void ShaderProgram::activate()
     glUseProgram(m_programId);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, bool value)
+void ShaderProgram::setUniform(Symbol uniformName, bool value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), (int32_t)value);
+    glUniform1i(location(uniformName), (int32_t)value);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, int32_t value)
+void ShaderProgram::setUniform(Symbol uniformName, int32_t value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), value);
+    glUniform1i(location(uniformName), value);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, float value)
+void ShaderProgram::setUniform(Symbol uniformName, float value)
 {
-    glUniform1f(glGetUniformLocation(m_programId, uniformName.c_str()), (int)value);
+    glUniform1f(location(uniformName), value);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec2& value)
+void ShaderProgram::setUniform(Symbol uniformName, const glm::vec2& value)
 {
-    glUniform2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    glUniform2fv(location(uniformName), 1, &value[0]);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec3& value)
+void ShaderProgram::setUniform(Symbol uniformName, const glm::vec3& value)
 {
-    glUniform3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    glUniform3fv(location(uniformName), 1, &value[0]);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec4& value)
+void ShaderProgram::setUniform(Symbol uniformName, const glm::vec4& value)
 {
-    glUniform4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    glUniform4fv(location(uniformName), 1, &value[0]);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat2& value)
+void ShaderProgram::setUniform(Symbol uniformName, const glm::mat2& value)
 {
-    glUniformMatrix2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    glUniformMatrix2fv(location(uniformName), 1, false, &value[0][0]);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat3& value)
+void ShaderProgram::setUniform(Symbol uniformName, const glm::mat3& value)
 {
-    glUniformMatrix3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    glUniformMatrix3fv(location(uniformName), 1, false, &value[0][0]);
 }
 
-void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat4& value)
+void ShaderProgram::setUniform(Symbol uniformName, const glm::mat4& value)
 {
-    glUniformMatrix4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    glUniformMatrix4fv(location(uniformName), 1, false, &value[0][0]);
 }
@@ -3,17 +3,229 @@
 
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace {
+    /**
+     * @brief How many of the requested levels can be dropped without going below
+     * StbImage::MIN_DOWNSCALED_SIZE.
+     */
+    int clampMipSkip(int width, int height, int mipSkip) {
+        int skip = 0;
+        while (skip < mipSkip && std::min(width, height) >> (skip + 1) >= StbImage::MIN_DOWNSCALED_SIZE) {
+            ++skip;
+        }
+        return skip;
+    }
+
+    // libjpeg reports fatal errors by calling error_exit, which must not return.
+    struct JpegErrorManager {
+        jpeg_error_mgr base;
+        std::jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+    };
+
+    void jpegErrorExit(j_common_ptr cinfo) {
+        auto* errors = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+        (*cinfo->err->format_message)(cinfo, errors->message);
+        std::longjmp(errors->jump, 1);
+    }
+
+    uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> entries{};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+            return entries;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<unsigned char>(value >> shift));
+        }
+    }
+
+    void appendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) {
+        appendBigEndian(out, static_cast<uint32_t>(data.size()));
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        appendBigEndian(out, crc32(&out[start], out.size() - start));
+    }
+}
 
 StbImage::StbImage() : m_width(0), m_height(0), m_bpp(0) {
 }
 
-void StbImage::loadFromFile(const std::string& filepath) {
-    unsigned char* data = stbi_load(filepath.c_str(), &m_width, &m_height, &m_bpp, 4);
+void StbImage::loadFromFile(const std::string& filepath, int mipSkip) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Could not load file " + filepath);
+    std::vector<unsigned char> encoded((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    decode(encoded.data(), encoded.size(), mipSkip, filepath);
+}
+
+void StbImage::loadFromMemory(const unsigned char* encoded, size_t size, int mipSkip, const std::string& name) {
+    decode(encoded, size, mipSkip, name);
+}
+
+void StbImage::setPixels(int width, int height, int bpp, std::unique_ptr<unsigned char[]> data) {
+    m_width = width;
+    m_height = height;
+    m_bpp = bpp;
+    m_data = std::move(data);
+}
+
+void StbImage::decode(const unsigned char* encoded, size_t size, int mipSkip, const std::string& name) {
+    // JPEGs start with an SOI marker; libjpeg-turbo decodes those faster than stb and can
+    // downscale inside the decoder itself.
+    if (size > 2 && encoded[0] == 0xFF && encoded[1] == 0xD8) {
+        decodeJpeg(encoded, size, mipSkip, name);
+        return;
+    }
+
+    // Ask for 0 channels so stb keeps the file's own layout; Texture::loadImage picks a
+    // matching GL format rather than paying 4 bytes per texel for every map.
+    unsigned char* data = stbi_load_from_memory(encoded, static_cast<int>(size), &m_width, &m_height, &m_bpp, 0);
 
     if (data == nullptr)
-        throw std::runtime_error("Could not load file " + filepath);
+        throw std::runtime_error("Could not load file " + name);
 
     m_data = std::unique_ptr<unsigned char[]>(data);
+    halve(clampMipSkip(m_width, m_height, mipSkip));
+}
+
+void StbImage::decodeJpeg(const unsigned char* encoded, size_t size, int mipSkip, const std::string& name) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager errors;
+    cinfo.err = jpeg_std_error(&errors.base);
+    errors.base.error_exit = jpegErrorExit;
+    // Only members are modified between setjmp and the decode finishing, so nothing is
+    // left indeterminate when an error jumps back here.
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        throw std::runtime_error("Could not decode JPEG " + name + ": " + errors.message);
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, encoded, static_cast<unsigned long>(size));
+    jpeg_read_header(&cinfo, TRUE);
+
+    // The IDCT can produce 1/2, 1/4 and 1/8 scale output directly, skipping most of the
+    // work for the discarded detail.
+    int skip = std::min(clampMipSkip(cinfo.image_width, cinfo.image_height, mipSkip), 3);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 1u << skip;
+    cinfo.out_color_space = cinfo.jpeg_color_space == JCS_GRAYSCALE ? JCS_GRAYSCALE : JCS_RGB;
+    // Reduced output hides the precision loss of the fast IDCT and plain chroma upsampling.
+    cinfo.dct_method = skip > 0 ? JDCT_IFAST : JDCT_ISLOW;
+    cinfo.do_fancy_upsampling = skip == 0;
+    jpeg_start_decompress(&cinfo);
+
+    m_width = cinfo.output_width;
+    m_height = cinfo.output_height;
+    m_bpp = cinfo.output_components;
+    size_t stride = static_cast<size_t>(m_width) * m_bpp;
+    m_data = std::make_unique<unsigned char[]>(stride * m_height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = m_data.get() + stride * cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+}
+
+void StbImage::halve(int levels) {
+    // Repeated 2x2 box filter, which is exactly what the first mip levels would have held.
+    for (int level = 0; level < levels; ++level) {
+        int width = m_width / 2, height = m_height / 2;
+        auto halved = std::make_unique<unsigned char[]>(static_cast<size_t>(width) * height * m_bpp);
+        const unsigned char* src = m_data.get();
+        size_t srcStride = static_cast<size_t>(m_width) * m_bpp;
+        for (int y = 0; y < height; ++y) {
+            const unsigned char* row0 = src + srcStride * (2 * y);
+            const unsigned char* row1 = row0 + srcStride;
+            unsigned char* out = halved.get() + static_cast<size_t>(y) * width * m_bpp;
+            for (int x = 0; x < width; ++x) {
+                const unsigned char* a = row0 + 2 * x * m_bpp;
+                const unsigned char* b = row1 + 2 * x * m_bpp;
+                for (int c = 0; c < m_bpp; ++c) {
+                    *out++ = static_cast<unsigned char>((a[c] + a[c + m_bpp] + b[c] + b[c + m_bpp] + 2) >> 2);
+                }
+            }
+        }
+        m_data = std::move(halved);
+        m_width = width;
+        m_height = height;
+    }
+}
+
+void StbImage::saveToPng(const std::string& filepath) const {
+    static const unsigned char colorTypes[] = { 0, 0, 4, 2, 6 };
+    if (m_bpp < 1 || m_bpp > 4)
+        throw std::runtime_error("Cannot save a " + std::to_string(m_bpp) + "-channel image as PNG: " + filepath);
+
+    // Every row starts with filter type 0 (none).
+    size_t rowSize = static_cast<size_t>(m_width) * m_bpp;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowSize + 1) * m_height);
+    for (int y = 0; y < m_height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), m_data.get() + y * rowSize, m_data.get() + (y + 1) * rowSize);
+    }
+
+    // A zlib stream of stored blocks, at most 65535 bytes each, then the Adler-32 of the rows.
+    std::vector<unsigned char> compressed = { 0x78, 0x01 };
+    size_t offset = 0;
+    do {
+        size_t length = std::min<size_t>(65535, raw.size() - offset);
+        compressed.push_back(offset + length == raw.size() ? 1 : 0);
+        compressed.push_back(static_cast<unsigned char>(length));
+        compressed.push_back(static_cast<unsigned char>(length >> 8));
+        compressed.push_back(static_cast<unsigned char>(~length));
+        compressed.push_back(static_cast<unsigned char>(~length >> 8));
+        compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(compressed, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, m_width);
+    appendBigEndian(header, m_height);
+    header.insert(header.end(), { 8, colorTypes[m_bpp], 0, 0, 0 });
+
+    std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", compressed);
+    appendChunk(png, "IEND", {});
+
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    if (!file)
+        throw std::runtime_error("Could not write file " + filepath);
 }
 
 int StbImage::getWidth() const { return m_width; }
@@ -22,4 +234,4 @@ int StbImage::getHeight() const { return m_height; }
 
 int StbImage::getBpp() const { return m_bpp; }
 
-unsigned char* StbImage::getData() const { return m_data.get(); }
\ No newline at end of file
+unsigned char* StbImage::getData() const { return m_data.get(); }
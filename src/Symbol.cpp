@@ -0,0 +1,27 @@
+#include "Symbol.h"
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+	std::mutex tableMutex;
+	std::unordered_map<SymbolId, std::string> symbolTable;
+}
+
+SymbolId intern(std::string_view name) {
+	SymbolId id = hashSymbol(name);
+	std::lock_guard<std::mutex> lock(tableMutex);
+	auto [existing, inserted] = symbolTable.emplace(id, name);
+	if (!inserted && existing->second != name) {
+		throw std::runtime_error("Symbol hash collision between \"" + existing->second + "\" and \""
+			+ std::string(name) + "\"");
+	}
+	return id;
+}
+
+const std::string& symbolName(SymbolId id) {
+	static const std::string unknown = "<unknown>";
+	std::lock_guard<std::mutex> lock(tableMutex);
+	auto existing = symbolTable.find(id);
+	return existing != symbolTable.end() ? existing->second : unknown;
+}
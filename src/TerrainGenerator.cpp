@@ -0,0 +1,184 @@
+#include "TerrainGenerator.h"
+#include "Noise.h"
+#include "ThreadPool.h"
+#include "World.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <vector>
+
+namespace {
+	constexpr int COLUMNS = CHUNK_SIZE * CHUNK_SIZE;
+
+	// Seeds of the individual noise fields, relative to the world seed.
+	constexpr uint32_t BIOME_SEED = 1;
+	constexpr uint32_t PLAINS_SEED = 2;
+	constexpr uint32_t HILLS_SEED = 3;
+	constexpr uint32_t CAVE_SEED = 4;
+
+	// Inside this radius (in blocks) around the origin the ground is flat; it returns to
+	// full height at the outer radius.
+	constexpr float CLEARING_RADIUS = 24.0f;
+	constexpr float CLEARING_FALLOFF = 64.0f;
+	// Caves never come closer than this to the surface inside the clearing.
+	constexpr int CLEARING_CAVE_COVER = 6;
+	// Caves are where the cave noise exceeds this; higher means fewer, narrower caves.
+	constexpr float CAVE_THRESHOLD = 0.25f;
+	// Caves are squashed vertically so they run more sideways than up and down.
+	constexpr float CAVE_VERTICAL_STRETCH = 1.6f;
+	// One in this many cave floor blocks is glowstone.
+	constexpr uint32_t GLOWSTONE_RARITY = 256;
+
+	uint32_t hashBlock(int x, int y, int z, uint32_t seed) {
+		uint32_t h = seed ^ static_cast<uint32_t>(x) * 0x27d4eb2du ^ static_cast<uint32_t>(y) * 0x165667b1u
+			^ static_cast<uint32_t>(z) * 0x9e3779b1u;
+		h ^= h >> 15;
+		h *= 0x2c1b3c6du;
+		h ^= h >> 12;
+		return h;
+	}
+
+	float smoothstep(float edge0, float edge1, float x) {
+		float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+		return t * t * (3.0f - 2.0f * t);
+	}
+}
+
+TerrainGenerator::TerrainGenerator(uint32_t seed) : m_seed(seed) {
+}
+
+void TerrainGenerator::surfaceHeights(const float* xs, const float* zs, int count, float* heights, float* wildness) const {
+	std::vector<float> biome(count), plains(count), hills(count);
+	fractalNoise2D(xs, zs, biome.data(), count, m_seed + BIOME_SEED, 2, 1.0f / 384.0f);
+	fractalNoise2D(xs, zs, plains.data(), count, m_seed + PLAINS_SEED, 3, 1.0f / 48.0f);
+	fractalNoise2D(xs, zs, hills.data(), count, m_seed + HILLS_SEED, 5, 1.0f / 96.0f);
+
+	// The biome noise blends smoothly between plains and hills, so there are no seams where
+	// biomes meet.
+	for (int i = 0; i < count; i++) {
+		float hilliness = smoothstep(-0.15f, 0.25f, biome[i]);
+		float plainsHeight = World::GROUND_LEVEL + 3.0f * plains[i];
+		float hillsHeight = World::GROUND_LEVEL + 6.0f + 40.0f * hills[i];
+		float height = plainsHeight + hilliness * (hillsHeight - plainsHeight);
+
+		wildness[i] = smoothstep(CLEARING_RADIUS, CLEARING_FALLOFF, std::sqrt(xs[i] * xs[i] + zs[i] * zs[i]));
+		heights[i] = World::GROUND_LEVEL + wildness[i] * (height - World::GROUND_LEVEL);
+	}
+}
+
+void TerrainGenerator::generate(Chunk& chunk) const {
+	ChunkPos pos = chunk.getPos();
+
+	// Columns are indexed z * CHUNK_SIZE + x, and evaluated NOISE_BATCH at a time.
+	std::array<float, COLUMNS> xs, zs;
+	for (int z = 0; z < CHUNK_SIZE; z++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			xs[z * CHUNK_SIZE + x] = static_cast<float>(pos.x * CHUNK_SIZE + x);
+			zs[z * CHUNK_SIZE + x] = static_cast<float>(pos.z * CHUNK_SIZE + z);
+		}
+	}
+	std::array<float, COLUMNS> heights, wildness;
+	surfaceHeights(xs.data(), zs.data(), COLUMNS, heights.data(), wildness.data());
+
+	std::array<int, COLUMNS> surface, caveCeiling;
+	int highest = 0;
+	for (int i = 0; i < COLUMNS; i++) {
+		surface[i] = std::clamp(static_cast<int>(std::floor(heights[i])), 1, CHUNK_HEIGHT - 1);
+		caveCeiling[i] = surface[i] - static_cast<int>(std::ceil(CLEARING_CAVE_COVER * (1.0f - wildness[i])));
+		highest = std::max(highest, surface[i]);
+	}
+
+	// Caves, one horizontal layer at a time. Layer 0 stays solid, so nothing falls out of
+	// the bottom of the world. Each section is filled unpacked, then packed in one go.
+	std::array<float, COLUMNS> ys, cave;
+	std::array<BlockId, SECTION_VOLUME> blocks;
+	for (int sy = 0; sy * CHUNK_SIZE < highest; sy++) {
+		for (int ly = 0; ly < CHUNK_SIZE; ly++) {
+			int y = sy * CHUNK_SIZE + ly;
+			bool carve = y > 0 && y < highest;
+			if (carve) {
+				ys.fill(y * CAVE_VERTICAL_STRETCH);
+				fractalNoise3D(xs.data(), ys.data(), zs.data(), cave.data(), COLUMNS, m_seed + CAVE_SEED, 2,
+					1.0f / 40.0f);
+			}
+			for (int i = 0; i < COLUMNS; i++) {
+				bool solid = y < surface[i] && !(carve && y < caveCeiling[i] && cave[i] > CAVE_THRESHOLD);
+				// Columns are z-major like the rows of a section layer.
+				blocks[ly * COLUMNS + i] = solid ? Blocks::COBBLESTONE : Blocks::AIR;
+			}
+		}
+		chunk.setSection(sy, std::make_shared<ChunkSection>(blocks.data()));
+	}
+
+	// Now and then, a cave floor block glows.
+	for (int z = 0; z < CHUNK_SIZE; z++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			int worldX = pos.x * CHUNK_SIZE + x, worldZ = pos.z * CHUNK_SIZE + z;
+			for (int y = 1; y < caveCeiling[z * CHUNK_SIZE + x]; y++) {
+				if (chunk.getBlock(x, y, z) != Blocks::AIR && chunk.getBlock(x, y + 1, z) == Blocks::AIR
+					&& hashBlock(worldX, y, worldZ, m_seed) % GLOWSTONE_RARITY == 0) {
+					chunk.setBlock(x, y, z, Blocks::GLOWSTONE);
+				}
+			}
+		}
+	}
+}
+
+void TerrainGenerator::downsampledHeights(ChunkPos first, int scale, int* heights) const {
+	constexpr int SIDE = CHUNK_SIZE + 2;
+	// Noise is evaluated in whole batches; the samples past the last column are ignored.
+	constexpr int SAMPLES = (SIDE * SIDE + NOISE_BATCH - 1) / NOISE_BATCH * NOISE_BATCH;
+	std::array<float, SAMPLES> xs{}, zs{}, blockHeights, wildness;
+	for (int z = 0; z < SIDE; z++) {
+		for (int x = 0; x < SIDE; x++) {
+			// The center of the column of cells; cells start one column before the square.
+			xs[z * SIDE + x] = static_cast<float>(first.x * CHUNK_SIZE + (x - 1) * scale) + scale * 0.5f;
+			zs[z * SIDE + x] = static_cast<float>(first.z * CHUNK_SIZE + (z - 1) * scale) + scale * 0.5f;
+		}
+	}
+	surfaceHeights(xs.data(), zs.data(), SAMPLES, blockHeights.data(), wildness.data());
+	for (int i = 0; i < SIDE * SIDE; i++) {
+		int top = std::clamp(static_cast<int>(std::floor(blockHeights[i])), 1, CHUNK_HEIGHT - 1);
+		// Cells whose center lies below the surface are solid.
+		heights[i] = std::max(0, (top - scale / 2 + scale - 1) / scale);
+	}
+}
+
+void TerrainGenerator::benchmark(int chunkCount) const {
+	using Clock = std::chrono::steady_clock;
+	auto chunkAt = [](int i) { return ChunkPos{ i % 64 - 32, i / 64 - 32 }; };
+
+	auto start = Clock::now();
+	for (int i = 0; i < chunkCount; i++) {
+		Chunk chunk(chunkAt(i));
+		generate(chunk);
+	}
+	double single = std::chrono::duration<double>(Clock::now() - start).count();
+
+	ThreadPool& pool = ThreadPool::shared();
+	std::vector<std::future<void>> jobs;
+	start = Clock::now();
+	for (int i = 0; i < chunkCount; i++) {
+		jobs.push_back(pool.submit([this, pos = chunkAt(i)]() {
+			Chunk chunk(pos);
+			generate(chunk);
+		}));
+	}
+	for (auto& job : jobs) {
+		job.get();
+	}
+	double parallel = std::chrono::duration<double>(Clock::now() - start).count();
+
+#if defined(__AVX2__)
+	const char* path = "AVX2";
+#else
+	const char* path = "scalar";
+#endif
+	std::cout << "Terrain benchmark (" << path << " noise), " << chunkCount << " chunks: "
+		<< chunkCount / single << " chunks/s on 1 thread, "
+		<< chunkCount / parallel << " chunks/s on " << pool.threadCount() << " threads ("
+		<< chunkCount / parallel / pool.threadCount() << " per core)" << std::endl;
+}
@@ -0,0 +1,265 @@
+#include "Texture.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+// Memory info queries from GL_NVX_gpu_memory_info and GL_ATI_meminfo; both report KiB.
+#ifndef GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+namespace {
+	/**
+	 * @brief A texture whose name exists but whose image has not been decoded yet.
+	 */
+	struct PendingTexture {
+		std::function<StbImage()> decode;
+		std::string name;
+		TextureUsage usage;
+	};
+
+	// Deferred loads, keyed by the reserved texture name.
+	std::unordered_map<uint32_t, PendingTexture> pendingTextures;
+	bool srgbColorStorage = false;
+	TextureQuality currentQuality = TextureQuality::High;
+	TextureMemoryStats totalMemory = { 0, 0 };
+
+	bool hasExtension(const char* name) {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; ++i) {
+			auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (extension != nullptr && std::strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * @brief Bytes used by a full mipmap chain of the given base size and texel size.
+	 */
+	size_t mipChainBytes(int width, int height, size_t bytesPerTexel) {
+		size_t total = 0;
+		while (true) {
+			total += static_cast<size_t>(width) * height * bytesPerTexel;
+			if (width == 1 && height == 1) {
+				break;
+			}
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+		}
+		return total;
+	}
+
+	/**
+	 * @brief Uploads an image into an existing texture name and builds its mipmaps.
+	 */
+	void uploadImage(uint32_t texId, const StbImage& texture, TextureUsage usage) {
+		bool srgb = usage == TextureUsage::Color && srgbColorStorage;
+
+		// Pick the smallest internal format that holds the image's channels, and a swizzle
+		// that reproduces what an RGBA expansion would have returned to the shader.
+		GLenum internalFormat, format;
+		size_t bytesPerTexel;
+		GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+		switch (texture.getBpp()) {
+		case 1:
+			// Grey: (g, g, g, 1). There is no core single-channel sRGB format, so grey color
+			// maps are stored as SRGB8 with only the red channel uploaded.
+			format = GL_RED;
+			internalFormat = srgb ? GL_SRGB8 : GL_R8;
+			bytesPerTexel = srgb ? 3 : 1;
+			swizzle[1] = GL_RED;
+			swizzle[2] = GL_RED;
+			swizzle[3] = GL_ONE;
+			break;
+		case 2:
+			// Grey + alpha: (g, g, g, a). Always RG8: sRGB storage would decode the green
+			// channel, which holds the alpha here, and the grey would need expanding to RGB.
+			format = GL_RG;
+			internalFormat = GL_RG8;
+			bytesPerTexel = 2;
+			swizzle[1] = GL_RED;
+			swizzle[2] = GL_RED;
+			swizzle[3] = GL_GREEN;
+			break;
+		case 3:
+			format = GL_RGB;
+			internalFormat = srgb ? GL_SRGB8 : GL_RGB8;
+			bytesPerTexel = 3;
+			swizzle[3] = GL_ONE;
+			break;
+		default:
+			format = GL_RGBA;
+			internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+			bytesPerTexel = 4;
+			break;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, texId);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+		// Rows of 1- and 3-channel images are not 4-byte aligned in general.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, texture.getWidth(), texture.getHeight(), 0, format,
+			GL_UNSIGNED_BYTE, texture.getData());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		totalMemory.bytes += mipChainBytes(texture.getWidth(), texture.getHeight(), bytesPerTexel);
+		totalMemory.rgba8Bytes += mipChainBytes(texture.getWidth(), texture.getHeight(), 4);
+	}
+}
+
+Texture Texture::loadImage(const StbImage& texture, const std::string& samplerName,
+	TextureUsage usage) {
+	uint32_t texId;
+	glGenTextures(1, &texId);
+	uploadImage(texId, texture, usage);
+	return Texture{ texId, intern(samplerName) };
+}
+
+Texture Texture::loadDeferred(std::function<StbImage()> decode, const std::string& name,
+	const std::string& samplerName, TextureUsage usage) {
+	uint32_t texId;
+	glGenTextures(1, &texId);
+	pendingTextures.emplace(texId, PendingTexture{ std::move(decode), name, usage });
+	return Texture{ texId, intern(samplerName) };
+}
+
+void Texture::ensureLoaded() const {
+	if (pendingTextures.empty()) {
+		return;
+	}
+	auto pending = pendingTextures.find(textureId);
+	if (pending == pendingTextures.end()) {
+		return;
+	}
+	PendingTexture load = std::move(pending->second);
+	pendingTextures.erase(pending);
+	std::cout << "loading deferred " << load.name << std::endl;
+	StbImage image;
+	try {
+		image = load.decode();
+	}
+	catch (const std::runtime_error& error) {
+		// This runs mid-frame, where nothing catches it; draw the mesh without the map instead.
+		std::cout << "Could not load deferred " << load.name << ": " << error.what() << std::endl;
+		auto white = std::make_unique<unsigned char[]>(4);
+		std::memset(white.get(), 255, 4);
+		image.setPixels(1, 1, 4, std::move(white));
+	}
+	uploadImage(textureId, image, load.usage);
+}
+
+StbImage Texture::download() const {
+	ensureLoaded();
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	GLint width = 0, height = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+	size_t texels = static_cast<size_t>(width) * height;
+	auto stored = std::make_unique<unsigned char[]>(texels * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, stored.get());
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Reading back ignores the swizzle, so apply it here.
+	auto pixels = std::make_unique<unsigned char[]>(texels * 4);
+	for (size_t i = 0; i < texels; i++) {
+		for (int channel = 0; channel < 4; channel++) {
+			unsigned char value;
+			switch (swizzle[channel]) {
+			case GL_RED: value = stored[i * 4]; break;
+			case GL_GREEN: value = stored[i * 4 + 1]; break;
+			case GL_BLUE: value = stored[i * 4 + 2]; break;
+			case GL_ALPHA: value = stored[i * 4 + 3]; break;
+			case GL_ZERO: value = 0; break;
+			default: value = 255; break;
+			}
+			pixels[i * 4 + channel] = value;
+		}
+	}
+	StbImage image;
+	image.setPixels(width, height, 4, std::move(pixels));
+	return image;
+}
+
+TextureUsage Texture::usageForSampler(const std::string& samplerName) {
+	return samplerName == "baseTexture" ? TextureUsage::Color : TextureUsage::Data;
+}
+
+void Texture::setSrgbColorStorage(bool enabled) {
+	srgbColorStorage = enabled;
+}
+
+bool Texture::srgbColorStorageEnabled() {
+	return srgbColorStorage;
+}
+
+TextureMemoryStats Texture::memoryStats() {
+	return totalMemory;
+}
+
+void Texture::setQuality(TextureQuality quality) {
+	currentQuality = quality;
+}
+
+TextureQuality Texture::quality() {
+	return currentQuality;
+}
+
+int Texture::mipSkip() {
+	return static_cast<int>(currentQuality);
+}
+
+TextureQuality Texture::qualityForBudget(size_t budgetBytes) {
+	const size_t MiB = 1024 * 1024;
+	if (budgetBytes == 0 || budgetBytes >= 2048 * MiB) {
+		return TextureQuality::High;
+	}
+	if (budgetBytes >= 1024 * MiB) {
+		return TextureQuality::Medium;
+	}
+	if (budgetBytes >= 512 * MiB) {
+		return TextureQuality::Low;
+	}
+	return TextureQuality::VeryLow;
+}
+
+size_t Texture::videoMemoryBudget() {
+	const size_t KiB = 1024;
+	if (const char* override = std::getenv("GRAPHICS_TEXTURE_BUDGET_MB")) {
+		return static_cast<size_t>(std::strtoull(override, nullptr, 10)) * KiB * KiB;
+	}
+
+	// Clear any earlier error so a failed query below is not mistaken for a value.
+	while (glGetError() != GL_NO_ERROR) {}
+	if (hasExtension("GL_NVX_gpu_memory_info")) {
+		GLint kib = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &kib);
+		return static_cast<size_t>(kib) * KiB;
+	}
+	if (hasExtension("GL_ATI_meminfo")) {
+		// Free pool size, largest free block, free auxiliary size, largest auxiliary block.
+		GLint kib[4] = { 0, 0, 0, 0 };
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, kib);
+		return static_cast<size_t>(kib[0]) * KiB;
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include "TextureArray.h"
+#include <algorithm>
+#include <stdexcept>
+#include "Texture.h"
+
+namespace {
+	/**
+	 * @brief Expands a pixel of any channel count to RGBA, the way Texture's swizzles do.
+	 */
+	void toRgba(const unsigned char* pixel, int bpp, unsigned char* rgba) {
+		switch (bpp) {
+		case 1:
+			rgba[0] = rgba[1] = rgba[2] = pixel[0];
+			rgba[3] = 255;
+			break;
+		case 2:
+			rgba[0] = rgba[1] = rgba[2] = pixel[0];
+			rgba[3] = pixel[1];
+			break;
+		case 3:
+			std::copy_n(pixel, 3, rgba);
+			rgba[3] = 255;
+			break;
+		default:
+			std::copy_n(pixel, 4, rgba);
+			break;
+		}
+	}
+}
+
+TextureArray TextureArray::build(const std::vector<Layer>& layers, const std::string& samplerName) {
+	if (layers.empty()) {
+		throw std::runtime_error("Texture array " + samplerName + " has no layers");
+	}
+	int width = layers[0].image->getWidth();
+	int height = layers[0].image->getHeight();
+	for (auto& layer : layers) {
+		if (layer.image->getWidth() != width || layer.image->getHeight() != height) {
+			throw std::runtime_error("The layers of texture array " + samplerName + " differ in size");
+		}
+	}
+
+	// Layers of different channel counts share one format, so every layer becomes RGBA.
+	size_t layerTexels = static_cast<size_t>(width) * height;
+	std::vector<unsigned char> texels(layerTexels * 4 * layers.size());
+	for (size_t i = 0; i < layers.size(); i++) {
+		const StbImage& image = *layers[i].image;
+		glm::vec3 tint = glm::clamp(layers[i].tint, 0.0f, 1.0f);
+		unsigned char* out = &texels[i * layerTexels * 4];
+		for (size_t t = 0; t < layerTexels; t++, out += 4) {
+			toRgba(image.getData() + t * image.getBpp(), image.getBpp(), out);
+			for (int c = 0; c < 3; c++) {
+				out[c] = static_cast<unsigned char>(out[c] * tint[c] + 0.5f);
+			}
+		}
+	}
+
+	uint32_t texId;
+	glGenTextures(1, &texId);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texId);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	GLenum internalFormat = Texture::srgbColorStorageEnabled() ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, width, height, static_cast<GLsizei>(layers.size()), 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return TextureArray{ texId, intern(samplerName), static_cast<int>(layers.size()) };
+}
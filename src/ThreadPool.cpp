@@ -0,0 +1,54 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) : m_nextSequence(0), m_stopping(false) {
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (size_t i = 0; i < threadCount; ++i) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+			// Drain the queue before stopping, so every returned future is satisfied.
+			if (m_jobs.empty()) {
+				return;
+			}
+			std::pop_heap(m_jobs.begin(), m_jobs.end());
+			job = std::move(m_jobs.back().run);
+			m_jobs.pop_back();
+		}
+		job();
+	}
+}
+
+size_t ThreadPool::queuedCount() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_jobs.size();
+}
+
+size_t ThreadPool::threadCount() const {
+	return m_workers.size();
+}
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,270 @@
+#include "VoxelRaycast.h"
+#include <bit>
+#include <cmath>
+#include <limits>
+#include "Lanes.h"
+
+namespace {
+	constexpr float NEVER = std::numeric_limits<float>::infinity();
+
+	int floorDiv(int value, int divisor) {
+		return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+	}
+
+	/**
+	 * @brief The traversal state of a batch of rays, one array entry per ray.
+	 */
+	struct DdaState {
+		// Per axis: the block the ray is in, and which way it moves through the blocks.
+		alignas(32) int32_t cell[3][RAY_BATCH];
+		alignas(32) int32_t step[3][RAY_BATCH];
+		// Per axis: how far along the ray the next block boundary is, and the distance
+		// between two boundaries.
+		alignas(32) float tMax[3][RAY_BATCH];
+		alignas(32) float tDelta[3][RAY_BATCH];
+		// How far along the ray the current block was entered, and across which axis (-1 for
+		// the block the ray starts in).
+		alignas(32) float t[RAY_BATCH];
+		alignas(32) int32_t axis[RAY_BATCH];
+	};
+
+#if defined(__AVX2__)
+	using Lanes = Avx2Lanes;
+	static_assert(Lanes::WIDTH == RAY_BATCH);
+#else
+	using Lanes = ScalarLanes;
+#endif
+
+	/**
+	 * @brief Moves every ray of the batch into its next block, across whichever boundary
+	 * comes first. Ties go to the later axis, exactly as in skipSection(). Finished rays are
+	 * moved along too; their state is no longer read.
+	 */
+	template <typename L>
+	void advance(DdaState& s) {
+		for (int i = 0; i < RAY_BATCH; i += L::WIDTH) {
+			auto tx = L::load(&s.tMax[0][i]), ty = L::load(&s.tMax[1][i]), tz = L::load(&s.tMax[2][i]);
+			auto alongX = L::both(L::less(tx, ty), L::less(tx, tz));
+			auto alongY = L::butNot(alongX, L::less(ty, tz));
+			auto alongZ = L::neither(alongX, alongY);
+			L::store(&s.t[i], L::select(alongX, tx, L::select(alongY, ty, tz)));
+			L::store(&s.axis[i], L::select(alongX, L::splatInt(0), L::select(alongY, L::splatInt(1), L::splatInt(2))));
+
+			L::store(&s.tMax[0][i], L::addIf(alongX, tx, L::load(&s.tDelta[0][i])));
+			L::store(&s.tMax[1][i], L::addIf(alongY, ty, L::load(&s.tDelta[1][i])));
+			L::store(&s.tMax[2][i], L::addIf(alongZ, tz, L::load(&s.tDelta[2][i])));
+			L::store(&s.cell[0][i], L::addIf(alongX, L::load(&s.cell[0][i]), L::load(&s.step[0][i])));
+			L::store(&s.cell[1][i], L::addIf(alongY, L::load(&s.cell[1][i]), L::load(&s.step[1][i])));
+			L::store(&s.cell[2][i], L::addIf(alongZ, L::load(&s.cell[2][i]), L::load(&s.step[2][i])));
+		}
+	}
+
+	/**
+	 * @brief Starts a ray in the block containing its origin.
+	 * @param direction of unit length.
+	 */
+	void start(DdaState& s, int lane, const glm::vec3& origin, const glm::vec3& direction) {
+		for (int a = 0; a < 3; a++) {
+			int cell = static_cast<int>(std::floor(origin[a]));
+			s.cell[a][lane] = cell;
+			if (direction[a] > 0.0f) {
+				s.step[a][lane] = 1;
+				s.tDelta[a][lane] = 1.0f / direction[a];
+				s.tMax[a][lane] = (static_cast<float>(cell + 1) - origin[a]) / direction[a];
+			}
+			else if (direction[a] < 0.0f) {
+				s.step[a][lane] = -1;
+				s.tDelta[a][lane] = -1.0f / direction[a];
+				s.tMax[a][lane] = (origin[a] - static_cast<float>(cell)) / -direction[a];
+			}
+			else {
+				s.step[a][lane] = 0;
+				s.tDelta[a][lane] = NEVER;
+				s.tMax[a][lane] = NEVER;
+			}
+		}
+		s.t[lane] = 0.0f;
+		s.axis[lane] = -1;
+	}
+
+	/**
+	 * @brief Moves a ray straight into the first block past the section it is in, with the
+	 * same boundary crossings (and the same rounding) that stepping block by block would make.
+	 */
+	void skipSection(DdaState& s, int lane) {
+		// When the ray crosses the section's far boundary on each axis.
+		float exit = NEVER;
+		int exitAxis = 0;
+		int crossings[3] = {};
+		float exitTimes[3];
+		for (int a = 0; a < 3; a++) {
+			int cell = s.cell[a][lane];
+			int base = floorDiv(cell, CHUNK_SIZE) * CHUNK_SIZE;
+			crossings[a] = s.step[a][lane] > 0 ? base + CHUNK_SIZE - cell : s.step[a][lane] < 0 ? cell - base + 1 : 0;
+			exitTimes[a] = s.tMax[a][lane];
+			for (int k = 1; k < crossings[a]; k++) {
+				exitTimes[a] += s.tDelta[a][lane];
+			}
+			if (crossings[a] > 0 && exitTimes[a] <= exit) {
+				exit = exitTimes[a];
+				exitAxis = a;
+			}
+		}
+
+		for (int a = 0; a < 3; a++) {
+			if (a == exitAxis) {
+				s.cell[a][lane] += s.step[a][lane] * crossings[a];
+				s.tMax[a][lane] = exitTimes[a] + s.tDelta[a][lane];
+				continue;
+			}
+			// Boundaries crossed on the way out; at the same moment, the later axis goes first.
+			while (s.tMax[a][lane] < exit || (s.tMax[a][lane] == exit && a > exitAxis)) {
+				s.cell[a][lane] += s.step[a][lane];
+				s.tMax[a][lane] += s.tDelta[a][lane];
+			}
+		}
+		s.t[lane] = exit;
+		s.axis[lane] = exitAxis;
+	}
+}
+
+struct VoxelRaycaster::Batch {
+	DdaState dda;
+	// How far each ray goes.
+	float tEnd[RAY_BATCH];
+	// For line of sight, where the first and last blocks are not tested: the last block.
+	bool lineOfSight = false;
+	glm::ivec3 last[RAY_BATCH];
+
+	// The section each ray was last in.
+	bool sectionKnown[RAY_BATCH] = {};
+	glm::ivec3 sectionPos[RAY_BATCH];
+	const ChunkSection* section[RAY_BATCH];
+
+	// What each ray hit, saved when it finishes.
+	bool hit[RAY_BATCH] = {};
+	BlockId hitId[RAY_BATCH];
+	glm::ivec3 hitBlock[RAY_BATCH];
+	glm::ivec3 hitNormal[RAY_BATCH];
+	float hitDistance[RAY_BATCH];
+};
+
+VoxelRaycaster::VoxelRaycaster(SectionLookup lookup) : m_lookup(std::move(lookup)) {
+}
+
+bool VoxelRaycaster::visit(Batch& batch, int lane) const {
+	DdaState& s = batch.dda;
+	while (true) {
+		if (s.t[lane] > batch.tEnd[lane]) {
+			return false;
+		}
+		glm::ivec3 cell(s.cell[0][lane], s.cell[1][lane], s.cell[2][lane]);
+		if (batch.lineOfSight && cell == batch.last[lane]) {
+			return false;
+		}
+		// Nothing lies above or below the world.
+		int stepY = s.step[1][lane];
+		if ((cell.y < 0 && stepY <= 0) || (cell.y >= CHUNK_HEIGHT && stepY >= 0)) {
+			return false;
+		}
+
+		glm::ivec3 sectionPos(floorDiv(cell.x, CHUNK_SIZE), floorDiv(cell.y, CHUNK_SIZE), floorDiv(cell.z, CHUNK_SIZE));
+		const ChunkSection* section = nullptr;
+		if (cell.y >= 0 && cell.y < CHUNK_HEIGHT) {
+			if (!batch.sectionKnown[lane] || batch.sectionPos[lane] != sectionPos) {
+				batch.sectionKnown[lane] = true;
+				batch.sectionPos[lane] = sectionPos;
+				batch.section[lane] = m_lookup(sectionPos);
+			}
+			section = batch.section[lane];
+		}
+		if (section == nullptr || section->isEmpty()) {
+			skipSection(s, lane);
+			continue;
+		}
+		if (batch.lineOfSight && s.axis[lane] < 0) {
+			return true;
+		}
+
+		glm::ivec3 local = cell - sectionPos * CHUNK_SIZE;
+		BlockId id = section->get(local.x, local.y, local.z);
+		if (!isOpaque(id)) {
+			return true;
+		}
+		batch.hit[lane] = true;
+		batch.hitId[lane] = id;
+		batch.hitBlock[lane] = cell;
+		batch.hitNormal[lane] = glm::ivec3(0);
+		if (s.axis[lane] >= 0) {
+			batch.hitNormal[lane][s.axis[lane]] = -s.step[s.axis[lane]][lane];
+		}
+		batch.hitDistance[lane] = s.t[lane];
+		return false;
+	}
+}
+
+void VoxelRaycaster::trace(Batch& batch, int count) const {
+	uint32_t active = 0;
+	for (int lane = 0; lane < count; lane++) {
+		if (visit(batch, lane)) {
+			active |= 1u << lane;
+		}
+	}
+	while (active != 0) {
+		advance<Lanes>(batch.dda);
+		for (uint32_t pending = active; pending != 0; pending &= pending - 1) {
+			int lane = std::countr_zero(pending);
+			if (!visit(batch, lane)) {
+				active &= ~(1u << lane);
+			}
+		}
+	}
+}
+
+std::optional<RayHit> VoxelRaycaster::cast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	float length = glm::length(direction);
+	if (!(length > 0.0f)) {
+		return std::nullopt;
+	}
+	Batch batch;
+	// The unused lanes still take part in each step; give them a harmless ray.
+	for (int lane = 0; lane < RAY_BATCH; lane++) {
+		start(batch.dda, lane, origin, direction / length);
+		batch.tEnd[lane] = maxDistance;
+	}
+	trace(batch, 1);
+	if (!batch.hit[0]) {
+		return std::nullopt;
+	}
+	return RayHit{ batch.hitBlock[0], batch.hitNormal[0], batch.hitDistance[0], batch.hitId[0] };
+}
+
+void VoxelRaycaster::lineOfSight(const SightLine* lines, bool* visible, int count) const {
+	for (int first = 0; first < count; first += RAY_BATCH) {
+		Batch batch;
+		batch.lineOfSight = true;
+		// Lines within one block are always clear; they are packed out of the batch.
+		int lanes = 0;
+		int lineOfLane[RAY_BATCH];
+		for (int i = first; i < count && i < first + RAY_BATCH; i++) {
+			glm::vec3 delta = lines[i].to - lines[i].from;
+			float length = glm::length(delta);
+			glm::ivec3 last(glm::floor(lines[i].to));
+			visible[i] = true;
+			if (glm::ivec3(glm::floor(lines[i].from)) == last || !(length > 0.0f)) {
+				continue;
+			}
+			start(batch.dda, lanes, lines[i].from, delta / length);
+			batch.tEnd[lanes] = length;
+			batch.last[lanes] = last;
+			lineOfLane[lanes++] = i;
+		}
+		for (int lane = lanes; lane < RAY_BATCH; lane++) {
+			start(batch.dda, lane, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		trace(batch, lanes);
+		for (int lane = 0; lane < lanes; lane++) {
+			visible[lineOfLane[lane]] = !batch.hit[lane];
+		}
+	}
+}
@@ -0,0 +1,1076 @@
+#include "World.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <tuple>
+
+const glm::vec3 World::ORIGIN = glm::vec3(-0.5f, -1.5f - GROUND_LEVEL, -0.5f);
+
+namespace {
+	// Keep only a couple of jobs per worker queued, so priorities are re-evaluated as the
+	// player moves instead of being locked in by a long backlog.
+	constexpr size_t JOBS_PER_WORKER = 2;
+	// Bytes of mesh data uploaded per frame; at least one section is always uploaded.
+	constexpr size_t UPLOAD_BUDGET_BYTES = 2 * 1024 * 1024;
+	// How often edited chunks that are still loaded are saved.
+	constexpr auto AUTOSAVE_INTERVAL = std::chrono::seconds(30);
+
+	int floorDiv(int value, int divisor) {
+		return (value >= 0 ? value : value - divisor + 1) / divisor;
+	}
+
+	int distanceSquared(ChunkPos a, ChunkPos b) {
+		int dx = a.x - b.x, dz = a.z - b.z;
+		return dx * dx + dz * dz;
+	}
+
+	constexpr auto TICK_INTERVAL = std::chrono::microseconds(1000000 / TICKS_PER_SECOND);
+	// After a stall, the world skips ahead instead of running more ticks than this at once.
+	constexpr int MAX_TICKS_PER_UPDATE = 4;
+	constexpr int RANDOM_TICKS_PER_SECTION = 3;
+	// Ticks with more updates than this are split into jobs.
+	constexpr size_t PARALLEL_TICK_UPDATES = 256;
+
+	// The blocks whose next water state can depend on a block: itself, its neighbors, and
+	// the blocks beside the one above it, whose water spreads only while it is supported.
+	const glm::ivec3 TICK_REACH[11] = {
+		{ 0, 0, 0 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 1, 1, 0 }, { -1, 1, 0 }, { 0, 1, 1 }, { 0, 1, -1 },
+	};
+
+	/**
+	 * @brief The slices of a large tick, claimed one at a time by the ticking thread and by
+	 * helper jobs on the shared pool. The ticking thread only waits for slices that were
+	 * claimed; helpers that start after every slice is claimed find nothing left and only
+	 * touch this state, which they share, so the tick never waits behind other jobs.
+	 */
+	struct TickSlices {
+		// Slice i covers updates bounds[i] up to bounds[i + 1].
+		std::vector<size_t> bounds;
+		std::function<void(size_t, size_t)> update;
+		std::atomic<size_t> next{ 0 };
+		size_t finished = 0;
+		std::mutex mutex;
+		std::condition_variable sliceFinished;
+
+		size_t count() const { return bounds.size() - 1; }
+
+		// Runs slices until none are left to claim.
+		void run() {
+			for (size_t slice = next++; slice < count(); slice = next++) {
+				update(bounds[slice], bounds[slice + 1]);
+				std::lock_guard<std::mutex> lock(mutex);
+				finished++;
+				sliceFinished.notify_all();
+			}
+		}
+	};
+
+	// The step to the neighboring section through each face, in SectionConnectivity's order.
+	const glm::ivec3 FACE_STEPS[6] = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+	};
+}
+
+World::World(ShaderProgram program, TextureArray blockTextures, int renderRadius, uint32_t seed,
+	const std::filesystem::path& saveDirectory)
+	: m_program(program), m_blockTextures(blockTextures), m_terrain(seed), m_storage(saveDirectory), m_lastAutosave(Clock::now()),
+	m_renderRadius(renderRadius), m_center{ 0, 0 }, m_nextToken(1),
+	m_raycaster([this](const glm::ivec3& section) -> const ChunkSection* {
+		auto slot = m_chunks.find(ChunkPos{ section.x, section.z });
+		if (slot == m_chunks.end() || slot->second.state != ChunkState::Generated) {
+			return nullptr;
+		}
+		return slot->second.chunk->section(section.y).get();
+	}),
+	m_tick(0), m_lastTick(Clock::now()), m_random(seed * 2654435761u | 1u),
+	m_lightAccess(*this), m_lighting(m_lightAccess),
+	m_jobsInFlight(0), m_shuttingDown(false), m_finishedJobs(0), m_renderFrame(0), m_drawnSections(0), m_meshedSections(0),
+	m_drawnLodSections(0),
+	m_lastReport(Clock::now()), m_latencySum(0),
+	m_latencyMax(0), m_latencyCount(0) {
+}
+
+World::~World() {
+	// Jobs still hold a pointer to this world; let the queued ones skip their work, and wait
+	// for the running ones to finish.
+	m_shuttingDown = true;
+	{
+		std::unique_lock<std::mutex> lock(m_idleMutex);
+		m_idle.wait(lock, [this]() { return m_jobsInFlight == 0; });
+	}
+	// Queue the final save; m_storage writes it before it is destroyed.
+	for (auto& [pos, slot] : m_chunks) {
+		if (slot.modified) {
+			m_storage.save(slot.chunk->snapshot());
+		}
+	}
+}
+
+template <typename F>
+void World::submitJob(float priority, F&& job) {
+	m_jobsInFlight++;
+	ThreadPool::shared().submit(priority, [this, job = std::forward<F>(job)]() mutable {
+		if (!m_shuttingDown) {
+			job();
+		}
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_jobsInFlight--;
+		m_finishedJobs++;
+		m_idle.notify_all();
+	});
+}
+
+void World::waitForJob() {
+	std::unique_lock<std::mutex> lock(m_idleMutex);
+	uint64_t finished = m_finishedJobs;
+	m_idle.wait(lock, [&]() { return m_jobsInFlight == 0 || m_finishedJobs != finished; });
+}
+
+glm::ivec3 World::toBlock(const glm::vec3& worldPos) {
+	return glm::ivec3(glm::floor(worldPos - ORIGIN));
+}
+
+ChunkPos World::toChunk(const glm::ivec3& block) {
+	return ChunkPos{ floorDiv(block.x, CHUNK_SIZE), floorDiv(block.z, CHUNK_SIZE) };
+}
+
+BlockId World::getBlock(const glm::ivec3& block) const {
+	auto slot = m_chunks.find(toChunk(block));
+	if (slot == m_chunks.end() || slot->second.state != ChunkState::Generated) {
+		return Blocks::AIR;
+	}
+	return slot->second.chunk->getBlock(block.x - slot->first.x * CHUNK_SIZE, block.y,
+		block.z - slot->first.z * CHUNK_SIZE);
+}
+
+void World::setBlock(const glm::ivec3& block, BlockId id) {
+	ChunkPos pos = toChunk(block);
+	auto slot = m_chunks.find(pos);
+	if (slot == m_chunks.end() || slot->second.state != ChunkState::Generated
+		|| block.y < 0 || block.y >= CHUNK_HEIGHT) {
+		return;
+	}
+	glm::ivec3 local(block.x - pos.x * CHUNK_SIZE, block.y, block.z - pos.z * CHUNK_SIZE);
+	if (slot->second.chunk->getBlock(local.x, local.y, local.z) == id) {
+		return;
+	}
+	BlockId old = slot->second.chunk->getBlock(local.x, local.y, local.z);
+	slot->second.chunk->setBlock(local.x, local.y, local.z, id);
+	slot->second.modified = true;
+	m_lighting.blockChanged(block);
+	markDirty(block);
+
+	bool water = isWater(old) || isWater(id);
+	for (auto& offset : TICK_REACH) {
+		water = water || isWater(getBlock(block + offset));
+	}
+	if (water) {
+		scheduleAround(block, m_tick + FLOW_DELAY);
+	}
+}
+
+void World::scheduleAround(const glm::ivec3& block, uint64_t due) {
+	for (auto& offset : TICK_REACH) {
+		m_ticks.schedule(block + offset, due);
+	}
+}
+
+void World::markDirty(const glm::ivec3& block) {
+	// Every section whose mesh reads this block: its own, plus the neighbors it borders
+	// on (including diagonally), since meshing looks one block past the section.
+	ChunkPos pos = toChunk(block);
+	glm::ivec3 inSection(block.x - pos.x * CHUNK_SIZE, block.y % CHUNK_SIZE, block.z - pos.z * CHUNK_SIZE);
+	int sectionY = block.y / CHUNK_SIZE;
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				glm::ivec3 d(dx, dy, dz);
+				bool touches = true;
+				for (int axis = 0; axis < 3; axis++) {
+					touches = touches && (d[axis] == 0 || (d[axis] < 0 ? inSection[axis] == 0
+						: inSection[axis] == CHUNK_SIZE - 1));
+				}
+				if (touches && sectionY + dy >= 0 && sectionY + dy < SECTION_COUNT) {
+					m_dirty.insert(SectionKey{ ChunkPos{ pos.x + dx, pos.z + dz }, sectionY + dy });
+				}
+			}
+		}
+	}
+}
+
+void World::relight() {
+	m_lighting.propagate();
+	for (auto& block : m_lighting.changed()) {
+		markDirty(block);
+	}
+	m_lighting.clearChanged();
+}
+
+void World::lightSeams(ChunkPos pos) {
+	const Chunk& chunk = *m_chunks.at(pos).chunk;
+	const glm::ivec2 sides[4] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+	for (auto& side : sides) {
+		auto neighborSlot = m_chunks.find(ChunkPos{ pos.x + side.x, pos.z + side.y });
+		if (neighborSlot == m_chunks.end() || neighborSlot->second.state != ChunkState::Generated) {
+			continue;
+		}
+		const Chunk& neighbor = *neighborSlot->second.chunk;
+		glm::ivec3 origin(pos.x * CHUNK_SIZE, 0, pos.z * CHUNK_SIZE);
+		glm::ivec3 neighborOrigin = origin + glm::ivec3(side.x, 0, side.y) * CHUNK_SIZE;
+		for (int i = 0; i < CHUNK_SIZE; i++) {
+			// The facing columns: along x or z depending on the side.
+			glm::ivec3 a = side.x != 0 ? glm::ivec3(side.x > 0 ? CHUNK_SIZE - 1 : 0, 0, i)
+				: glm::ivec3(i, 0, side.y > 0 ? CHUNK_SIZE - 1 : 0);
+			glm::ivec3 b = side.x != 0 ? glm::ivec3(CHUNK_SIZE - 1 - a.x, 0, i) : glm::ivec3(i, 0, CHUNK_SIZE - 1 - a.z);
+			for (int y = 0; y < CHUNK_HEIGHT; y++) {
+				uint8_t lightA = chunk.getLight(a.x, y, a.z), lightB = neighbor.getLight(b.x, y, b.z);
+				// Only the brighter side of a pair can spread, and only if it is brighter by more
+				// than the one level lost per block.
+				if (skyLight(lightA) > skyLight(lightB) + 1 || blockLight(lightA) > blockLight(lightB) + 1) {
+					m_lighting.addSource(origin + glm::ivec3(a.x, y, a.z));
+				}
+				if (skyLight(lightB) > skyLight(lightA) + 1 || blockLight(lightB) > blockLight(lightA) + 1) {
+					m_lighting.addSource(neighborOrigin + glm::ivec3(b.x, y, b.z));
+				}
+			}
+		}
+	}
+}
+
+Chunk* World::WorldLightAccess::chunkAt(const glm::ivec3& block) const {
+	auto slot = m_world.m_chunks.find(toChunk(block));
+	if (slot == m_world.m_chunks.end() || slot->second.state != ChunkState::Generated) {
+		return nullptr;
+	}
+	return slot->second.chunk.get();
+}
+
+bool World::WorldLightAccess::loaded(const glm::ivec3& block) const {
+	return block.y >= 0 && block.y < CHUNK_HEIGHT && chunkAt(block) != nullptr;
+}
+
+BlockId World::WorldLightAccess::getBlock(const glm::ivec3& block) const {
+	Chunk* chunk = chunkAt(block);
+	glm::ivec3 origin(chunk->getPos().x * CHUNK_SIZE, 0, chunk->getPos().z * CHUNK_SIZE);
+	return chunk->getBlock(block.x - origin.x, block.y, block.z - origin.z);
+}
+
+uint8_t World::WorldLightAccess::getLight(const glm::ivec3& block) const {
+	Chunk* chunk = chunkAt(block);
+	glm::ivec3 origin(chunk->getPos().x * CHUNK_SIZE, 0, chunk->getPos().z * CHUNK_SIZE);
+	return chunk->getLight(block.x - origin.x, block.y, block.z - origin.z);
+}
+
+void World::WorldLightAccess::setLight(const glm::ivec3& block, uint8_t light) {
+	Chunk* chunk = chunkAt(block);
+	glm::ivec3 origin(chunk->getPos().x * CHUNK_SIZE, 0, chunk->getPos().z * CHUNK_SIZE);
+	chunk->setLight(block.x - origin.x, block.y, block.z - origin.z, light);
+}
+
+std::optional<RayHit> World::pickBlock(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+	return m_raycaster.cast(origin - ORIGIN, direction, maxDistance);
+}
+
+std::vector<bool> World::lineOfSight(const std::vector<SightLine>& lines) const {
+	std::vector<SightLine> blockLines(lines.size());
+	for (size_t i = 0; i < lines.size(); i++) {
+		blockLines[i] = SightLine{ lines[i].from - ORIGIN, lines[i].to - ORIGIN };
+	}
+	auto visible = std::make_unique<bool[]>(lines.size());
+	m_raycaster.lineOfSight(blockLines.data(), visible.get(), static_cast<int>(lines.size()));
+	return std::vector<bool>(visible.get(), visible.get() + lines.size());
+}
+
+void World::explode(const glm::vec3& center, float radius) {
+	glm::ivec3 low = toBlock(center - glm::vec3(radius));
+	glm::ivec3 high = toBlock(center + glm::vec3(radius));
+	for (int y = low.y; y <= high.y; y++) {
+		for (int z = low.z; z <= high.z; z++) {
+			for (int x = low.x; x <= high.x; x++) {
+				glm::vec3 blockCenter = ORIGIN + glm::vec3(x, y, z) + glm::vec3(0.5f);
+				if (glm::length(blockCenter - center) <= radius) {
+					setBlock(glm::ivec3(x, y, z), Blocks::AIR);
+				}
+			}
+		}
+	}
+}
+
+float World::priority(ChunkPos pos, const glm::vec3& playerPos, const glm::vec3& viewDir) const {
+	glm::vec3 chunkCenter = ORIGIN + glm::vec3((pos.x + 0.5f) * CHUNK_SIZE, 0, (pos.z + 0.5f) * CHUNK_SIZE);
+	glm::vec3 toChunk = glm::vec3(chunkCenter.x - playerPos.x, 0, chunkCenter.z - playerPos.z);
+	float distance = glm::length(toChunk) / CHUNK_SIZE;
+	glm::vec3 forward = glm::vec3(viewDir.x, 0, viewDir.z);
+	if (distance < 1.0f || glm::length(forward) < 1e-4f) {
+		return distance;
+	}
+	// Chunks straight ahead count at their distance, chunks behind the player at twice it.
+	float facing = glm::dot(toChunk / (distance * CHUNK_SIZE), glm::normalize(forward));
+	return distance * (1.5f - 0.5f * facing);
+}
+
+void World::update(const glm::vec3& playerPos, const glm::vec3& viewDir) {
+	m_center = toChunk(toBlock(playerPos));
+	collectResults();
+	runTicks();
+	relight();
+	evictChunks();
+	requestChunks();
+	scheduleRemeshing();
+	scheduleMeshing(playerPos, viewDir);
+	scheduleGeneration(playerPos, viewDir);
+	uploadMeshes();
+	selectDetail();
+	scheduleLod(playerPos, viewDir);
+	autosave();
+	report();
+}
+
+void World::collectResults() {
+	std::vector<GeneratedChunk> generated;
+	{
+		std::lock_guard<std::mutex> lock(m_resultsMutex);
+		generated.swap(m_generated);
+		for (auto& meshed : m_meshed) {
+			auto slot = m_chunks.find(meshed.pos);
+			if (slot == m_chunks.end() || slot->second.token != meshed.token) {
+				continue;
+			}
+			// Edits go first, so the player sees them on the next frame.
+			if (meshed.edit) {
+				slot->second.remeshing[meshed.sectionY] = false;
+				m_uploads.push_front(std::move(meshed));
+			}
+			else {
+				m_uploads.push_back(std::move(meshed));
+			}
+		}
+		m_meshed.clear();
+		for (auto& built : m_builtLod) {
+			m_lodUploads.push_back(std::move(built));
+		}
+		m_builtLod.clear();
+	}
+	for (auto& result : generated) {
+		auto slot = m_chunks.find(result.chunk->getPos());
+		if (slot != m_chunks.end() && slot->second.token == result.token) {
+			slot->second.chunk = std::move(result.chunk);
+			slot->second.state = ChunkState::Generated;
+			lightSeams(slot->first);
+			m_ticks.release(slot->first, m_tick + 1);
+		}
+	}
+}
+
+void World::runTicks() {
+	auto now = Clock::now();
+	for (int ticks = 0; now - m_lastTick >= TICK_INTERVAL; ticks++) {
+		if (ticks == MAX_TICKS_PER_UPDATE) {
+			m_lastTick = now;
+			break;
+		}
+		m_lastTick += TICK_INTERVAL;
+		tick();
+	}
+}
+
+void World::tick() {
+	m_tick++;
+	randomTicks();
+
+	// Updates in chunks that are still being generated wait for them; those in evicted
+	// chunks are dropped.
+	std::vector<glm::ivec3> ready;
+	for (auto& block : m_ticks.takeDue(m_tick)) {
+		auto slot = m_chunks.find(toChunk(block));
+		if (slot == m_chunks.end() || block.y < 0 || block.y >= CHUNK_HEIGHT) {
+			continue;
+		}
+		if (slot->second.state != ChunkState::Generated) {
+			m_ticks.park(block);
+			continue;
+		}
+		ready.push_back(block);
+	}
+	if (ready.empty()) {
+		return;
+	}
+
+	// Every update reads the world as it was before the tick and the changes are applied
+	// afterwards, so updates are independent of each other. Large ticks are split into
+	// jobs of whole chunks, which keeps each job's reads local.
+	std::sort(ready.begin(), ready.end(), [](const glm::ivec3& a, const glm::ivec3& b) {
+		ChunkPos chunkA = toChunk(a), chunkB = toChunk(b);
+		return chunkA.x != chunkB.x ? chunkA.x < chunkB.x : chunkA.z < chunkB.z;
+	});
+	std::vector<BlockId> next(ready.size());
+	auto update = [this, &ready, &next](size_t begin, size_t end) {
+		auto blockAt = [this](const glm::ivec3& block) { return getBlock(block); };
+		for (size_t i = begin; i < end; i++) {
+			next[i] = flowWater(ready[i], blockAt);
+		}
+	};
+	if (ready.size() < PARALLEL_TICK_UPDATES) {
+		update(0, ready.size());
+	}
+	else {
+		size_t parts = ThreadPool::shared().threadCount() + 1;
+		size_t partSize = (ready.size() + parts - 1) / parts;
+		auto slices = std::make_shared<TickSlices>();
+		slices->update = update;
+		slices->bounds.push_back(0);
+		while (slices->bounds.back() < ready.size()) {
+			size_t end = std::min(slices->bounds.back() + partSize, ready.size());
+			while (end < ready.size() && toChunk(ready[end]) == toChunk(ready[end - 1])) {
+				end++;
+			}
+			slices->bounds.push_back(end);
+		}
+		// Ahead of generation and meshing, though this thread does not depend on them running.
+		for (size_t i = 1; i < slices->count(); i++) {
+			ThreadPool::shared().submit(-1.0f, [slices]() { slices->run(); });
+		}
+		slices->run();
+		std::unique_lock<std::mutex> lock(slices->mutex);
+		slices->sliceFinished.wait(lock, [&]() { return slices->finished == slices->count(); });
+	}
+
+	for (size_t i = 0; i < ready.size(); i++) {
+		setBlock(ready[i], next[i]);
+	}
+}
+
+void World::randomTicks() {
+	// A few random blocks of every section with water wake their surroundings, so water
+	// that stopped mid-flow (scheduled updates are not saved) settles eventually.
+	for (auto& [pos, slot] : m_chunks) {
+		if (slot.state != ChunkState::Generated) {
+			continue;
+		}
+		for (int sectionY = 0; sectionY < SECTION_COUNT; sectionY++) {
+			const ChunkSection* section = slot.chunk->section(sectionY).get();
+			if (section == nullptr || !section->mayContain(isWater)) {
+				continue;
+			}
+			for (int i = 0; i < RANDOM_TICKS_PER_SECTION; i++) {
+				// xorshift32
+				m_random ^= m_random << 13;
+				m_random ^= m_random >> 17;
+				m_random ^= m_random << 5;
+				glm::ivec3 local(m_random & 15, (m_random >> 4) & 15, (m_random >> 8) & 15);
+				if (isWater(section->get(local.x, local.y, local.z))) {
+					scheduleAround(glm::ivec3(pos.x * CHUNK_SIZE, sectionY * CHUNK_SIZE, pos.z * CHUNK_SIZE) + local, m_tick + 1);
+				}
+			}
+		}
+	}
+}
+
+void World::evictChunks() {
+	// Evict a little beyond the generation radius, so chunks on the edge do not thrash as
+	// the player walks back and forth.
+	int evictRadius = m_renderRadius + 2;
+	for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+		if (distanceSquared(it->first, m_center) > evictRadius * evictRadius) {
+			if (it->second.modified) {
+				m_storage.save(it->second.chunk->snapshot());
+			}
+			m_ticks.drop(it->first);
+			it = m_chunks.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void World::requestChunks() {
+	// Generate one ring beyond the render radius, so every drawn chunk has neighbors to
+	// mesh its borders against.
+	int generateRadius = m_renderRadius + 1;
+	for (int dz = -generateRadius; dz <= generateRadius; dz++) {
+		for (int dx = -generateRadius; dx <= generateRadius; dx++) {
+			if (dx * dx + dz * dz > generateRadius * generateRadius) {
+				continue;
+			}
+			ChunkPos pos{ m_center.x + dx, m_center.z + dz };
+			if (m_chunks.find(pos) == m_chunks.end()) {
+				ChunkSlot& slot = m_chunks[pos];
+				slot.token = m_nextToken++;
+				slot.requestedAt = Clock::now();
+			}
+		}
+	}
+}
+
+void World::scheduleGeneration(const glm::vec3& playerPos, const glm::vec3& viewDir) {
+	size_t maxInFlight = ThreadPool::shared().threadCount() * JOBS_PER_WORKER;
+	if (static_cast<size_t>(m_jobsInFlight) >= maxInFlight) {
+		return;
+	}
+
+	std::vector<std::pair<float, ChunkPos>> queued;
+	for (auto& [pos, slot] : m_chunks) {
+		if (slot.state == ChunkState::Queued) {
+			queued.emplace_back(priority(pos, playerPos, viewDir), pos);
+		}
+	}
+	size_t count = std::min(queued.size(), maxInFlight - m_jobsInFlight);
+	std::partial_sort(queued.begin(), queued.begin() + count, queued.end(),
+		[](auto& a, auto& b) { return a.first < b.first; });
+
+	for (size_t i = 0; i < count; i++) {
+		auto [jobPriority, pos] = queued[i];
+		ChunkSlot& slot = m_chunks[pos];
+		slot.state = ChunkState::Generating;
+		uint64_t token = slot.token;
+		submitJob(jobPriority, [this, pos, token]() {
+			// Chunks that were edited and saved load from disk; the rest are generated.
+			auto chunk = m_storage.load(pos);
+			if (!chunk) {
+				chunk = std::make_unique<Chunk>(pos);
+				m_terrain.generate(*chunk);
+			}
+			// Light is not saved; it only depends on the blocks.
+			LightPropagator::lightChunk(*chunk);
+			std::lock_guard<std::mutex> lock(m_resultsMutex);
+			m_generated.push_back(GeneratedChunk{ token, std::move(chunk) });
+		});
+	}
+}
+
+void World::scheduleMeshing(const glm::vec3& playerPos, const glm::vec3& viewDir) {
+	size_t maxInFlight = ThreadPool::shared().threadCount() * JOBS_PER_WORKER;
+
+	// Chunks in range whose neighbors are all generated are ready to mesh.
+	std::vector<std::pair<float, ChunkPos>> ready;
+	for (auto& [pos, slot] : m_chunks) {
+		if (slot.state == ChunkState::Generated && !slot.meshing
+			&& distanceSquared(pos, m_center) <= m_renderRadius * m_renderRadius && neighborsGenerated(pos)) {
+			ready.emplace_back(priority(pos, playerPos, viewDir), pos);
+		}
+	}
+	std::sort(ready.begin(), ready.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+	for (auto& [jobPriority, pos] : ready) {
+		if (static_cast<size_t>(m_jobsInFlight) >= maxInFlight) {
+			break;
+		}
+		ChunkSlot& slot = m_chunks[pos];
+		std::vector<std::tuple<int, uint32_t, SectionNeighborhood>> sections;
+		for (int sy = 0; sy < SECTION_COUNT; sy++) {
+			if (slot.chunk->section(sy) != nullptr) {
+				sections.emplace_back(sy, ++slot.meshRevision[sy], neighborhood(pos, sy));
+			}
+		}
+		slot.meshing = true;
+		slot.pendingSections = static_cast<int>(sections.size());
+		if (sections.empty()) {
+			continue;
+		}
+		uint64_t token = slot.token;
+		submitJob(jobPriority, [this, pos, token, sections = std::move(sections)]() {
+			std::vector<MeshedSection> meshed;
+			for (auto& [sy, revision, neighbors] : sections) {
+				meshed.push_back(MeshedSection{ pos, token, sy, revision, false, meshSection(neighbors),
+					SectionConnectivity::compute(neighbors.at(0, 0, 0)) });
+			}
+			std::lock_guard<std::mutex> lock(m_resultsMutex);
+			for (auto& section : meshed) {
+				m_meshed.push_back(std::move(section));
+			}
+		});
+	}
+}
+
+void World::autosave() {
+	auto now = Clock::now();
+	if (now - m_lastAutosave < AUTOSAVE_INTERVAL) {
+		return;
+	}
+	m_lastAutosave = now;
+	// Snapshots only copy section references; serializing and writing happen on the
+	// storage's own thread.
+	for (auto& [pos, slot] : m_chunks) {
+		if (slot.modified) {
+			m_storage.save(slot.chunk->snapshot());
+			slot.modified = false;
+		}
+	}
+}
+
+void World::scheduleRemeshing() {
+	for (auto it = m_dirty.begin(); it != m_dirty.end();) {
+		SectionKey key = *it;
+		auto slot = m_chunks.find(key.chunk);
+		// Chunks that were never meshed will see the edit when they are.
+		if (slot == m_chunks.end() || !slot->second.meshing) {
+			it = m_dirty.erase(it);
+			continue;
+		}
+		// One remesh per section at a time; later edits wait for the next update.
+		if (slot->second.remeshing[key.sectionY] || !neighborsGenerated(key.chunk)) {
+			++it;
+			continue;
+		}
+
+		ChunkSlot& chunk = slot->second;
+		chunk.remeshing[key.sectionY] = true;
+		uint32_t revision = ++chunk.meshRevision[key.sectionY];
+		uint64_t token = chunk.token;
+		// Edits run ahead of all streaming work.
+		submitJob(-1.0f, [this, key, token, revision, neighbors = neighborhood(key.chunk, key.sectionY)]() {
+			MeshedSection meshed{ key.chunk, token, key.sectionY, revision, true, meshSection(neighbors),
+				SectionConnectivity::compute(neighbors.at(0, 0, 0)) };
+			std::lock_guard<std::mutex> lock(m_resultsMutex);
+			m_meshed.push_back(std::move(meshed));
+		});
+		it = m_dirty.erase(it);
+	}
+}
+
+bool World::neighborsGenerated(ChunkPos pos) const {
+	for (int dz = -1; dz <= 1; dz++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			auto neighbor = m_chunks.find(ChunkPos{ pos.x + dx, pos.z + dz });
+			if (neighbor == m_chunks.end() || neighbor->second.state != ChunkState::Generated) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+SectionNeighborhood World::neighborhood(ChunkPos pos, int sectionY) const {
+	// The job only holds shared references to the sections, which stay valid (and
+	// unchanged, thanks to copy-on-write) even if the chunks are edited or evicted.
+	SectionNeighborhood neighbors;
+	neighbors.worldBottom = sectionY == 0;
+	for (int dz = -1; dz <= 1; dz++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			const Chunk& neighbor = *m_chunks.at(ChunkPos{ pos.x + dx, pos.z + dz }).chunk;
+			for (int dy = -1; dy <= 1; dy++) {
+				if (sectionY + dy >= 0 && sectionY + dy < SECTION_COUNT) {
+					neighbors.slot(dx, dy, dz) = neighbor.section(sectionY + dy);
+					neighbors.lightSlot(dx, dy, dz) = neighbor.lightSection(sectionY + dy);
+				}
+			}
+		}
+	}
+	return neighbors;
+}
+
+void World::uploadMeshes() {
+	size_t uploaded = 0;
+	while (!m_uploads.empty() && (uploaded == 0 || uploaded < UPLOAD_BUDGET_BYTES)) {
+		MeshedSection section = std::move(m_uploads.front());
+		m_uploads.pop_front();
+
+		auto slot = m_chunks.find(section.pos);
+		if (slot == m_chunks.end() || slot->second.token != section.token) {
+			continue;
+		}
+		ChunkSlot& chunk = slot->second;
+		// An edit may have been remeshed and uploaded while this older mesh was queued.
+		if (section.revision > chunk.uploadedRevision[section.sectionY]) {
+			chunk.uploadedRevision[section.sectionY] = section.revision;
+			chunk.meshes[section.sectionY].upload(section.data);
+			chunk.connectivity[section.sectionY] = section.connectivity;
+			uploaded += section.data.vertices.size() * sizeof(ChunkVertex) + section.data.indices.size() * sizeof(uint16_t);
+		}
+
+		if (!section.edit && chunk.pendingSections > 0 && --chunk.pendingSections == 0) {
+			double latency = std::chrono::duration<double, std::milli>(Clock::now() - chunk.requestedAt).count();
+			m_latencySum += latency;
+			m_latencyMax = std::max(m_latencyMax, latency);
+			m_latencyCount++;
+		}
+	}
+
+	// Distant terrain gets what is left of the budget.
+	while (!m_lodUploads.empty() && (uploaded == 0 || uploaded < UPLOAD_BUDGET_BYTES)) {
+		BuiltLodTile built = std::move(m_lodUploads.front());
+		m_lodUploads.pop_front();
+		auto tile = m_lodTiles.find(built.key);
+		if (tile == m_lodTiles.end() || tile->second.token != built.token) {
+			continue;
+		}
+		tile->second.meshes.resize(built.meshes.size());
+		for (size_t i = 0; i < built.meshes.size(); i++) {
+			tile->second.meshes[i].upload(built.meshes[i]);
+			uploaded += built.meshes[i].vertices.size() * sizeof(ChunkVertex) + built.meshes[i].indices.size() * sizeof(uint16_t);
+		}
+		tile->second.state = ChunkState::Generated;
+	}
+}
+
+float World::viewDistance() const {
+	return static_cast<float>((m_renderRadius << MAX_LOD_LEVEL) * CHUNK_SIZE);
+}
+
+bool World::isSettled() {
+	if (m_jobsInFlight > 0 || !m_uploads.empty() || !m_lodUploads.empty() || !m_dirty.empty()) {
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_resultsMutex);
+		if (!m_generated.empty() || !m_meshed.empty() || !m_builtLod.empty()) {
+			return false;
+		}
+	}
+	for (auto& [pos, slot] : m_chunks) {
+		if (slot.state != ChunkState::Generated) {
+			return false;
+		}
+	}
+	for (auto& [key, tile] : m_lodTiles) {
+		if (tile.wanted && tile.state != ChunkState::Generated) {
+			return false;
+		}
+	}
+	return true;
+}
+
+float World::tileDistance(LodKey key) const {
+	ChunkPos first = key.firstChunk();
+	int last = key.scale() - 1;
+	int dx = std::max({ first.x - m_center.x, 0, m_center.x - (first.x + last) });
+	int dz = std::max({ first.z - m_center.z, 0, m_center.z - (first.z + last) });
+	return std::sqrt(static_cast<float>(dx * dx + dz * dz));
+}
+
+bool World::lodReady(LodKey key) const {
+	auto tile = m_lodTiles.find(key);
+	return tile != m_lodTiles.end() && tile->second.state == ChunkState::Generated;
+}
+
+bool World::chunksReady(LodKey key) const {
+	// Only level 1 tiles split into chunks; a chunk is ready once all of its first meshes are up.
+	ChunkPos first = key.firstChunk();
+	for (int dz = 0; dz < 2; dz++) {
+		for (int dx = 0; dx < 2; dx++) {
+			auto slot = m_chunks.find(ChunkPos{ first.x + dx, first.z + dz });
+			if (slot == m_chunks.end() || !slot->second.meshing || slot->second.pendingSections > 0) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool World::canCover(LodKey key) const {
+	if (lodReady(key)) {
+		return true;
+	}
+	if (key.level == 1) {
+		return chunksReady(key);
+	}
+	for (int dz = 0; dz < 2; dz++) {
+		for (int dx = 0; dx < 2; dx++) {
+			if (!canCover(key.child(dx, dz))) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void World::requestTile(LodKey key) {
+	LodSlot& tile = m_lodTiles[key];
+	if (tile.token == 0) {
+		tile.token = m_nextToken++;
+	}
+	tile.wanted = true;
+}
+
+void World::coverTile(LodKey key, bool draw) {
+	auto tile = m_lodTiles.find(key);
+	if (tile != m_lodTiles.end()) {
+		tile->second.wanted = true;
+		if (tile->second.state == ChunkState::Generated) {
+			if (draw) {
+				m_lodDraw.push_back(key);
+			}
+			return;
+		}
+	}
+	if (key.level == 1) {
+		if (!draw) {
+			return;
+		}
+		ChunkPos first = key.firstChunk();
+		for (int dz = 0; dz < 2; dz++) {
+			for (int dx = 0; dx < 2; dx++) {
+				auto slot = m_chunks.find(ChunkPos{ first.x + dx, first.z + dz });
+				if (slot != m_chunks.end() && slot->second.meshing && slot->second.pendingSections == 0) {
+					slot->second.fullResolution = true;
+				}
+			}
+		}
+		return;
+	}
+	for (int dz = 0; dz < 2; dz++) {
+		for (int dx = 0; dx < 2; dx++) {
+			coverTile(key.child(dx, dz), draw);
+		}
+	}
+}
+
+void World::selectTile(LodKey key) {
+	// Level 1 tiles give way to chunks wherever chunks are meshed; coarser tiles split
+	// within twice the reach of the level below them.
+	bool near = key.level == 1 || tileDistance(key) <= static_cast<float>(m_renderRadius << (key.level - 1));
+	if (near) {
+		bool ready = key.level == 1 ? chunksReady(key) : true;
+		for (int dz = 0; dz < 2 && key.level > 1; dz++) {
+			for (int dx = 0; dx < 2; dx++) {
+				ready = ready && canCover(key.child(dx, dz));
+			}
+		}
+		if (ready) {
+			for (int dz = 0; dz < 2; dz++) {
+				for (int dx = 0; dx < 2; dx++) {
+					if (key.level == 1) {
+						m_chunks.at(ChunkPos{ key.firstChunk().x + dx, key.firstChunk().z + dz }).fullResolution = true;
+					}
+					else {
+						selectTile(key.child(dx, dz));
+					}
+				}
+			}
+			return;
+		}
+		// Until the finer detail is complete, this tile stands in for it. What is already
+		// there is kept, and the rest requested.
+		for (int dz = 0; dz < 2 && key.level > 1; dz++) {
+			for (int dx = 0; dx < 2; dx++) {
+				LodKey child = key.child(dx, dz);
+				if (!canCover(child)) {
+					requestTile(child);
+				}
+				coverTile(child, false);
+			}
+		}
+	}
+	requestTile(key);
+	coverTile(key, true);
+}
+
+void World::selectDetail() {
+	for (auto& [pos, slot] : m_chunks) {
+		slot.fullResolution = false;
+	}
+	for (auto& [key, tile] : m_lodTiles) {
+		tile.wanted = false;
+	}
+	m_lodDraw.clear();
+
+	int reach = m_renderRadius << MAX_LOD_LEVEL;
+	int size = 1 << MAX_LOD_LEVEL;
+	for (int z = floorDiv(m_center.z - reach, size); z <= floorDiv(m_center.z + reach, size); z++) {
+		for (int x = floorDiv(m_center.x - reach, size); x <= floorDiv(m_center.x + reach, size); x++) {
+			LodKey key{ MAX_LOD_LEVEL, x, z };
+			if (tileDistance(key) <= reach) {
+				selectTile(key);
+			}
+		}
+	}
+
+	for (auto it = m_lodTiles.begin(); it != m_lodTiles.end();) {
+		it = it->second.wanted ? std::next(it) : m_lodTiles.erase(it);
+	}
+}
+
+void World::scheduleLod(const glm::vec3& playerPos, const glm::vec3& viewDir) {
+	size_t maxInFlight = ThreadPool::shared().threadCount() * JOBS_PER_WORKER;
+	if (static_cast<size_t>(m_jobsInFlight) >= maxInFlight) {
+		return;
+	}
+
+	std::vector<std::pair<float, LodKey>> queued;
+	for (auto& [key, tile] : m_lodTiles) {
+		if (tile.state == ChunkState::Queued) {
+			ChunkPos center{ key.firstChunk().x + key.scale() / 2, key.firstChunk().z + key.scale() / 2 };
+			queued.emplace_back(priority(center, playerPos, viewDir), key);
+		}
+	}
+	size_t count = std::min(queued.size(), maxInFlight - m_jobsInFlight);
+	std::partial_sort(queued.begin(), queued.begin() + count, queued.end(),
+		[](auto& a, auto& b) { return a.first < b.first; });
+
+	for (size_t i = 0; i < count; i++) {
+		auto [jobPriority, key] = queued[i];
+		LodSlot& tile = m_lodTiles[key];
+		tile.state = ChunkState::Generating;
+		submitJob(jobPriority, [this, key, token = tile.token]() {
+			BuiltLodTile built{ key, token, buildLodTile(m_terrain, key) };
+			std::lock_guard<std::mutex> lock(m_resultsMutex);
+			m_builtLod.push_back(std::move(built));
+		});
+	}
+}
+
+void World::report() {
+	auto now = Clock::now();
+	if (now - m_lastReport < std::chrono::seconds(1)) {
+		return;
+	}
+	m_lastReport = now;
+
+	size_t queued = 0, blockBytes = 0, sections = 0;
+	for (auto& [pos, slot] : m_chunks) {
+		queued += slot.state == ChunkState::Queued;
+		if (slot.chunk) {
+			blockBytes += slot.chunk->memoryUsage();
+			for (int sy = 0; sy < SECTION_COUNT; sy++) {
+				sections += slot.chunk->section(sy) != nullptr;
+			}
+		}
+	}
+	// Compared with a plain array of BlockIds per allocated section.
+	size_t unpackedBytes = sections * SECTION_VOLUME * sizeof(BlockId);
+	std::cout << "World: " << m_chunks.size() << " chunks, " << queued << " queued, "
+		<< "blocks " << blockBytes / 1024 << " KiB (" << unpackedBytes / 1024 << " KiB unpacked), "
+		<< m_jobsInFlight << " jobs in flight (" << ThreadPool::shared().queuedCount() << " waiting), "
+		<< m_uploads.size() << " uploads pending, drew " << m_drawnSections << " of " << m_meshedSections
+		<< " meshed sections and " << m_drawnLodSections << " distant sections of " << m_lodTiles.size() << " tiles, "
+		<< m_ticks.scheduledCount() << " block updates scheduled (" << m_ticks.parkedCount() << " parked)";
+	if (m_latencyCount > 0) {
+		std::cout << ", load latency avg " << m_latencySum / m_latencyCount << " ms, max " << m_latencyMax
+			<< " ms over " << m_latencyCount << " chunks";
+	}
+	std::cout << std::endl;
+	m_latencySum = m_latencyMax = 0;
+	m_latencyCount = 0;
+}
+
+void World::render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& skyColor) {
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	m_program.activate();
+	m_program.setUniform("view", view);
+	m_program.setUniform("projection", projection);
+	m_program.setUniform("skyColor", skyColor);
+
+	int32_t unit = m_program.samplerUnit(m_blockTextures.sampler);
+	if (unit >= 0) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_blockTextures.textureId);
+	}
+	m_renderFrame++;
+	m_drawnSections = 0;
+	m_meshedSections = 0;
+	m_drawnLodSections = 0;
+	for (auto& [pos, slot] : m_chunks) {
+		for (auto& mesh : slot.meshes) {
+			m_meshedSections += !mesh.empty();
+		}
+	}
+
+	Frustum frustum(projection * view);
+	auto inFrustum = [&](ChunkPos pos, int sectionY) {
+		glm::vec3 min = ORIGIN + glm::vec3(pos.x * CHUNK_SIZE, sectionY * CHUNK_SIZE, pos.z * CHUNK_SIZE);
+		return frustum.intersects(min, min + glm::vec3(CHUNK_SIZE));
+	};
+	auto draw = [&](ChunkPos pos, int sectionY, const ChunkSlot& slot) {
+		const ChunkMesh& mesh = slot.meshes[sectionY];
+		// Chunks covered by distant terrain are walked through, but not drawn.
+		if (mesh.empty() || !slot.fullResolution) {
+			return;
+		}
+		glm::vec3 sectionOrigin = ORIGIN + glm::vec3(pos.x * CHUNK_SIZE, sectionY * CHUNK_SIZE, pos.z * CHUNK_SIZE);
+		m_program.setUniform("model", glm::translate(glm::mat4(1), sectionOrigin));
+		mesh.render();
+		m_drawnSections++;
+	};
+
+	glm::vec3 cameraPos = glm::vec3(glm::inverse(view)[3]);
+	glm::ivec3 cameraBlock = toBlock(cameraPos);
+	ChunkPos cameraChunk = toChunk(cameraBlock);
+	auto start = m_chunks.find(cameraChunk);
+	if (start == m_chunks.end() || start->second.state != ChunkState::Generated) {
+		// Nothing to walk from; fall back to frustum culling alone.
+		for (auto& [pos, slot] : m_chunks) {
+			for (int sy = 0; sy < SECTION_COUNT; sy++) {
+				if (inFrustum(pos, sy)) {
+					draw(pos, sy, slot);
+				}
+			}
+		}
+	}
+	else {
+		struct Visit {
+			ChunkPos pos;
+			int sectionY;
+			ChunkSlot* slot;
+			// The face it was entered through, or -1 for the camera's own section.
+			int entry;
+			// One bit per face direction stepped through on the way here.
+			uint8_t directions;
+		};
+		// A camera above or below the world starts from the nearest section of its column.
+		int startY = std::clamp(floorDiv(cameraBlock.y, CHUNK_SIZE), 0, SECTION_COUNT - 1);
+		std::deque<Visit> queue;
+		queue.push_back(Visit{ cameraChunk, startY, &start->second, -1, 0 });
+		start->second.visitedFrame[startY] = m_renderFrame;
+		while (!queue.empty()) {
+			Visit visit = queue.front();
+			queue.pop_front();
+			draw(visit.pos, visit.sectionY, *visit.slot);
+
+			const SectionConnectivity& connectivity = visit.slot->connectivity[visit.sectionY];
+			for (int face = 0; face < 6; face++) {
+				// Never step back toward the camera, and only leave through a face that the way
+				// in connects to.
+				if ((visit.directions >> SectionConnectivity::opposite(face) & 1)
+					|| (visit.entry >= 0 && !connectivity.connects(visit.entry, face))) {
+					continue;
+				}
+				const glm::ivec3& step = FACE_STEPS[face];
+				ChunkPos pos{ visit.pos.x + step.x, visit.pos.z + step.z };
+				int sectionY = visit.sectionY + step.y;
+				if (sectionY < 0 || sectionY >= SECTION_COUNT) {
+					continue;
+				}
+				ChunkSlot* slot = visit.slot;
+				if (step.y == 0) {
+					auto neighbor = m_chunks.find(pos);
+					if (neighbor == m_chunks.end() || neighbor->second.state != ChunkState::Generated) {
+						continue;
+					}
+					slot = &neighbor->second;
+				}
+				if (slot->visitedFrame[sectionY] == m_renderFrame || !inFrustum(pos, sectionY)) {
+					continue;
+				}
+				slot->visitedFrame[sectionY] = m_renderFrame;
+				queue.push_back(Visit{ pos, sectionY, slot, SectionConnectivity::opposite(face),
+					static_cast<uint8_t>(visit.directions | 1 << face) });
+			}
+		}
+	}
+
+	for (auto& key : m_lodDraw) {
+		const LodSlot& tile = m_lodTiles.at(key);
+		float scale = static_cast<float>(key.scale());
+		ChunkPos first = key.firstChunk();
+		for (size_t sy = 0; sy < tile.meshes.size(); sy++) {
+			if (tile.meshes[sy].empty()) {
+				continue;
+			}
+			glm::vec3 origin = ORIGIN + glm::vec3(first.x * CHUNK_SIZE, sy * CHUNK_SIZE * scale, first.z * CHUNK_SIZE);
+			if (!frustum.intersects(origin, origin + glm::vec3(CHUNK_SIZE * scale))) {
+				continue;
+			}
+			m_program.setUniform("model", glm::scale(glm::translate(glm::mat4(1), origin), glm::vec3(scale)));
+			tile.meshes[sy].render();
+			m_drawnLodSections++;
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glUseProgram(previousProgram);
+}
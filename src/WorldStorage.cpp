@@ -0,0 +1,128 @@
+#include "WorldStorage.h"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	int floorDiv(int value, int divisor) {
+		return (value >= 0 ? value : value - divisor + 1) / divisor;
+	}
+
+	int floorMod(int value, int divisor) {
+		return value - floorDiv(value, divisor) * divisor;
+	}
+}
+
+WorldStorage::WorldStorage(const std::filesystem::path& directory) : m_directory(directory), m_stopping(false) {
+	std::filesystem::create_directories(directory);
+	m_saver = std::thread(&WorldStorage::saveLoop, this);
+}
+
+WorldStorage::~WorldStorage() {
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_queueChanged.notify_all();
+	m_saver.join();
+}
+
+std::unique_ptr<Chunk> WorldStorage::load(ChunkPos pos) {
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		auto pending = m_pending.find(pos);
+		if (pending != m_pending.end()) {
+			return fromSnapshot(pending->second);
+		}
+		auto writing = m_writing.find(pos);
+		if (writing != m_writing.end()) {
+			return fromSnapshot(writing->second);
+		}
+	}
+
+	try {
+		RegionFile* file = region(pos, false);
+		if (file == nullptr) {
+			return nullptr;
+		}
+		auto data = file->read(floorMod(pos.x, REGION_SIZE), floorMod(pos.z, REGION_SIZE));
+		if (data.empty()) {
+			return nullptr;
+		}
+		return Chunk::deserialize(pos, data.data(), data.size());
+	}
+	catch (const std::runtime_error& error) {
+		std::cout << "Could not load chunk (" << pos.x << ", " << pos.z << "), generating it again: "
+			<< error.what() << std::endl;
+		return nullptr;
+	}
+}
+
+void WorldStorage::save(ChunkSnapshot snapshot) {
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		ChunkPos pos = snapshot.pos;
+		m_pending.insert_or_assign(pos, std::move(snapshot));
+	}
+	m_queueChanged.notify_one();
+}
+
+RegionFile* WorldStorage::region(ChunkPos chunk, bool create) {
+	ChunkPos pos{ floorDiv(chunk.x, REGION_SIZE), floorDiv(chunk.z, REGION_SIZE) };
+	std::lock_guard<std::mutex> lock(m_regionsMutex);
+	auto file = m_regions.find(pos);
+	if (file != m_regions.end()) {
+		return file->second.get();
+	}
+	auto path = m_directory / ("r." + std::to_string(pos.x) + "." + std::to_string(pos.z) + ".region");
+	if (!create && !std::filesystem::exists(path)) {
+		return nullptr;
+	}
+	return m_regions.emplace(pos, std::make_unique<RegionFile>(path)).first->second.get();
+}
+
+void WorldStorage::saveLoop() {
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	while (true) {
+		m_queueChanged.wait(lock, [this]() { return m_stopping || !m_pending.empty(); });
+		if (m_pending.empty()) {
+			return;
+		}
+		// Take the whole batch. load() still finds it in m_writing, which only this thread
+		// changes, so it can be read here without the lock.
+		m_writing.swap(m_pending);
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		size_t rawBytes = 0, storedBytes = 0;
+		std::vector<uint8_t> data;
+		for (auto& [pos, snapshot] : m_writing) {
+			data.clear();
+			snapshot.serialize(data);
+			rawBytes += data.size();
+			try {
+				storedBytes += region(pos, true)->write(floorMod(pos.x, REGION_SIZE), floorMod(pos.z, REGION_SIZE), data);
+			}
+			catch (const std::runtime_error& error) {
+				std::cout << "Could not save chunk (" << pos.x << ", " << pos.z << "): " << error.what() << std::endl;
+			}
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Saved " << m_writing.size() << " chunks, " << storedBytes / 1024 << " KiB ("
+			<< rawBytes / 1024 << " KiB uncompressed) in " << ms << " ms" << std::endl;
+
+		lock.lock();
+		m_writing.clear();
+	}
+}
+
+std::unique_ptr<Chunk> WorldStorage::fromSnapshot(const ChunkSnapshot& snapshot) {
+	auto chunk = std::make_unique<Chunk>(snapshot.pos);
+	for (int sy = 0; sy < SECTION_COUNT; sy++) {
+		if (snapshot.sections[sy]) {
+			chunk->setSection(sy, std::make_shared<ChunkSection>(*snapshot.sections[sy]));
+		}
+	}
+	return chunk;
+}
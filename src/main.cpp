@@ -13,6 +13,11 @@ We now transform local space vertices to clip space using uniform matrices in th
 #include <iostream>
 #include <memory>
 #include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include <cstdlib>
 #include <math.h>
 
 #include <windows.h>
@@ -22,6 +27,13 @@ We now transform local space vertices to clip space using uniform matrices in th
 #include "Object3D.h"
 #include "Animator.h"
 #include "ShaderProgram.h"
+#include "World.h"
+#include "LightmapBaker.h"
+#include "ReferenceRenderer.h"
+#include "Framebuffer.h"
+#include "ImageCompare.h"
+#include "FrameCapture.h"
+#include "Impostor.h"
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Window.hpp>
 
@@ -30,8 +42,24 @@ struct Scene {
 	ShaderProgram program;
 	std::vector<Object3D> objects;
 	std::vector<Animator> animators;
+	// The voxel world, for scenes that have one.
+	std::unique_ptr<World> world;
+	// Stand-ins for objects that are far away, for scenes that have them.
+	std::unique_ptr<ImpostorAtlas> impostors;
 };
 
+/**
+ * @brief A hierarchy over where the scene's objects are right now, for picking them with rays.
+ * Hits carry the index of the top-level object.
+ */
+SceneBvh objectBvh(const Scene& scene) {
+	std::vector<BvhInstance> instances;
+	for (size_t i = 0; i < scene.objects.size(); i++) {
+		scene.objects[i].collectBvhInstances(instances, static_cast<uint32_t>(i), glm::mat4(1));
+	}
+	return SceneBvh(instances);
+}
+
 /**
  * @brief Constructs a shader program that applies the Phong reflection model.
  */
@@ -63,13 +91,48 @@ ShaderProgram texturingShader() {
 	return shader;
 }
 
+/**
+ * @brief Constructs a shader program for voxel chunks, lit by sky light and block light.
+ */
+ShaderProgram chunkShader() {
+	ShaderProgram shader;
+	try {
+		shader.load("shaders/chunk.vert", "shaders/chunk.frag");
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	return shader;
+}
+
+/**
+ * @brief Renders the views of objects into an impostor atlas, to draw them in their place
+ * when they are far away.
+ * @return null if the atlas could not be baked.
+ */
+std::unique_ptr<ImpostorAtlas> bakeImpostors(const std::vector<Object3D*>& objects) {
+	ShaderProgram capture, program;
+	try {
+		capture.load("shaders/impostor_capture.vert", "shaders/impostor_capture.frag");
+		program.load("shaders/impostor.vert", "shaders/impostor.frag");
+		auto impostors = std::make_unique<ImpostorAtlas>(capture, program);
+		impostors->bake(objects);
+		return impostors;
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "Could not bake impostors: " << e.what() << std::endl;
+		return nullptr;
+	}
+}
+
 /**
  * @brief Loads an image from the given path into an OpenGL texture.
  */
 Texture loadTexture(const std::filesystem::path& path, const std::string& samplerName = "baseTexture") {
 	StbImage i;
-	i.loadFromFile(path.string());
-	return Texture::loadImage(i, samplerName);
+	i.loadFromFile(path.string(), Texture::mipSkip());
+	return Texture::loadImage(i, samplerName, Texture::usageForSampler(samplerName));
 }
 
 /*****************************************************************************************
@@ -104,8 +167,9 @@ Scene bunny() {
 /**
  * @brief Demonstrates loading a square, oriented as the "floor", with a manually-specified texture
  * that does not come from Assimp.
+ * @param lightmaps the directory that caches the baked light.
  */
-Scene marbleSquare() {
+Scene marbleSquare(const std::filesystem::path& lightmaps) {
 	Scene scene{ texturingShader() };
 
 	std::vector<Texture> textures = {
@@ -117,7 +181,15 @@ Scene marbleSquare() {
 	floor.move(glm::vec3(0, -1.5, 0));
 	floor.rotate(glm::vec3(-M_PI / 2, 0, 0));
 
+	// A crate resting on the floor, to cast a shadow and bounce light onto it.
+	auto crate = assimpLoad("models/cube.obj", true);
+	crate.move(glm::vec3(0, -1, 0));
+
 	scene.objects.push_back(std::move(floor));
+	scene.objects.push_back(std::move(crate));
+
+	// Nothing here moves, so all of its light is baked once and cached.
+	bakeLightmaps({ &scene.objects[0], &scene.objects[1] }, LightmapSettings(), lightmaps);
 	return scene;
 }
 
@@ -160,6 +232,9 @@ Scene lifeOfPi() {
 
 	// Move the boat into the scene list.
 	scene.objects.push_back(std::move(boat));
+	// The tiger gets an impostor of its own, so the boat's views leave it out and it keeps
+	// turning while the boat is far away.
+	scene.impostors = bakeImpostors({ &scene.objects[0], &scene.objects[0].getChild(1) });
 
 	// We want these animations to referenced the *moved* objects, which are no longer
 	// in the variables named "tiger" and "boat". "boat" is now in the "objects" list at
@@ -189,24 +264,30 @@ Object3D* pigRef = nullptr;
 
 float creeperYaw = 0.0f; // allows creeper to face forward
 
-Scene minecraftScene() {
-	Scene scene{ texturingShader() };
-
-	auto cobbleTex = loadTexture("models/Minecraft/cobblestone.png", "baseTexture");
-	auto tileMesh = Mesh3D::square({ cobbleTex });
+// Selects the generated terrain; the same seed always gives the same world.
+constexpr uint32_t WORLD_SEED = 1337;
 
-	int gridSize = 100; // 100 tiles of CobbleStone!
-	float spacing = 1.0f; // spacing between tiles
+/**
+ * @param worldSave the directory that holds the edited chunks.
+ */
+Scene minecraftScene(const std::filesystem::path& worldSave) {
+	Scene scene{ texturingShader() };
 
-	// 2D grid to load tiles, divides by 2 to split between directions for each tile -50, +50
-	for (int x = -gridSize / 2; x <= gridSize / 2; ++x) { // iterates left to right for grid
-		for (int z = -gridSize / 2; z <= gridSize / 2; ++z) { // iterates through z (front and back)
-			Object3D tile({ tileMesh });
-			tile.move(glm::vec3(x * spacing, -1.5f, z * spacing));
-			tile.rotate(glm::vec3(-M_PI / 2, 0, 0));  // Make it flat
-			scene.objects.push_back(std::move(tile));
+	// One layer per BlockTexture, from the same list the block registry names its textures from. Each image file is loaded once.
+	std::map<std::string, StbImage> blockImages;
+	std::vector<TextureArray::Layer> blockLayers;
+	for (auto& source : BLOCK_TEXTURE_SOURCES) {
+		auto [image, inserted] = blockImages.try_emplace(source.file);
+		if (inserted) {
+			image->second.loadFromFile(source.file, Texture::mipSkip());
 		}
+		blockLayers.push_back({ &image->second, glm::vec3(source.tint[0], source.tint[1], source.tint[2]) });
 	}
+	auto blockTextures = TextureArray::build(blockLayers, "blockTextures");
+
+	// The ground is a voxel world streamed in around the creeper, 8 chunks (128 blocks) in
+	// every direction, which reaches past the far plane. Craters are saved in saves/world.
+	scene.world = std::make_unique<World>(chunkShader(), blockTextures, 8, WORLD_SEED, worldSave);
 
 	// Load Creeper
 	auto creeper = assimpLoad("models/Minecraft/Creeper.gltf", true);
@@ -249,9 +330,217 @@ Scene minecraftScene() {
 	scene.objects.push_back(std::move(creeper));
 
 	creeperRef = &scene.objects.back();  // creeper position/movement pointer (last object)
+
+	// The mobs, the sun and the cloud draw as impostors when they are far away.
+	scene.impostors = bakeImpostors({ &scene.objects[0], &scene.objects[1], &scene.objects[2].getChild(0),
+		&scene.objects[2].getChild(1), &scene.objects[3] });
 	return scene;
 }
 
+/**
+ * @brief The demonstration scene with the given name, or the Minecraft scene if there is none.
+ * @param worldSave where the Minecraft scene keeps the chunks the player edits.
+ * @param lightmaps where baked lightmaps are cached.
+ */
+Scene loadScene(const char* name, const std::filesystem::path& worldSave = "saves/world",
+	const std::filesystem::path& lightmaps = "saves/lightmaps") {
+	std::string scene = name ? name : "";
+	if (scene == "bunny") {
+		return bunny();
+	}
+	if (scene == "marbleSquare") {
+		return marbleSquare(lightmaps);
+	}
+	if (scene == "cube") {
+		return cube();
+	}
+	if (scene == "lifeOfPi") {
+		return lifeOfPi();
+	}
+	return minecraftScene(worldSave);
+}
+
+/**
+ * @brief Draws a scene's world and objects with the scene's program, which must be active.
+ * @param skyColor the clear color and the color of full sky light, in the framebuffer's space.
+ */
+void drawScene(Scene& scene, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& skyColor) {
+	scene.program.setUniform("view", view);
+	scene.program.setUniform("projection", projection);
+	glClearColor(skyColor.r, skyColor.g, skyColor.b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (scene.world) {
+		scene.world->render(view, projection, skyColor);
+	}
+	if (scene.impostors) {
+		scene.impostors->beginFrame(view, projection);
+	}
+	// Dense meshes leave out their meshlets that are off screen or face away.
+	Mesh3D::cullFor(view, projection);
+	for (auto& o : scene.objects) {
+		o.render(scene.program, scene.impostors.get());
+	}
+	Mesh3D::stopCulling();
+	// Every distant object at once.
+	if (scene.impostors) {
+		scene.impostors->draw();
+	}
+}
+
+/**
+ * @brief A fixed camera for golden images.
+ */
+struct CameraPose {
+	const char* name;
+	glm::vec3 position;
+	glm::vec3 target;
+};
+
+// Every demonstration scene is checked from the starting camera and from above at an angle.
+const CameraPose GOLDEN_POSES[] = {
+	{ "front", { 0.0f, 1.0f, 5.0f }, { 0.0f, 0.0f, 0.0f } },
+	{ "above", { 4.0f, 5.0f, 6.0f }, { 0.0f, 0.0f, 0.0f } },
+};
+const char* const GOLDEN_SCENES[] = { "bunny", "marbleSquare", "cube", "lifeOfPi", "minecraftScene" };
+constexpr int GOLDEN_WIDTH = 640;
+constexpr int GOLDEN_HEIGHT = 360;
+// Frames drawn per pose to time it.
+constexpr int GOLDEN_TIMED_FRAMES = 20;
+// An image matches its golden image if at most this share of its pixels differ noticeably,
+// and its colors are this close on average (CIE76 delta E).
+constexpr float GOLDEN_MAX_DIFFERING_SHARE = 0.005f;
+constexpr float GOLDEN_MAX_MEAN_DELTA_E = 1.0f;
+// How long a world may take to stream in around a pose.
+constexpr float GOLDEN_SETTLE_SECONDS = 120.0f;
+
+/**
+ * @brief Renders every demonstration scene from the golden poses into an RGBA8 offscreen
+ * framebuffer and compares each image with its golden image in the directory. With record,
+ * the images are saved as the new goldens instead (to accept a deliberate change); without
+ * it, a missing golden image counts as a mismatch. Writes the frame times and differences
+ * to report.csv in the same directory.
+ *
+ * Scenes are not animated. The world saves into a fresh temporary directory, deleted
+ * afterwards, so the terrain comes only from WORLD_SEED. Lightmaps are baked once into the
+ * directory's "lightmaps" cache, which later runs load.
+ * @return how many images did not match.
+ */
+int verifyGoldenImages(const std::filesystem::path& directory, bool record) {
+	std::filesystem::create_directories(directory);
+	std::ofstream report(directory / "report.csv");
+	report << "scene,pose,frame_ms,mean_delta_e,worst_delta_e,differing_share,result" << std::endl;
+	Framebuffer target(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+	glm::vec3 white(1.0f);
+	int failures = 0;
+	std::filesystem::path worldSave = std::filesystem::temp_directory_path()
+		/ ("graphics-golden-" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()));
+	std::filesystem::create_directories(worldSave);
+
+	for (auto sceneName : GOLDEN_SCENES) {
+		Scene scene = loadScene(sceneName, worldSave, directory / "lightmaps");
+		scene.program.activate();
+		scene.program.setUniform("color", white);
+		for (auto& pose : GOLDEN_POSES) {
+			glm::vec3 front = glm::normalize(pose.target - pose.position);
+			glm::mat4 view = glm::lookAt(pose.position, pose.target, glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+				static_cast<float>(GOLDEN_WIDTH) / GOLDEN_HEIGHT, 0.1f, scene.world ? scene.world->viewDistance() : 100.0f);
+
+			// Let the world stream in completely, so every run sees the same terrain.
+			if (scene.world) {
+				sf::Clock settling;
+				scene.world->update(pose.position, front);
+				while (!scene.world->isSettled()) {
+					if (settling.getElapsedTime().asSeconds() > GOLDEN_SETTLE_SECONDS) {
+						std::cout << "Golden " << sceneName << "/" << pose.name << ": the world did not finish streaming" << std::endl;
+						break;
+					}
+					scene.world->waitForJob();
+					scene.world->update(pose.position, front);
+				}
+			}
+
+			target.bind();
+			drawScene(scene, view, projection, white);
+			glFinish();
+			sf::Clock timer;
+			for (int frame = 0; frame < GOLDEN_TIMED_FRAMES; frame++) {
+				drawScene(scene, view, projection, white);
+			}
+			glFinish();
+			float frameMs = timer.getElapsedTime().asMilliseconds() / static_cast<float>(GOLDEN_TIMED_FRAMES);
+			StbImage image = target.readPixels();
+
+			std::string file = (directory / (std::string(sceneName) + "-" + pose.name + ".png")).string();
+			std::string result;
+			ImageDifference difference{ 0.0f, 0.0f, 0.0f };
+			if (record) {
+				image.saveToPng(file);
+				result = "recorded";
+			}
+			else if (!std::filesystem::exists(file)) {
+				std::cout << "ERROR: no golden image " << file << "; record one with GRAPHICS_GOLDEN_RECORD=1" << std::endl;
+				result = "MISSING";
+				failures++;
+				image.saveToPng((directory / (std::string(sceneName) + "-" + pose.name + ".actual.png")).string());
+			}
+			else {
+				try {
+					StbImage golden;
+					golden.loadFromFile(file);
+					difference = compareImages(golden, image);
+					bool matches = difference.differingShare <= GOLDEN_MAX_DIFFERING_SHARE
+						&& difference.meanDeltaE <= GOLDEN_MAX_MEAN_DELTA_E;
+					result = matches ? "match" : "MISMATCH";
+				}
+				catch (std::runtime_error& e) {
+					std::cout << "ERROR: " << e.what() << std::endl;
+					result = "MISMATCH";
+				}
+				if (result == "MISMATCH") {
+					failures++;
+					image.saveToPng((directory / (std::string(sceneName) + "-" + pose.name + ".actual.png")).string());
+				}
+			}
+			std::cout << "Golden " << sceneName << "/" << pose.name << ": " << result << ", " << frameMs
+				<< " ms per frame, mean delta E " << difference.meanDeltaE << ", "
+				<< difference.differingShare * 100.0f << "% of pixels differ" << std::endl;
+			report << sceneName << "," << pose.name << "," << frameMs << "," << difference.meanDeltaE << ","
+				<< difference.worstDeltaE << "," << difference.differingShare << "," << result << std::endl;
+		}
+	}
+	std::error_code ignored;
+	std::filesystem::remove_all(worldSave, ignored);
+	return failures;
+}
+
+/**
+ * @brief Starts capturing the window's frames as GRAPHICS_CAPTURE asks: "png" or "raw" into the
+ * GRAPHICS_CAPTURE_PATH directory (default "captures"), or "shm" into the shared memory ring of
+ * that name (default "graphics_capture").
+ * @return null if the capture could not start.
+ */
+std::unique_ptr<FrameCapture> startCapture(const sf::Window& window) {
+	std::string format = std::getenv("GRAPHICS_CAPTURE") ? std::getenv("GRAPHICS_CAPTURE") : "png";
+	const char* path = std::getenv("GRAPHICS_CAPTURE_PATH");
+	int width = static_cast<int>(window.getSize().x);
+	int height = static_cast<int>(window.getSize().y);
+	try {
+		if (format == "shm") {
+			return std::make_unique<FrameCapture>(width, height, CaptureFormat::SharedMemory, path ? path : "graphics_capture");
+		}
+		auto capture = std::make_unique<FrameCapture>(width, height, format == "raw" ? CaptureFormat::Raw : CaptureFormat::Png,
+			path ? path : "captures");
+		std::cout << "Capturing " << width << "x" << height << " frames as " << (format == "raw" ? "raw RGB" : "PNG")
+			<< " into " << (path ? path : "captures") << std::endl;
+		return capture;
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "Could not start capturing frames: " << e.what() << std::endl;
+		return nullptr;
+	}
+}
+
 glm::vec3 cameraPos = glm::vec3(0.0f, 1.0f, 5.0f); // camera pos in world space
 glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f); // scene center
 glm::vec3 cameraFront = glm::normalize(cameraTarget - cameraPos); // view direction, (forward)
@@ -283,6 +572,11 @@ glm::vec3 steveFleeDir = glm::vec3(-1.0f, 0.0f, 0.0f); // starts direction that
 int main() {
 	
 	std::cout << std::filesystem::current_path() << std::endl;
+
+	// GRAPHICS_TERRAIN_BENCHMARK=<chunks> measures terrain generation before starting.
+	if (const char* benchmarkChunks = std::getenv("GRAPHICS_TERRAIN_BENCHMARK")) {
+		TerrainGenerator(WORLD_SEED).benchmark(std::max(1, std::atoi(benchmarkChunks)));
+	}
 	
 	// Initialize the window and OpenGL.
 	sf::ContextSettings settings;
@@ -292,17 +586,62 @@ int main() {
 	settings.majorVersion = 3;
 	settings.minorVersion = 3;
 	sf::Window window(sf::VideoMode{ 1200, 800 }, "Modern OpenGL", sf::Style::Resize | sf::Style::Close, settings);
+	// Stills and golden images are rendered without showing the window; it only provides the
+	// OpenGL context.
+	bool renderingStill = std::getenv("GRAPHICS_RENDER_STILL") != nullptr;
+	const char* goldenDirectory = std::getenv("GRAPHICS_GOLDEN_DIR");
+	window.setVisible(!renderingStill && !goldenDirectory);
 
 	gladLoadGL();
 	glEnable(GL_DEPTH_TEST);
 	glDisable(GL_CULL_FACE);  // To see the inside of objects
 
+	// Pick the texture quality tier from the available video memory before loading anything.
+	size_t textureBudget = Texture::videoMemoryBudget();
+	Texture::setQuality(Texture::qualityForBudget(textureBudget));
+	std::cout << "Texture budget " << textureBudget / (1024 * 1024) << " MiB, skipping "
+		<< Texture::mipSkip() << " mip levels" << std::endl;
+
+
+	// GRAPHICS_GOLDEN_DIR=<directory> checks every demonstration scene against its golden
+	// images there and exits with the number of mismatches; GRAPHICS_GOLDEN_RECORD=1 records
+	// them all anew. Goldens always use the top texture quality, whatever the video memory.
+	if (goldenDirectory) {
+		Texture::setQuality(TextureQuality::High);
+		int failures = verifyGoldenImages(goldenDirectory, std::getenv("GRAPHICS_GOLDEN_RECORD") != nullptr);
+		std::cout << failures << " golden image mismatches" << std::endl;
+		return failures;
+	}
 
-	// Inintialize scene objects.
-	auto myScene = minecraftScene();
+	// Inintialize scene objects. GRAPHICS_SCENE=<function name> picks another demonstration scene.
+	auto myScene = loadScene(std::getenv("GRAPHICS_SCENE"));
 	// You can directly access specific objects in the scene using references.
 	auto& firstObject = myScene.objects[0];
 
+	// GRAPHICS_PICK_BENCHMARK=<rays> measures ray queries against the scene's objects.
+	if (const char* benchmarkRays = std::getenv("GRAPHICS_PICK_BENCHMARK")) {
+		objectBvh(myScene).benchmark(std::max(1, std::atoi(benchmarkRays)));
+	}
+
+	// GRAPHICS_RENDER_STILL=<file.png> path traces a reference image from the starting camera
+	// and exits, instead of running the scene.
+	if (renderingStill) {
+		std::vector<Object3D*> objects;
+		for (auto& object : myScene.objects) {
+			objects.push_back(&object);
+		}
+		StbImage still = ReferenceRenderer(objects, RenderSettings()).render(cameraPos, cameraFront, cameraUp);
+		try {
+			still.saveToPng(std::getenv("GRAPHICS_RENDER_STILL"));
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+		std::cout << "Saved " << std::getenv("GRAPHICS_RENDER_STILL") << std::endl;
+		return 0;
+	}
+
 	// Activate the shader program.
 	myScene.program.activate();
 
@@ -318,6 +657,13 @@ int main() {
 		anim.start();
 	}
 
+	// GRAPHICS_CAPTURE captures every frame from the start; F9 starts and stops capturing at any
+	// time, so the frame rate can be compared with and without it.
+	std::unique_ptr<FrameCapture> capture;
+	if (std::getenv("GRAPHICS_CAPTURE")) {
+		capture = startCapture(window);
+	}
+
 
 
 
@@ -328,10 +674,40 @@ int main() {
 			if (ev.type == sf::Event::Closed) {
 				running = false;
 			}
+			if (ev.type == sf::Event::KeyPressed && ev.key.code == sf::Keyboard::F9) {
+				// Stopping writes the frames still in flight and reports the cost.
+				capture = capture ? nullptr : startCapture(window);
+			}
+			if (ev.type == sf::Event::MouseButtonPressed && myScene.world) {
+				// Left click breaks the block the camera looks at (or names the object in front of it), right click places cobblestone against it, middle click a water source.
+				auto hit = myScene.world->pickBlock(cameraPos, cameraFront, 16.0f);
+				auto objectHit = objectBvh(myScene).intersect(cameraPos, cameraFront, hit ? hit->distance : 16.0f);
+				if (objectHit && ev.mouseButton.button == sf::Mouse::Left) {
+					std::cout << "Picked " << myScene.objects[objectHit->id].getName() << " at distance "
+						<< objectHit->hit.distance << std::endl;
+				}
+				else if (hit && ev.mouseButton.button == sf::Mouse::Left) {
+					myScene.world->setBlock(hit->block, Blocks::AIR);
+				}
+				else if (hit && ev.mouseButton.button == sf::Mouse::Right) {
+					myScene.world->setBlock(hit->block + hit->normal, Blocks::COBBLESTONE);
+				}
+				else if (hit && ev.mouseButton.button == sf::Mouse::Middle) {
+					myScene.world->setBlock(hit->block + hit->normal, Blocks::WATER);
+				}
+			}
 		}
 		auto now = c.getElapsedTime();
 		auto diff = now - last;
-		std::cout << 1 / diff.asSeconds() << " FPS " << std::endl;
+		std::cout << 1 / diff.asSeconds() << " FPS ";
+		// Meshlet culling in the frame before.
+		const MeshletStats& culled = Mesh3D::cullingStats();
+		if (culled.triangles > 0) {
+			std::cout << "(culled " << culled.outsideTriangles + culled.backfacingTriangles << " of " << culled.triangles
+				<< " meshlet triangles: " << culled.outsideTriangles << " off screen, " << culled.backfacingTriangles
+				<< " facing away)";
+		}
+		std::cout << std::endl;
 		last = now;
 
 		float deltaTime = diff.asSeconds();
@@ -434,6 +810,25 @@ int main() {
 
 		}
 
+		if (creeperRef && myScene.world) { // steve and the pig run from the creeper once they can see it
+			std::vector<std::pair<Object3D*, glm::vec3*>> mobs;
+			if (steveRef) mobs.push_back({ steveRef, &steveFleeDir });
+			if (pigRef) mobs.push_back({ pigRef, &pigFleeDir });
+
+			std::vector<SightLine> lines;
+			for (auto& [mob, fleeDir] : mobs) {
+				lines.push_back({ mob->getPosition() + glm::vec3(0.0f, 1.5f, 0.0f), creeperRef->getPosition() + glm::vec3(0.0f, 1.0f, 0.0f) }); // eyes to creeper
+			}
+			std::vector<bool> visible = myScene.world->lineOfSight(lines); // one batch for every mob
+			for (size_t i = 0; i < mobs.size(); i++) {
+				glm::vec3 away = mobs[i].first->getPosition() - creeperRef->getPosition();
+				away.y = 0.0f;
+				if (visible[i] && glm::length(away) < 12.0f && glm::length(away) > 0.0f) {
+					*mobs[i].second = glm::normalize(away); // flee straight away from it
+				}
+			}
+		}
+
 		if (creeperRef && steveRef) {
 			glm::vec3 stevePos = steveRef->getPosition(); // get steve position
 
@@ -452,6 +847,9 @@ int main() {
 
 			float dist = glm::length(creeperRef->getPosition() - steveRef->getPosition());
 			if (dist < 0.8f) { // "explode"
+				if (myScene.world) {
+					myScene.world->explode(creeperRef->getPosition(), 3.0f); // blast a crater into the ground
+				}
 
 				myScene.objects.erase(std::remove_if(myScene.objects.begin(), myScene.objects.end(),
 					[](const Object3D& obj) {
@@ -491,6 +889,9 @@ int main() {
 			// Creeper explosion if near
 			float dist = glm::length(creeperRef->getPosition() - pigRef->getPosition());
 			if (dist < 0.8f) {
+				if (myScene.world) {
+					myScene.world->explode(creeperRef->getPosition(), 3.0f);
+				}
 
 
 				myScene.objects.erase(std::remove_if(myScene.objects.begin(), myScene.objects.end(),
@@ -522,11 +923,9 @@ int main() {
 			glm::radians(45.0f),
 			static_cast<float>(window.getSize().x) / window.getSize().y,
 			0.1f,
-			100.0f
+			myScene.world ? myScene.world->viewDistance() : 100.0f // distant terrain reaches past the loaded chunks
 		);
 
-		myScene.program.setUniform("view", camera);
-		myScene.program.setUniform("projection", perspective);
 		myScene.program.setUniform("color", ambientColor); // sets the color
 
 
@@ -538,15 +937,16 @@ int main() {
 			anim.tick(diff.asSeconds());
 		}
 
-		// Clear the OpenGL "context".
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glClearColor(ambientColor.r, ambientColor.g, ambientColor.b, 1.0f); // sets the color for frames
-
-
+		// Stream the world around the creeper.
+		if (myScene.world) {
+			myScene.world->update(creeperRef ? creeperRef->getPosition() : cameraPos, cameraFront);
+		}
 
-		// Render the scene objects.
-		for (auto& o : myScene.objects) {
-			o.render(myScene.program);
+		// Clear to the sky, then render the world and the scene objects. Full sky light takes on
+		// the sky's color, so the ground darkens at night.
+		drawScene(myScene, camera, perspective, ambientColor);
+		if (capture) {
+			capture->capture();
 		}
 		window.display();
 